@@ -235,6 +235,22 @@ void genfreehashtableandvalues(struct genhashtable * ht) {
   VG_(free)(ht);
 }
 
+// Removes every entry, leaving the table ready to be reused.  This
+// walks the entries rather than the bins, so it is cheap for a large
+// table with only a few entries in it.
+void genclearhashtable(struct genhashtable * ht) {
+  struct genpointerlist *genptr=ht->list;
+  while(genptr!=NULL) {
+    struct genpointerlist *tmpptr=genptr->inext;
+    ht->bins[genhashfunction(ht,genptr->src)]=NULL;
+    VG_(free)(genptr);
+    genptr=tmpptr;
+  }
+  ht->counter=0;
+  ht->list=NULL;
+  ht->last=NULL;
+}
+
 struct geniterator * gengetiterator(struct genhashtable *ht) {
   struct geniterator *gi=(struct geniterator*)VG_(calloc)("GenericHashTable.c: gengetiterator",1,sizeof(struct geniterator));
   gi->ptr=ht->list;
@@ -55,6 +55,7 @@ struct genhashtable * genallocatehashtable(unsigned int (*hash_function)(void *)
 struct genhashtable * genallocateSMALLhashtable(unsigned int (*hash_function)(void *),int (*comp_function)(void *,void *));
 void genfreehashtable(struct genhashtable * ht);
 void genfreehashtableandvalues(struct genhashtable * ht);
+void genclearhashtable(struct genhashtable * ht);
 
 void * getnext(struct genhashtable *,void *);
 int genputtable(struct genhashtable *, void *, void *);
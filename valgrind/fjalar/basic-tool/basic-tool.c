@@ -133,6 +133,12 @@ void fjalar_tool_handle_function_exit(FunctionExecutionState* f_state) {
 
 }
 
+// Functions from shared libraries (--trace-shared-libs) need no
+// set-up, since we don't print anything until they are entered:
+void fjalar_tool_handle_new_functions(FunctionEntry** funcs, UInt num) {
+  VG_(printf)("\nfjalar_tool_handle_new_functions(%u)\n\n", num);
+}
+
 
 // Constructors and destructors for classes that can be sub-classed:
 
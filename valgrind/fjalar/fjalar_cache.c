@@ -0,0 +1,952 @@
+/*
+   This file is part of Fjalar, a dynamic analysis framework for C/C++
+   programs.
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* fjalar_cache.c:
+
+Saves and restores the results of process_elf_binary_data() so that
+repeated runs on the same binary can skip reading its DWARF
+information (see fjalar_cache.h).
+
+*/
+
+#include "my_libc.h"
+
+#include <elf.h>
+
+#include "fjalar_main.h"
+#include "fjalar_cache.h"
+#include "typedata.h"
+
+#include "pub_tool_libcfile.h"
+#include "pub_tool_libcprint.h"
+#include "pub_tool_libcproc.h"
+#include "pub_tool_xarray.h"
+
+// located in typedata.c
+extern struct genhashtable* typedef_names_map;
+
+#define CACHE_MAGIC "FJCACHE"
+// Bump this whenever the format or any of the structs in typedata.h
+// change in a way that sizeof() wouldn't notice
+#define CACHE_VERSION 1
+
+#define CACHE_MAX_BUILD_ID 64
+
+// What a cache file has to match to be used for a binary
+typedef struct {
+  ULong size;
+  ULong mtime;
+  UInt build_id_len;
+  UChar build_id[CACHE_MAX_BUILD_ID];
+} CacheKey;
+
+// A table of (key, value) pairs, each one word
+typedef struct {
+  UWord num_pairs;
+  UWord pairs;
+} CacheTable;
+
+typedef struct {
+  char magic[8];
+  UInt version;
+  UInt layout;          // See cacheLayoutSignature()
+  CacheKey key;
+
+  UWord num_entries;
+  UWord entries;        // dwarf_entry_array
+  UWord num_comp_units;
+  UWord comp_units;     // comp_unit_info
+
+  CacheTable function_symbols;          // name -> address
+  CacheTable reverse_function_symbols;  // address -> name
+  CacheTable variable_symbols;          // name -> address
+  CacheTable next_line_addrs;           // address -> address
+  CacheTable loc_lists;                 // offset -> location_list
+  CacheTable typedef_names;             // ID -> name
+
+  unsigned int sections[8];
+} CacheHeader;
+
+/*------------------------------------------------------------*/
+/*--- Layouts of the entries                               ---*/
+/*------------------------------------------------------------*/
+
+// The kinds of pointers in the structs hanging off of dwarf_entry_array
+typedef enum {
+  CF_STRING,       // char*
+  CF_ENTRY,        // dwarf_entry* into dwarf_entry_array
+  CF_ENTRY_ARRAY,  // dwarf_entry** with a count elsewhere in the struct
+  CF_FILE_TABLE    // XArray* of char*
+} CacheFieldKind;
+
+typedef struct {
+  CacheFieldKind kind;
+  SizeT offset;
+  SizeT count_offset;   // CF_ENTRY_ARRAY only
+  SizeT count_size;
+} CacheField;
+
+typedef struct {
+  SizeT size;
+  const CacheField* fields;
+  UInt num_fields;
+} CacheLayout;
+
+#define FIELD(type, kind, f) { kind, offsetof(type, f), 0, 0 }
+#define ARRAY_FIELD(type, f, count) \
+  { CF_ENTRY_ARRAY, offsetof(type, f), offsetof(type, count), sizeof(((type*)0)->count) }
+#define LAYOUT(type, fields) { sizeof(type), fields, sizeof(fields) / sizeof(CacheField) }
+#define PLAIN_LAYOUT(type) { sizeof(type), 0, 0 }
+
+static const CacheField modifier_fields[] = {
+  FIELD(modifier_type, CF_ENTRY, target_ptr)
+};
+static const CacheField collection_fields[] = {
+  FIELD(collection_type, CF_STRING, name),
+  ARRAY_FIELD(collection_type, member_vars, num_member_vars),
+  ARRAY_FIELD(collection_type, member_funcs, num_member_funcs),
+  ARRAY_FIELD(collection_type, static_member_vars, num_static_member_vars),
+  ARRAY_FIELD(collection_type, superclasses, num_superclasses)
+};
+static const CacheField member_fields[] = {
+  FIELD(member, CF_STRING, name),
+  FIELD(member, CF_ENTRY, type_ptr)
+};
+static const CacheField enumerator_fields[] = {
+  FIELD(enumerator, CF_STRING, name)
+};
+static const CacheField function_fields[] = {
+  FIELD(function, CF_STRING, name),
+  FIELD(function, CF_STRING, mangled_name),
+  FIELD(function, CF_STRING, filename),
+  FIELD(function, CF_ENTRY, return_type),
+  ARRAY_FIELD(function, params, num_formal_params),
+  ARRAY_FIELD(function, local_vars, num_local_vars)
+};
+static const CacheField formal_parameter_fields[] = {
+  FIELD(formal_parameter, CF_STRING, name),
+  FIELD(formal_parameter, CF_ENTRY, type_ptr)
+};
+static const CacheField compile_unit_fields[] = {
+  FIELD(compile_unit, CF_STRING, filename),
+  FIELD(compile_unit, CF_STRING, comp_dir),
+  FIELD(compile_unit, CF_FILE_TABLE, file_name_table)
+};
+static const CacheField function_type_fields[] = {
+  FIELD(function_type, CF_ENTRY, return_type)
+};
+static const CacheField array_fields[] = {
+  FIELD(array_type, CF_ENTRY, type_ptr),
+  ARRAY_FIELD(array_type, subrange_entries, num_subrange_entries)
+};
+static const CacheField typedef_fields[] = {
+  FIELD(typedef_type, CF_STRING, name),
+  FIELD(typedef_type, CF_ENTRY, target_type_ptr)
+};
+static const CacheField variable_fields[] = {
+  FIELD(variable, CF_STRING, name),
+  FIELD(variable, CF_STRING, mangled_name),
+  FIELD(variable, CF_ENTRY, type_ptr)
+};
+static const CacheField namespace_fields[] = {
+  FIELD(namespace_type, CF_STRING, namespace_name)
+};
+
+static const CacheLayout base_layout = PLAIN_LAYOUT(base_type);
+static const CacheLayout modifier_layout = LAYOUT(modifier_type, modifier_fields);
+static const CacheLayout collection_layout = LAYOUT(collection_type, collection_fields);
+static const CacheLayout member_layout = LAYOUT(member, member_fields);
+static const CacheLayout enumerator_layout = LAYOUT(enumerator, enumerator_fields);
+static const CacheLayout function_layout = LAYOUT(function, function_fields);
+static const CacheLayout formal_parameter_layout = LAYOUT(formal_parameter, formal_parameter_fields);
+static const CacheLayout compile_unit_layout = LAYOUT(compile_unit, compile_unit_fields);
+static const CacheLayout function_type_layout = LAYOUT(function_type, function_type_fields);
+static const CacheLayout array_layout = LAYOUT(array_type, array_fields);
+static const CacheLayout array_subrange_layout = PLAIN_LAYOUT(array_subrange_type);
+static const CacheLayout typedef_layout = LAYOUT(typedef_type, typedef_fields);
+static const CacheLayout variable_layout = LAYOUT(variable, variable_fields);
+static const CacheLayout inheritance_layout = PLAIN_LAYOUT(inheritance_type);
+static const CacheLayout namespace_layout = LAYOUT(namespace_type, namespace_fields);
+
+// The layout of entry_ptr for an entry with the given tag (this must
+// agree with initialize_dwarf_entry_ptr()), or 0 if it has none
+static const CacheLayout* layoutForTag(unsigned long tag) {
+  if (!tag)
+    return 0;
+  else if (tag_is_base_type(tag))
+    return &base_layout;
+  else if (tag_is_modifier_type(tag))
+    return &modifier_layout;
+  else if (tag_is_collection_type(tag))
+    return &collection_layout;
+  else if (tag_is_member(tag))
+    return &member_layout;
+  else if (tag_is_enumerator(tag))
+    return &enumerator_layout;
+  else if (tag_is_function(tag))
+    return &function_layout;
+  else if (tag_is_formal_parameter(tag))
+    return &formal_parameter_layout;
+  else if (tag_is_compile_unit(tag))
+    return &compile_unit_layout;
+  else if (tag_is_function_type(tag))
+    return &function_type_layout;
+  else if (tag_is_array_type(tag))
+    return &array_layout;
+  else if (tag_is_array_subrange_type(tag))
+    return &array_subrange_layout;
+  else if (tag_is_typedef(tag))
+    return &typedef_layout;
+  else if (tag_is_variable(tag))
+    return &variable_layout;
+  else if (tag_is_inheritance(tag))
+    return &inheritance_layout;
+  else if (tag_is_namespace(tag))
+    return &namespace_layout;
+  return 0;
+}
+
+// Changes if any of the structs that get written out do, so that a
+// rebuilt Fjalar doesn't read a cache file from an older one
+static UInt cacheLayoutSignature(void) {
+  UInt sig = CACHE_VERSION;
+  sig = sig * 31 + sizeof(CacheHeader);
+  sig = sig * 31 + sizeof(dwarf_entry);
+  sig = sig * 31 + sizeof(base_type);
+  sig = sig * 31 + sizeof(modifier_type);
+  sig = sig * 31 + sizeof(collection_type);
+  sig = sig * 31 + sizeof(member);
+  sig = sig * 31 + sizeof(enumerator);
+  sig = sig * 31 + sizeof(function);
+  sig = sig * 31 + sizeof(formal_parameter);
+  sig = sig * 31 + sizeof(compile_unit);
+  sig = sig * 31 + sizeof(function_type);
+  sig = sig * 31 + sizeof(array_type);
+  sig = sig * 31 + sizeof(array_subrange_type);
+  sig = sig * 31 + sizeof(typedef_type);
+  sig = sig * 31 + sizeof(variable);
+  sig = sig * 31 + sizeof(inheritance_type);
+  sig = sig * 31 + sizeof(namespace_type);
+  sig = sig * 31 + sizeof(location_list);
+  return sig;
+}
+
+static UWord fieldCount(const void* obj, const CacheField* f) {
+  const char* p = (const char*)obj + f->count_offset;
+  switch (f->count_size) {
+  case 1: return *(const UChar*)p;
+  case 2: return *(const UShort*)p;
+  case 4: return *(const UInt*)p;
+  default: return *(const ULong*)p;
+  }
+}
+
+/*------------------------------------------------------------*/
+/*--- Finding the cache file                               ---*/
+/*------------------------------------------------------------*/
+
+static Bool readAt(Int fd, void* buf, SizeT len, Off64T offset) {
+  if (VG_(lseek)(fd, offset, VKI_SEEK_SET) != offset)
+    return False;
+  return VG_(read)(fd, buf, len) == (Int)len;
+}
+
+// Looks for a NT_GNU_BUILD_ID note in the SHT_NOTE section at the
+// given offset, and copies it into key if there is one
+static Bool readBuildIdNote(Int fd, ULong offset, ULong size, CacheKey* key) {
+  UChar buf[1024];
+  UInt pos = 0;
+
+  if (size > sizeof(buf))
+    size = sizeof(buf);
+  if (!readAt(fd, buf, size, offset))
+    return False;
+
+  while (pos + sizeof(Elf32_Nhdr) <= size) {
+    Elf32_Nhdr* note = (Elf32_Nhdr*)(buf + pos);
+    UInt nameStart = pos + sizeof(Elf32_Nhdr);
+    UInt descStart = nameStart + ((note->n_namesz + 3) & ~3);
+    UInt next = descStart + ((note->n_descsz + 3) & ~3);
+
+    if (next > size || next <= pos)
+      return False;
+    if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 &&
+        VG_(memcmp)(buf + nameStart, "GNU", 4) == 0 &&
+        note->n_descsz > 0 && note->n_descsz <= CACHE_MAX_BUILD_ID) {
+      key->build_id_len = note->n_descsz;
+      VG_(memcpy)(key->build_id, buf + descStart, note->n_descsz);
+      return True;
+    }
+    pos = next;
+  }
+  return False;
+}
+
+// Fills in key->build_id from the section headers of the ELF file
+static void readBuildId(Int fd, CacheKey* key) {
+  UChar ident[EI_NIDENT];
+  ULong shoff;
+  UInt shnum, shentsize, i;
+
+  if (!readAt(fd, ident, EI_NIDENT, 0) ||
+      VG_(memcmp)(ident, ELFMAG, SELFMAG) != 0)
+    return;
+
+  if (ident[EI_CLASS] == ELFCLASS64) {
+    Elf64_Ehdr eh;
+    if (!readAt(fd, &eh, sizeof(eh), 0))
+      return;
+    shoff = eh.e_shoff;
+    shnum = eh.e_shnum;
+    shentsize = eh.e_shentsize;
+  } else {
+    Elf32_Ehdr eh;
+    if (!readAt(fd, &eh, sizeof(eh), 0))
+      return;
+    shoff = eh.e_shoff;
+    shnum = eh.e_shnum;
+    shentsize = eh.e_shentsize;
+  }
+
+  for (i = 0; i < shnum; i++) {
+    ULong type, offset, size;
+    if (ident[EI_CLASS] == ELFCLASS64) {
+      Elf64_Shdr sh;
+      if (!readAt(fd, &sh, sizeof(sh), shoff + (ULong)i * shentsize))
+        return;
+      type = sh.sh_type;
+      offset = sh.sh_offset;
+      size = sh.sh_size;
+    } else {
+      Elf32_Shdr sh;
+      if (!readAt(fd, &sh, sizeof(sh), shoff + (ULong)i * shentsize))
+        return;
+      type = sh.sh_type;
+      offset = sh.sh_offset;
+      size = sh.sh_size;
+    }
+    if (type == SHT_NOTE && readBuildIdNote(fd, offset, size, key))
+      return;
+  }
+}
+
+// Fills in key for the binary filename and returns the name of its
+// cache file (which the caller must free), or 0 if the binary can't
+// be read
+static HChar* cacheFileName(const HChar* filename, CacheKey* key) {
+  struct vg_stat st;
+  SysRes sr;
+  HChar* name;
+  HChar* p;
+  UInt i;
+
+  VG_(memset)(key, 0, sizeof(*key));
+
+  sr = VG_(open)(filename, VKI_O_RDONLY, 0);
+  if (sr_isError(sr))
+    return 0;
+  if (VG_(fstat)(sr_Res(sr), &st) != 0) {
+    VG_(close)(sr_Res(sr));
+    return 0;
+  }
+  key->size = st.size;
+  key->mtime = st.mtime;
+  readBuildId(sr_Res(sr), key);
+  VG_(close)(sr_Res(sr));
+
+  name = VG_(malloc)("fjalar_cache.c: cacheFileName",
+                     VG_(strlen)(fjalar_cache_dir) + 2 * CACHE_MAX_BUILD_ID + 64);
+  p = name + VG_(sprintf)(name, "%s/", fjalar_cache_dir);
+  if (key->build_id_len) {
+    for (i = 0; i < key->build_id_len; i++) {
+      p += VG_(sprintf)(p, "%02x", key->build_id[i]);
+    }
+  } else {
+    // No build-id, so go by the name of the binary instead
+    p += VG_(sprintf)(p, "path-%08x", hashString(filename));
+  }
+  VG_(sprintf)(p, "-%llx.fjalar-cache", key->mtime);
+  return name;
+}
+
+/*------------------------------------------------------------*/
+/*--- Writing                                              ---*/
+/*------------------------------------------------------------*/
+
+typedef struct {
+  UChar* bytes;
+  UWord used;
+  UWord capacity;
+  UWord entries;                 // Offset of the copy of dwarf_entry_array
+  struct genhashtable* offsets;  // Object (or string) -> its offset
+  Bool failed;
+} CacheWriter;
+
+// Makes room for len zeroed bytes and returns their offset.  Offsets
+// stay valid as the buffer grows, but pointers into it don't.
+static UWord cacheReserve(CacheWriter* w, SizeT len, SizeT align) {
+  UWord off = (w->used + align - 1) & ~(align - 1);
+  if (off + len > w->capacity) {
+    UWord newCapacity = (w->capacity ? w->capacity * 2 : 1 << 20);
+    while (newCapacity < off + len) {
+      newCapacity *= 2;
+    }
+    w->bytes = VG_(realloc)("fjalar_cache.c: cacheReserve", w->bytes, newCapacity);
+    w->capacity = newCapacity;
+  }
+  VG_(memset)(w->bytes + w->used, 0, off + len - w->used);
+  w->used = off + len;
+  return off;
+}
+
+static UWord cachePut(CacheWriter* w, const void* p, SizeT len, SizeT align) {
+  UWord off = cacheReserve(w, len, align);
+  VG_(memcpy)(w->bytes + off, p, len);
+  return off;
+}
+
+static __inline__ void cacheSet(CacheWriter* w, UWord off, UWord value) {
+  *(UWord*)(w->bytes + off) = value;
+}
+
+static UWord putString(CacheWriter* w, const char* s) {
+  UWord off;
+  if (!s)
+    return 0;
+  off = (UWord)gengettable(w->offsets, (void*)s);
+  if (!off) {
+    off = cachePut(w, s, VG_(strlen)(s) + 1, 1);
+    genputtable(w->offsets, (void*)s, (void*)off);
+  }
+  return off;
+}
+
+static UWord entryOffset(CacheWriter* w, dwarf_entry* e) {
+  if (!e)
+    return 0;
+  if (e < dwarf_entry_array || e >= dwarf_entry_array + dwarf_entry_array_size) {
+    w->failed = True;
+    return 0;
+  }
+  return w->entries + (e - dwarf_entry_array) * sizeof(dwarf_entry);
+}
+
+static UWord putEntryArray(CacheWriter* w, dwarf_entry** array, UWord n) {
+  UWord off, i;
+  if (!array)
+    return 0;
+  off = cacheReserve(w, n * sizeof(UWord), sizeof(UWord));
+  for (i = 0; i < n; i++) {
+    cacheSet(w, off + i * sizeof(UWord), entryOffset(w, array[i]));
+  }
+  return off;
+}
+
+// Written as the number of names followed by the names
+static UWord putFileTable(CacheWriter* w, XArray* table) {
+  UWord off, n, i;
+  if (!table)
+    return 0;
+  n = VG_(sizeXA)(table);
+  off = cacheReserve(w, (n + 1) * sizeof(UWord), sizeof(UWord));
+  cacheSet(w, off, n);
+  for (i = 0; i < n; i++) {
+    UWord name = putString(w, *(char**)VG_(indexXA)(table, i));
+    cacheSet(w, off + (i + 1) * sizeof(UWord), name);
+  }
+  return off;
+}
+
+static UWord putObject(CacheWriter* w, void* obj, const CacheLayout* layout) {
+  UWord off;
+  UInt i;
+
+  if (!obj)
+    return 0;
+  if (!layout) {
+    w->failed = True;
+    return 0;
+  }
+  off = (UWord)gengettable(w->offsets, obj);
+  if (off)
+    return off;
+
+  off = cachePut(w, obj, layout->size, sizeof(UWord));
+  genputtable(w->offsets, obj, (void*)off);
+
+  for (i = 0; i < layout->num_fields; i++) {
+    const CacheField* f = &layout->fields[i];
+    void* target = *(void**)((char*)obj + f->offset);
+    UWord value = 0;
+    switch (f->kind) {
+    case CF_STRING:
+      value = putString(w, (char*)target);
+      break;
+    case CF_ENTRY:
+      value = entryOffset(w, (dwarf_entry*)target);
+      break;
+    case CF_ENTRY_ARRAY:
+      value = putEntryArray(w, (dwarf_entry**)target, fieldCount(obj, f));
+      break;
+    case CF_FILE_TABLE:
+      value = putFileTable(w, (XArray*)target);
+      break;
+    }
+    cacheSet(w, off + f->offset, value);
+  }
+  return off;
+}
+
+// Each list is written as a run of nodes linked by offsets
+static UWord putLocList(CacheWriter* w, location_list* ll) {
+  UWord head = 0, prev = 0;
+  for (; ll; ll = ll->next) {
+    UWord off = cachePut(w, ll, sizeof(*ll), sizeof(UWord));
+    cacheSet(w, off + offsetof(location_list, next), 0);
+    if (prev) {
+      cacheSet(w, prev + offsetof(location_list, next), off);
+    } else {
+      head = off;
+    }
+    prev = off;
+  }
+  return head;
+}
+
+typedef enum {
+  CV_WORD,
+  CV_STRING,
+  CV_LOC_LIST
+} CacheValueKind;
+
+static UWord putValue(CacheWriter* w, void* v, CacheValueKind kind) {
+  switch (kind) {
+  case CV_STRING:
+    return putString(w, (char*)v);
+  case CV_LOC_LIST:
+    return putLocList(w, (location_list*)v);
+  default:
+    return (UWord)v;
+  }
+}
+
+static void putTable(CacheWriter* w, UWord tableOff, struct genhashtable* ht,
+                     CacheValueKind keyKind, CacheValueKind valueKind) {
+  struct genpointerlist* p;
+  UWord n = hashsize(ht);
+  UWord pairs = cacheReserve(w, 2 * n * sizeof(UWord), sizeof(UWord));
+  UWord i = 0;
+
+  // Walk the list directly, since gennext() can't tell a 0 key from
+  // the end of the table
+  for (p = ht->list; p && i < n; p = p->inext, i++) {
+    UWord key = putValue(w, p->src, keyKind);
+    UWord value = putValue(w, p->object, valueKind);
+    cacheSet(w, pairs + 2 * i * sizeof(UWord), key);
+    cacheSet(w, pairs + (2 * i + 1) * sizeof(UWord), value);
+  }
+
+  cacheSet(w, tableOff + offsetof(CacheTable, num_pairs), i);
+  cacheSet(w, tableOff + offsetof(CacheTable, pairs), pairs);
+}
+
+static Bool writeAll(Int fd, const UChar* buf, UWord len) {
+  while (len) {
+    Int n = VG_(write)(fd, buf, MIN(len, 1 << 30));
+    if (n <= 0)
+      return False;
+    buf += n;
+    len -= n;
+  }
+  return True;
+}
+
+void saveDebugInfoCache(const HChar* filename) {
+  CacheWriter w;
+  CacheHeader header;
+  CacheKey key;
+  HChar* cacheName;
+  HChar* tmpName;
+  UWord headerOff, compUnits, i;
+  UInt numCompUnits = 0;
+  Bool ok;
+  SysRes sr;
+
+  if (!fjalar_cache_dir || fjalar_debug_dump)
+    return;
+
+  cacheName = cacheFileName(filename, &key);
+  if (!cacheName)
+    return;
+
+  VG_(memset)(&w, 0, sizeof(w));
+  w.offsets = genallocatehashtable(0, 0);
+
+  headerOff = cacheReserve(&w, sizeof(CacheHeader), sizeof(UWord));
+  tl_assert(headerOff == 0);
+
+  w.entries = cachePut(&w, dwarf_entry_array,
+                       dwarf_entry_array_size * sizeof(dwarf_entry), sizeof(UWord));
+  for (i = 0; i < dwarf_entry_array_size; i++) {
+    dwarf_entry* e = &dwarf_entry_array[i];
+    UWord entryPtr = putObject(&w, e->entry_ptr, layoutForTag(e->tag_name));
+    cacheSet(&w, w.entries + i * sizeof(dwarf_entry) + offsetof(dwarf_entry, entry_ptr),
+             entryPtr);
+    if (tag_is_compile_unit(e->tag_name)) {
+      numCompUnits++;
+    }
+  }
+
+  // Every compile_unit is the entry_ptr of some entry, so it has
+  // already been written
+  compUnits = cacheReserve(&w, numCompUnits * sizeof(UWord), sizeof(UWord));
+  numCompUnits = 0;
+  for (i = 0; i < dwarf_entry_array_size; i++) {
+    dwarf_entry* e = &dwarf_entry_array[i];
+    UWord compUnit = 0;
+    if (e->comp_unit) {
+      compUnit = (UWord)gengettable(w.offsets, e->comp_unit);
+      if (!compUnit) {
+        w.failed = True;
+      }
+    }
+    cacheSet(&w, w.entries + i * sizeof(dwarf_entry) + offsetof(dwarf_entry, comp_unit),
+             compUnit);
+    if (tag_is_compile_unit(e->tag_name)) {
+      cacheSet(&w, compUnits + numCompUnits++ * sizeof(UWord),
+               (UWord)gengettable(w.offsets, e->entry_ptr));
+    }
+  }
+
+  putTable(&w, offsetof(CacheHeader, function_symbols),
+           FunctionSymbolTable, CV_STRING, CV_WORD);
+  putTable(&w, offsetof(CacheHeader, reverse_function_symbols),
+           ReverseFunctionSymbolTable, CV_WORD, CV_STRING);
+  putTable(&w, offsetof(CacheHeader, variable_symbols),
+           VariableSymbolTable, CV_STRING, CV_WORD);
+  putTable(&w, offsetof(CacheHeader, next_line_addrs),
+           next_line_addr, CV_WORD, CV_WORD);
+  putTable(&w, offsetof(CacheHeader, loc_lists),
+           loc_list_map, CV_WORD, CV_LOC_LIST);
+  putTable(&w, offsetof(CacheHeader, typedef_names),
+           typedef_names_map, CV_WORD, CV_STRING);
+
+  // So that every string offset is followed by a 0 somewhere in the file
+  cacheReserve(&w, 1, 1);
+
+  // The tables have been filled in by offset, so only now is it safe
+  // to copy the header in
+  VG_(memcpy)(&header, w.bytes, sizeof(header));
+  VG_(memcpy)(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = CACHE_VERSION;
+  header.layout = cacheLayoutSignature();
+  header.key = key;
+  header.num_entries = dwarf_entry_array_size;
+  header.entries = w.entries;
+  header.num_comp_units = numCompUnits;
+  header.comp_units = compUnits;
+  header.sections[0] = data_section_addr;
+  header.sections[1] = data_section_size;
+  header.sections[2] = bss_section_addr;
+  header.sections[3] = bss_section_size;
+  header.sections[4] = rodata_section_addr;
+  header.sections[5] = rodata_section_size;
+  header.sections[6] = relrodata_section_addr;
+  header.sections[7] = relrodata_section_size;
+  VG_(memcpy)(w.bytes, &header, sizeof(header));
+
+  genfreehashtable(w.offsets);
+
+  if (w.failed) {
+    FJALAR_DPRINTF("Not caching debug info: unexpected pointer in dwarf_entry_array\n");
+    VG_(free)(w.bytes);
+    VG_(free)(cacheName);
+    return;
+  }
+
+  // Write to a temporary file and rename it into place, so that runs
+  // in parallel never see half of a cache file
+  VG_(mkdir)(fjalar_cache_dir, 0777);
+  tmpName = VG_(malloc)("fjalar_cache.c: saveDebugInfoCache",
+                        VG_(strlen)(cacheName) + 32);
+  VG_(sprintf)(tmpName, "%s.%d", cacheName, VG_(getpid)());
+  sr = VG_(open)(tmpName, VKI_O_CREAT | VKI_O_WRONLY | VKI_O_TRUNC, 0666);
+  if (!sr_isError(sr)) {
+    ok = writeAll(sr_Res(sr), w.bytes, w.used);
+    VG_(close)(sr_Res(sr));
+    if (!ok || VG_(rename)(tmpName, cacheName) != 0) {
+      VG_(unlink)(tmpName);
+    } else {
+      FJALAR_DPRINTF("Saved debug info to %s\n", cacheName);
+    }
+  }
+
+  VG_(free)(tmpName);
+  VG_(free)(w.bytes);
+  VG_(free)(cacheName);
+}
+
+/*------------------------------------------------------------*/
+/*--- Reading                                              ---*/
+/*------------------------------------------------------------*/
+
+typedef struct {
+  UChar* base;
+  UWord size;
+  CacheHeader* header;
+  Bool failed;
+} CacheReader;
+
+// Turns an offset back into a pointer to len bytes of the file
+static void* cachePtr(CacheReader* r, UWord off, UWord len) {
+  if (!off)
+    return 0;
+  if (off >= r->size || len > r->size - off) {
+    r->failed = True;
+    return 0;
+  }
+  return r->base + off;
+}
+
+static dwarf_entry* cacheEntry(CacheReader* r, UWord off) {
+  UWord rel;
+  if (!off)
+    return 0;
+  rel = off - r->header->entries;
+  if (off < r->header->entries || rel % sizeof(dwarf_entry) != 0 ||
+      rel / sizeof(dwarf_entry) >= r->header->num_entries) {
+    r->failed = True;
+    return 0;
+  }
+  return (dwarf_entry*)(r->base + off);
+}
+
+static XArray* cacheFileTable(CacheReader* r, UWord off) {
+  UWord* words = cachePtr(r, off, sizeof(UWord));
+  XArray* table;
+  UWord n, i;
+
+  if (!words)
+    return 0;
+  n = words[0];
+  if (!cachePtr(r, off, (n + 1) * sizeof(UWord)))
+    return 0;
+
+  table = VG_(newXA)(VG_(malloc), "fjalar_cache.c: cacheFileTable", VG_(free), sizeof(char*));
+  for (i = 0; i < n; i++) {
+    char* name = cachePtr(r, words[i + 1], 1);
+    VG_(addToXA)(table, &name);
+  }
+  return table;
+}
+
+static void relocateObject(CacheReader* r, void* obj, const CacheLayout* layout) {
+  UInt i;
+  for (i = 0; i < layout->num_fields; i++) {
+    const CacheField* f = &layout->fields[i];
+    void** slot = (void**)((char*)obj + f->offset);
+    UWord off = (UWord)*slot;
+
+    switch (f->kind) {
+    case CF_STRING:
+      *slot = cachePtr(r, off, 1);
+      break;
+    case CF_ENTRY:
+      *slot = cacheEntry(r, off);
+      break;
+    case CF_ENTRY_ARRAY: {
+      UWord n = fieldCount(obj, f), j;
+      dwarf_entry** array = cachePtr(r, off, n * sizeof(dwarf_entry*));
+      for (j = 0; array && j < n; j++) {
+        array[j] = cacheEntry(r, (UWord)array[j]);
+      }
+      *slot = array;
+      break;
+    }
+    case CF_FILE_TABLE:
+      *slot = cacheFileTable(r, off);
+      break;
+    }
+  }
+}
+
+static void* relocateValue(CacheReader* r, UWord v, CacheValueKind kind) {
+  if (kind == CV_STRING) {
+    return cachePtr(r, v, 1);
+  } else if (kind == CV_LOC_LIST) {
+    location_list* head = cachePtr(r, v, sizeof(location_list));
+    location_list* ll;
+    for (ll = head; ll; ll = ll->next) {
+      ll->next = cachePtr(r, (UWord)ll->next, sizeof(location_list));
+    }
+    return head;
+  }
+  return (void*)v;
+}
+
+static UWord* relocateTable(CacheReader* r, CacheTable* table,
+                            CacheValueKind keyKind, CacheValueKind valueKind) {
+  UWord* pairs;
+  UWord i;
+
+  if (!table->num_pairs)
+    return 0;
+  pairs = cachePtr(r, table->pairs, 2 * table->num_pairs * sizeof(UWord));
+  for (i = 0; pairs && i < table->num_pairs; i++) {
+    pairs[2 * i] = (UWord)relocateValue(r, pairs[2 * i], keyKind);
+    pairs[2 * i + 1] = (UWord)relocateValue(r, pairs[2 * i + 1], valueKind);
+  }
+  return pairs;
+}
+
+static void fillTable(struct genhashtable* ht, CacheTable* table, UWord* pairs) {
+  UWord i;
+  for (i = 0; pairs && i < table->num_pairs; i++) {
+    genputtable(ht, (void*)pairs[2 * i], (void*)pairs[2 * i + 1]);
+  }
+}
+
+static Bool readAll(Int fd, UChar* buf, UWord len) {
+  while (len) {
+    Int n = VG_(read)(fd, buf, MIN(len, 1 << 30));
+    if (n <= 0)
+      return False;
+    buf += n;
+    len -= n;
+  }
+  return True;
+}
+
+Bool loadDebugInfoCache(const HChar* filename) {
+  CacheReader r;
+  CacheHeader* h;
+  CacheKey key;
+  struct vg_stat st;
+  HChar* cacheName;
+  dwarf_entry* entries;
+  UWord* compUnits;
+  UWord* pairs[6];
+  UWord i;
+  SysRes sr;
+
+  if (!fjalar_cache_dir || fjalar_debug_dump)
+    return False;
+
+  cacheName = cacheFileName(filename, &key);
+  if (!cacheName)
+    return False;
+  sr = VG_(open)(cacheName, VKI_O_RDONLY, 0);
+  if (sr_isError(sr)) {
+    VG_(free)(cacheName);
+    return False;
+  }
+
+  VG_(memset)(&r, 0, sizeof(r));
+  if (VG_(fstat)(sr_Res(sr), &st) != 0 || st.size < (Long)sizeof(CacheHeader)) {
+    VG_(close)(sr_Res(sr));
+    VG_(free)(cacheName);
+    return False;
+  }
+
+  // This buffer becomes the home of everything in the file, so it is
+  // never freed if the load succeeds
+  r.size = st.size;
+  r.base = VG_(malloc)("fjalar_cache.c: loadDebugInfoCache", r.size);
+  r.header = h = (CacheHeader*)r.base;
+  if (!readAll(sr_Res(sr), r.base, r.size) ||
+      VG_(memcmp)(h->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      h->version != CACHE_VERSION ||
+      h->layout != cacheLayoutSignature() ||
+      VG_(memcmp)(&h->key, &key, sizeof(key)) != 0) {
+    r.failed = True;
+  }
+  VG_(close)(sr_Res(sr));
+
+  entries = 0;
+  compUnits = 0;
+  if (!r.failed && h->num_entries) {
+    entries = cachePtr(&r, h->entries, h->num_entries * sizeof(dwarf_entry));
+    if (!entries) {
+      r.failed = True;
+    }
+  }
+  if (!r.failed && h->num_comp_units) {
+    compUnits = cachePtr(&r, h->comp_units, h->num_comp_units * sizeof(UWord));
+  }
+
+  for (i = 0; !r.failed && i < h->num_entries; i++) {
+    dwarf_entry* e = &entries[i];
+    const CacheLayout* layout = layoutForTag(e->tag_name);
+    e->comp_unit = cachePtr(&r, (UWord)e->comp_unit, sizeof(compile_unit));
+    if (!layout) {
+      if (e->entry_ptr) {
+        r.failed = True;
+      }
+      continue;
+    }
+    e->entry_ptr = cachePtr(&r, (UWord)e->entry_ptr, layout->size);
+    if (e->entry_ptr) {
+      relocateObject(&r, e->entry_ptr, layout);
+    }
+  }
+  for (i = 0; !r.failed && i < h->num_comp_units; i++) {
+    compUnits[i] = (UWord)cachePtr(&r, compUnits[i], sizeof(compile_unit));
+  }
+
+  if (!r.failed) {
+    pairs[0] = relocateTable(&r, &h->function_symbols, CV_STRING, CV_WORD);
+    pairs[1] = relocateTable(&r, &h->reverse_function_symbols, CV_WORD, CV_STRING);
+    pairs[2] = relocateTable(&r, &h->variable_symbols, CV_STRING, CV_WORD);
+    pairs[3] = relocateTable(&r, &h->next_line_addrs, CV_WORD, CV_WORD);
+    pairs[4] = relocateTable(&r, &h->loc_lists, CV_WORD, CV_LOC_LIST);
+    pairs[5] = relocateTable(&r, &h->typedef_names, CV_WORD, CV_STRING);
+  }
+
+  if (r.failed) {
+    FJALAR_DPRINTF("Ignoring unusable debug info cache %s\n", cacheName);
+    VG_(free)(r.base);
+    VG_(free)(cacheName);
+    return False;
+  }
+
+  // Everything checks out, so install it all in place of what
+  // process_elf_binary_data() would have produced
+  dwarf_entry_array = entries;
+  dwarf_entry_array_size = h->num_entries;
+
+  initialize_compile_unit_array(h->num_comp_units);
+  for (i = 0; i < h->num_comp_units; i++) {
+    add_comp_unit((compile_unit*)compUnits[i]);
+  }
+
+  typedef_names_map = genallocatehashtable(0, (int (*)(void *,void *)) &equivalentIDs);
+  fillTable(FunctionSymbolTable, &h->function_symbols, pairs[0]);
+  fillTable(ReverseFunctionSymbolTable, &h->reverse_function_symbols, pairs[1]);
+  fillTable(VariableSymbolTable, &h->variable_symbols, pairs[2]);
+  fillTable(next_line_addr, &h->next_line_addrs, pairs[3]);
+  fillTable(loc_list_map, &h->loc_lists, pairs[4]);
+  fillTable(typedef_names_map, &h->typedef_names, pairs[5]);
+
+  data_section_addr = h->sections[0];
+  data_section_size = h->sections[1];
+  bss_section_addr = h->sections[2];
+  bss_section_size = h->sections[3];
+  rodata_section_addr = h->sections[4];
+  rodata_section_size = h->sections[5];
+  relrodata_section_addr = h->sections[6];
+  relrodata_section_size = h->sections[7];
+
+  FJALAR_DPRINTF("Loaded debug info from %s\n", cacheName);
+  VG_(free)(cacheName);
+  return True;
+}
@@ -0,0 +1,47 @@
+/*
+   This file is part of Fjalar, a dynamic analysis framework for C/C++
+   programs.
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* fjalar_cache.h:
+
+On-disk cache of the debugging information that readelf.c and dwarf.c
+harvest from the target binary (--fjalar-cache-dir).
+
+A cache file holds everything that process_elf_binary_data() leaves
+behind for initializeAllFjalarData(): dwarf_entry_array and the
+entries that hang off of it, the compilation units, the symbol tables,
+the line and location list tables, and the section bounds.  Every
+pointer in the file is stored as an offset from the start of the file,
+so loading it is a single read followed by one pass that turns the
+offsets back into pointers.
+
+Cache files are named after the ELF build-id of the binary (or a hash
+of its path if it has none) and its modification time, and also
+record its size, so a rebuilt binary never picks up a stale file.
+
+*/
+
+#ifndef FJALAR_CACHE_H
+#define FJALAR_CACHE_H
+
+#include "pub_tool_basics.h"
+
+// Fills in the data that process_elf_binary_data() would from the
+// cache file for filename, and returns False (having changed nothing)
+// if there is no usable one
+Bool loadDebugInfoCache(const HChar* filename);
+
+// Writes the data from the last process_elf_binary_data() call to the
+// cache file for filename
+void saveDebugInfoCache(const HChar* filename);
+
+#endif
@@ -612,6 +612,26 @@ typedef struct _FunctionEntry {
 
   unsigned long locListOffset;
 
+  // How to compute the frame base at entryPC, looked up in the
+  // location list once (by resolveFrameBase() in fjalar_main.c)
+  // instead of on every call: it is the value of DWARF register
+  // frameBaseReg plus frameBaseOffset, or unknown if frameBaseReg is
+  // -1.  frameBaseEntryPC is the entryPC that this was resolved for
+  // (0 if it hasn't been yet).
+  Addr frameBaseEntryPC;
+  int frameBaseReg;
+  Long frameBaseOffset;
+
+  // Bookkeeping for the --ppt-sample-* options: how many invocations
+  // have been seen, how many of them were passed on to the tool, and
+  // how many are still on the stack.  sampleDone is set once the
+  // budget is used up and the entry and exit instrumentation for this
+  // function has been thrown away.
+  UInt sampleSeen;
+  UInt sampleTaken;
+  UInt sampleActive;
+  Bool sampleDone;
+
   VarList formalParameters;        // List of formal parameter variables
 
   VarList localArrayAndStructVars; // Local struct and static array
@@ -654,6 +674,12 @@ typedef struct _FunctionEntry {
   // the function's formal parameters that are passed in registers.
   int formalParamLowerStackByteSize;
 
+  // True if every formal parameter lives at a fixed offset from the
+  // frame base, so that the two estimates above bound all of them.
+  // Otherwise we can't tell where the parameters are until run time
+  // and enter_function() has to copy the whole local frame.
+  Bool formalParamStackBytesKnown;
+
   // GCC 4.0+ Complicates things as it will not use Frame offsets for
   // all formal parameters. If we want to mimic the behavior achieved
   // for GCC 3.3 we'll have to keep track of the mapping between
@@ -667,6 +693,12 @@ typedef struct _FunctionEntry {
 
   UInt nonce;
 
+  // The full variable names built up while traversing the variables
+  // at this function's program points, so that later traversals can
+  // skip building them (see fjalar_traversal.c).  Indexed by
+  // [isEnter][globals, formal parameters, return value].
+  struct _TraversalPlan* traversalPlans[2][3];
+
 } FunctionEntry;
 
 
@@ -684,7 +716,7 @@ FunctionEntry* getFunctionEntryFromFjalarName(char* fjalar_name);
 
 // Returns a FunctionEntry* given an address within the range of
 // [startPC, endPC], inclusive
-// [Slow linear search lookup]
+// [Binary search over an index built by initializeAllFjalarData()]
 FunctionEntry* getFunctionEntryFromAddr(Addr addr);
 
 
@@ -764,9 +796,17 @@ typedef struct {
   // exit (but changes made via params passed by pointers are
   // visible).  This is okay and justified because local changes
   // should be invisible to the calling function anyways.
+  // (Only the part starting at virtualStackCopyOffset is actually
+  // copied; the bytes below it are left inaccessible.)
   char* virtualStack;
   int virtualStackByteSize; // Number of 1-byte entries in virtualStack
   int virtualStackFPOffset; // Where in the stack the frame pointer was
+  int virtualStackCopyOffset; // Where in the stack the copy starts
+
+  // False if the --ppt-sample-* options skipped this invocation, in
+  // which case the tool isn't told about it at all (and there is no
+  // virtualStack)
+  Bool sampled;
 
 
   Addr lowSP;
@@ -1080,6 +1120,10 @@ Bool fjalar_gcc3;                          // --gcc3
 
 int  fjalar_array_length_limit;            // --array-length-limit
 
+UInt fjalar_ppt_sample_rate;               // --ppt-sample-rate
+UInt fjalar_ppt_sample_backoff;            // --ppt-sample-backoff
+UInt fjalar_ppt_sample_budget;             // --ppt-sample-budget
+
 UInt fjalar_max_visit_struct_depth;        // --struct-depth
 UInt fjalar_max_visit_nesting_depth;       // --nesting-depth
 
@@ -1092,6 +1136,8 @@ const HChar* fjalar_trace_prog_pts_filename;      // --ppt-list-file
 const HChar* fjalar_trace_vars_filename;          // --var-list-file
 const HChar* fjalar_disambig_filename;            // --disambig-file
 const HChar* fjalar_xml_output_filename;          // --xml-output-file
+const HChar* fjalar_cache_dir;                    // --fjalar-cache-dir
+const HChar* fjalar_trace_shared_libs;            // --trace-shared-libs
 
 
 /*********************************************************************
@@ -1117,6 +1163,9 @@ unsigned int hashString(const char* str);
 // Only relevant if the --ppt-list-file option is used (and
 // fjalar_trace_prog_pts_filename is non-null)
 Bool prog_pts_tree_entry_found(FunctionEntry* cur_entry);
+// Like prog_pts_tree_entry_found(), but for a function we only know
+// the symbol table name of (may return false positives)
+Bool prog_pts_tree_may_contain_symbol(const char* fnname);
 
 #define MAX_STRING_STACK_SIZE 100
 
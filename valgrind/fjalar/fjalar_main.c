@@ -45,8 +45,11 @@
 #include "fjalar_runtime.h"
 #include "fjalar_tool.h"
 #include "fjalar_select.h"
+#include "fjalar_cache.h"
+#include "fjalar_objects.h"
 #include "disambig.h"
 #include "mc_include.h"
+#include "../coregrind/pub_core_transtab.h"  // needed for discard_translations
 #include "typedata.h"
 #include "vex_common.h"
 #include "kvasir/kvasir_main.h"
@@ -72,6 +75,11 @@ Bool fjalar_func_disambig_ptrs = False;
 Bool fjalar_disambig_ptrs = False;
 int  fjalar_array_length_limit = -1;
 
+// 0 means that the policy is off:
+UInt fjalar_ppt_sample_rate = 0;
+UInt fjalar_ppt_sample_backoff = 0;
+UInt fjalar_ppt_sample_budget = 0;
+
 // adjustable via the --struct-depth=N option:
 UInt fjalar_max_visit_struct_depth = 4;
 // adjustable via the --nesting-depth=N option:
@@ -87,6 +95,8 @@ const HChar* fjalar_trace_prog_pts_filename = 0;
 const HChar* fjalar_trace_vars_filename = 0;
 const HChar* fjalar_disambig_filename = 0;
 const HChar* fjalar_xml_output_filename = 0;
+const HChar* fjalar_cache_dir = 0;
+const HChar* fjalar_trace_shared_libs = 0;
 
 // Are we printing decls because we are debugging?
 Bool doing_debug_print = False;
@@ -194,6 +204,74 @@ int *fn_stack_first_free_index;
 // The top element of the stack is:
 // FunctionExecutionStateStack[fn_stack_first_free_index - 1]
 
+// Finds the entry of f's location list which covers f->entryPC and
+// stores the register and offset that it computes the frame base from
+// in f, so that enter_function() doesn't have to search the list on
+// every call.
+static void resolveFrameBase(FunctionEntry* f) {
+  Addr eip = f->entryPC - f->cuBase;
+  location_list *ll = 0;
+  struct genhashtable* lists;
+  PtrdiffT bias;
+
+  f->frameBaseEntryPC = f->entryPC;
+  f->frameBaseReg = -1;
+  f->frameBaseOffset = 0;
+
+  if (!f->locList) {
+    return;
+  }
+
+  FJALAR_DPRINTF("\tCurrent EIP is: %x\n", (UInt)eip);
+  FJALAR_DPRINTF("\tLocation list based function(offset from base: %x). offset is %lu\n",(UInt)eip, f->locListOffset);
+
+  // Functions from shared libraries have their own location lists,
+  // whose addresses haven't been relocated
+  lists = getLocationListsForFunction(f, &bias);
+  if (gencontains(lists, (void *)f->locListOffset)) {
+    ll = gengettable(lists, (void *)f->locListOffset);
+  }
+
+  // (comment added 2009)  
+  // HACK. g++ and GCC handle location lists differently. GCC puts lists offsets
+  // relative to the compilation unit, g++ uses the actual address. I'm going to
+  // compare the location list ranges both to the cu_base offset, as well as
+  // the function's entry point. This might break if there's every a case
+  // where the compilation unit offset is a valid address in the program
+  while(ll &&
+        !(((ll->begin <= eip) && (ll->end >= eip)) ||
+          ((ll->begin <= f->entryPC - bias) && (ll->end >= f->entryPC - bias)))) {
+    FJALAR_DPRINTF("\tExamining loc list entry: %x - %x - %x\n", (UInt)ll->offset, (UInt)ll->begin, (UInt)ll->end);
+    ll = ll->next;
+  }
+
+  if(ll) {
+    FJALAR_DPRINTF("\tFound location list entry, finding location corresponding to dwarf #: %d with offset: %lld\n", ll->atom, ll->atom_offset);
+
+    // (comment added 2013)  
+    // It turns out it might not be just the contents of a register.  Some
+    // 32bit x86 code does some tricky stack alignment and has to save a
+    // pointer to the orginal stack frame.  This means we get passed a 
+    // DW_OP_deref instead of a DW_OP_breg.  The tricky bit is we don't
+    // want to go back to that address because it probably won't be equal
+    // to the local frame pointer due to the stack alignment.  So the HACK
+    // is to just assume the frame pointer is at EBP+8 like normal.  (markro)
+    if (ll->atom == DW_OP_deref) {
+      f->frameBaseReg = DW_OP_breg5 - DW_OP_breg0;
+      f->frameBaseOffset = 8;
+    }
+    else if ((ll->atom >= DW_OP_breg0) &&
+             (ll->atom - DW_OP_breg0 < sizeof(get_reg) / sizeof(get_reg[0]))) {
+      f->frameBaseReg = ll->atom - DW_OP_breg0;
+      f->frameBaseOffset = ll->atom_offset;
+    }
+
+    if ((f->frameBaseReg >= 0) && !get_reg[f->frameBaseReg]) {
+      f->frameBaseReg = -1;
+    }
+  }
+}
+
 typedef VG_REGPARM(1) void entry_func(FunctionEntry *);
 
 // This inserts an IR Statement responsible for calling func
@@ -219,7 +297,10 @@ static void handle_possible_entry_func(MCEnv *mce, Addr64 addr,
   // file), then DO NOT generate IR code to call helper functions for
   // functions whose name is NOT located in prog_pts_tree. It's faster
   // to filter them out at translation-time instead of run-time
-  if (entry && (!fjalar_trace_prog_pts_filename ||
+  // Likewise for functions that have used up their
+  // --ppt-sample-budget.
+  if (entry && !entry->sampleDone &&
+      (!fjalar_trace_prog_pts_filename ||
 		prog_pts_tree_entry_found(entry))) {
     UWord entry_w = (UWord)entry;
     di = unsafeIRDirty_0_N(1/*regparms*/, func_name, func,
@@ -230,6 +311,7 @@ static void handle_possible_entry_func(MCEnv *mce, Addr64 addr,
     // the proper annotations:
 
     entry->entryPC = addr;
+    resolveFrameBase(entry);
 
     FJALAR_DPRINTF("Found a valid entry point at %x for\n", (UInt)addr);
 
@@ -310,6 +392,11 @@ void handle_possible_entry(MCEnv* mce, Addr64 addr, IRSB* bb_orig) {
   // properly:
   currentAddr = (Addr)addr;
 
+  // This may add functions to FunctionTable, so it has to come first
+  if (fjalar_trace_shared_libs) {
+    loadSharedObjectForAddr((Addr)addr);
+  }
+
   if(!fjalar_gcc3) {
     FunctionEntry *entry = gengettable(FunctionTable, (void *)(Addr)addr);
     if(entry) {
@@ -435,6 +522,7 @@ void handle_possible_exit(MCEnv* mce, IRJumpKind jk) {
     FunctionEntry* curFuncPtr = getFunctionEntryFromAddr(currentAddr);
 
     if (curFuncPtr &&
+	!curFuncPtr->sampleDone &&
 	// Also, if fjalar_trace_prog_pts_filename is on (we are
 	// reading in a ppt list file), then DO NOT generate IR code
 	// to call helper functions for functions whose names are NOT
@@ -520,6 +608,175 @@ VG_REGPARM(1) void prime_function(FunctionEntry *f)
 }
 
 
+// FJALAR VIRTUAL STACK ARENA
+// Virtual stacks are pushed and popped along with
+// FunctionExecutionStateStack, so rather than VG_(calloc) and
+// VG_(free) one on every call, each thread carves them out of a list
+// of chunks which grows like a stack and is never given back.  Its
+// free space is always kept inaccessible (as far as the A-bits are
+// concerned) so that the parts of a virtual stack which we don't copy
+// read as invalid, just like they would in freshly VG_(calloc)ed
+// memory.
+
+#define VIRTUAL_STACK_CHUNK_SIZE (256 * 1024)
+
+typedef struct _VirtualStackChunk {
+  struct _VirtualStackChunk* prev;
+  struct _VirtualStackChunk* next;
+  char* base;
+  SizeT size;
+  SizeT used;
+} VirtualStackChunk;
+
+// The chunk that the top of each thread's virtual stack is in
+static VirtualStackChunk** virtualStackTop = 0;
+
+static char* virtualStackAlloc(ThreadId tid, SizeT size) {
+  VirtualStackChunk* chunk = virtualStackTop[tid];
+  char* p;
+
+  // Keep every virtual stack word-aligned
+  size = (size + sizeof(Addr) - 1) & ~(sizeof(Addr) - 1);
+
+  // Move on to the next chunk (which is empty because we're at the
+  // top of the stack) if this one is full, and make a new one if
+  // there isn't one or it's too small
+  while (!chunk || (chunk->size - chunk->used < size)) {
+    VirtualStackChunk* next = chunk ? chunk->next : 0;
+    if (next && (next->size < size)) {
+      // Drop it: later chunks can't be in use either
+      tl_assert(next->used == 0);
+      if (next->next) {
+        next->next->prev = chunk;
+      }
+      if (chunk) {
+        chunk->next = next->next;
+      }
+      VG_(free)(next->base);
+      VG_(free)(next);
+      continue;
+    }
+    if (!next) {
+      next = VG_(calloc)("fjalar_main.c: virtualStackAlloc.1", 1, sizeof(*next));
+      next->size = (size > VIRTUAL_STACK_CHUNK_SIZE) ? size : VIRTUAL_STACK_CHUNK_SIZE;
+      next->base = VG_(malloc)("fjalar_main.c: virtualStackAlloc.2", next->size);
+      mc_make_noaccess((Addr)next->base, next->size);
+      next->prev = chunk;
+      if (chunk) {
+        next->next = chunk->next;
+        chunk->next = next;
+      }
+    }
+    chunk = next;
+    virtualStackTop[tid] = chunk;
+  }
+
+  p = chunk->base + chunk->used;
+  chunk->used += size;
+  return p;
+}
+
+// Pops p, and everything that was allocated after it, off of the
+// virtual stack of thread tid.  [copyStart, copyEnd) is the part of p
+// which was made accessible, and so has to be made inaccessible again
+// (everything above p has already been taken care of).
+static void virtualStackRelease(ThreadId tid, char* p,
+                                char* copyStart, char* copyEnd) {
+  VirtualStackChunk* chunk = virtualStackTop[tid];
+
+  tl_assert(chunk);
+  while ((p < chunk->base) || (p >= chunk->base + chunk->size)) {
+    chunk->used = 0;
+    chunk = chunk->prev;
+    tl_assert(chunk);
+  }
+  virtualStackTop[tid] = chunk;
+
+  if (copyEnd > copyStart) {
+    mc_make_noaccess((Addr)copyStart, copyEnd - copyStart);
+  }
+  chunk->used = p - chunk->base;
+}
+
+// Releases the virtual stack of an entry which is about to be popped
+static void releaseVirtualStack(ThreadId tid, FunctionExecutionState* entry) {
+  if (entry->virtualStack) {
+    virtualStackRelease(tid, entry->virtualStack,
+                        entry->virtualStack + entry->virtualStackCopyOffset,
+                        entry->virtualStack + entry->virtualStackByteSize);
+    entry->virtualStack = 0;
+  }
+}
+
+
+// PROGRAM POINT SAMPLING
+// The --ppt-sample-* options decide at each function entrance whether
+// the tool gets to see this invocation (at both entrance and exit).
+// The policies combine: an invocation is sampled only if each policy
+// that is on agrees.
+static Bool sampleThisInvocation(FunctionEntry* f) {
+  UInt n = f->sampleSeen++;
+
+  if (fjalar_ppt_sample_budget &&
+      (f->sampleTaken >= fjalar_ppt_sample_budget)) {
+    return False;
+  }
+
+  // 1 in every fjalar_ppt_sample_rate invocations
+  if (fjalar_ppt_sample_rate && ((n % fjalar_ppt_sample_rate) != 0)) {
+    return False;
+  }
+
+  // All of the first K invocations, then invocations K, 2K, 4K, ...
+  if (fjalar_ppt_sample_backoff && (n >= fjalar_ppt_sample_backoff)) {
+    UInt q = n / fjalar_ppt_sample_backoff;
+    if ((n % fjalar_ppt_sample_backoff) || (q & (q - 1))) {
+      return False;
+    }
+  }
+
+  f->sampleTaken++;
+  return True;
+}
+
+// Called whenever an invocation of f is popped off the stack.  Once f
+// has used up its budget and no invocation of it is left on any
+// stack, we throw away every translation that overlaps f's code, and
+// handle_possible_entry_func() and handle_possible_exit() leave f
+// alone when it is translated again, so that it runs at plain
+// Memcheck speed from then on.  Tools can normally only discard
+// translations from a client request, but we're called from the
+// helper at the end of a superblock, and the code that it returns to
+// stays in the translation cache until its sector is recycled, so
+// it's safe to finish running it.
+static void sampleRetire(FunctionEntry* f) {
+  tl_assert(f->sampleActive > 0);
+  f->sampleActive--;
+
+  if (fjalar_ppt_sample_budget && !f->sampleDone &&
+      (f->sampleActive == 0) &&
+      (f->sampleTaken >= fjalar_ppt_sample_budget)) {
+    f->sampleDone = True;
+    FJALAR_DPRINTF("[sampleRetire] %s used up its budget of %u after %u invocations\n",
+                   f->fjalar_name, fjalar_ppt_sample_budget, f->sampleSeen);
+    VG_(discard_translations)(f->startPC, f->endPC - f->startPC + 1,
+                              "fjalar --ppt-sample-budget");
+  }
+}
+
+// Pops the top entry off of tid's stack, along with its virtual stack
+static void popFunctionExecutionState(ThreadId tid) {
+  FunctionExecutionState* top = fnStackTop(tid);
+  FunctionEntry* f = top->func;
+
+  releaseVirtualStack(tid, top);
+  fnStackPop(tid);
+  if (f) {
+    sampleRetire(f);
+  }
+}
+
+
 static UInt cur_nonce = 0;
 /*
 This is the hook into Valgrind that is called whenever the target
@@ -536,7 +793,7 @@ void enter_function(FunctionEntry* f)
   ThreadId tid = VG_(get_running_tid)();
   Addr stack_ptr= VG_(get_SP)(tid);
   Addr frame_ptr = 0; /* E.g., %ebp */
-  int local_stack, size;
+  int local_stack, size, copy_offset;
 
   FJALAR_DPRINTF("[enter_function] startPC is: %x, entryPC is: %x, cu_base: %p\n",
                  (UInt)f->startPC, (UInt)f->entryPC,(void *)f->cuBase);
@@ -554,50 +811,13 @@ void enter_function(FunctionEntry* f)
   // It usually points just above the function return address.  The
   // .debug_loc info tells how to find (calculate) the frame base
   // at any point in the program.   (markro)
-  if(f->locList) {
-    Addr eip = f->entryPC;
-    location_list *ll;
-    eip =  eip - f->cuBase;
-
-    FJALAR_DPRINTF("\tCurrent EIP is: %x\n", (UInt)eip);
-    FJALAR_DPRINTF("\tLocation list based function(offset from base: %x). offset is %lu\n",(UInt)eip, f->locListOffset);
-
-    if (gencontains(loc_list_map, (void *)f->locListOffset)) {
-      ll = gengettable(loc_list_map, (void *)f->locListOffset);
-
-      // (comment added 2009)  
-      // HACK. g++ and GCC handle location lists differently. GCC puts lists offsets
-      // relative to the compilation unit, g++ uses the actual address. I'm going to
-      // compare the location list ranges both to the cu_base offset, as well as
-      // the function's entry point. This might break if there's every a case
-      // where the compilation unit offset is a valid address in the program
-      while(ll &&
-            !(((ll->begin <= eip) && (ll->end >= eip)) ||
-              ((ll->begin <= f->entryPC) && (ll->end >= f->entryPC)))) {
-        FJALAR_DPRINTF("\tExamining loc list entry: %x - %x - %x\n", (UInt)ll->offset, (UInt)ll->begin, (UInt)ll->end);
-        ll = ll->next;
-      }
-
-      if(ll) {
-        FJALAR_DPRINTF("\tFound location list entry, finding location corresponding to dwarf #: %d with offset: %lld\n", ll->atom, ll->atom_offset);
-
-        // (comment added 2013)  
-        // It turns out it might not be just the contents of a register.  Some
-        // 32bit x86 code does some tricky stack alignment and has to save a
-        // pointer to the orginal stack frame.  This means we get passed a 
-        // DW_OP_deref instead of a DW_OP_breg.  The tricky bit is we don't
-        // want to go back to that address because it probably won't be equal
-        // to the local frame pointer due to the stack alignment.  So the HACK
-        // is to just assume the frame pointer is at EBP+8 like normal.  (markro)
-        if (ll->atom == DW_OP_deref) {
-            ll->atom = DW_OP_breg5;
-            ll->atom_offset = 8;
-        }    
-        if(get_reg[ll->atom - DW_OP_breg0]) {
-          frame_ptr = (*get_reg[ll->atom - DW_OP_breg0])(tid) + ll->atom_offset;
-        }
-      }
-    }
+  // The location list is only searched once per entryPC; see
+  // resolveFrameBase().
+  if (f->frameBaseEntryPC != f->entryPC) {
+    resolveFrameBase(f);
+  }
+  if (f->frameBaseReg >= 0) {
+    frame_ptr = (*get_reg[f->frameBaseReg])(tid) + f->frameBaseOffset;
   }
 
 
@@ -639,6 +859,18 @@ void enter_function(FunctionEntry* f)
   newEntry->invocation_nonce = cur_nonce++;
   newEntry->func->nonce = newEntry->invocation_nonce;
 
+  newEntry->sampled = sampleThisInvocation(f);
+  f->sampleActive++;
+  if (!newEntry->sampled) {
+    // Keep the entry on the stack so that the exit still matches up,
+    // but don't bother with the virtual stack or the tool
+    newEntry->virtualStack = 0;
+    newEntry->virtualStackByteSize = 0;
+    newEntry->virtualStackFPOffset = 0;
+    newEntry->virtualStackCopyOffset = 0;
+    return;
+  }
+
   // FJALAR VIRTUAL STACK
   // Fjalar maintains a virtual stack for invocation a function. This
   // allows Fjalar to provide tools with unaltered values of formal
@@ -672,25 +904,40 @@ void enter_function(FunctionEntry* f)
 
   tl_assert(size >= 0);
   if (size != 0) {
-    newEntry->virtualStack = VG_(calloc)("fjalar_main.c: enter_func",  size, sizeof(char));
+    newEntry->virtualStack = virtualStackAlloc(tid, size);
     newEntry->virtualStackByteSize = size;
     newEntry->virtualStackFPOffset = local_stack;
 
+    // Formal parameters are the only things read from the virtual
+    // stack, so if we know where they all are, there's no need to
+    // copy the part of the local frame below the lowest one
+    if (f->formalParamStackBytesKnown) {
+      copy_offset = local_stack - f->formalParamLowerStackByteSize;
+      if (copy_offset < 0)
+        copy_offset = 0;
+    }
+    else {
+      copy_offset = 0;
+    }
+    newEntry->virtualStackCopyOffset = copy_offset;
+
     clear_all_tags_in_range(stack_ptr - VG_STACK_REDZONE_SZB, VG_STACK_REDZONE_SZB - delta);
 
-    VG_(memcpy)(newEntry->virtualStack,
-		(char*)stack_ptr - VG_STACK_REDZONE_SZB, size);
+    VG_(memcpy)(newEntry->virtualStack + copy_offset,
+		(char*)stack_ptr - VG_STACK_REDZONE_SZB + copy_offset,
+		size - copy_offset);
 
     // VERY IMPORTANT!!! Copy all the A & V bits over the real stack to
     // virtualStack!!!  (As a consequence, this copies over the tags
     // as well - look in mc_main.c). Note that the way do this means
     // that the copy is now guest-accessible, if they guessed the
-    // VG_(calloc)ed address, which is a bit weird. It would be more
+    // address of the arena, which is a bit weird. It would be more
     // elegant to copy the metadata to an inaccessible place, but that
     // would be more work.
-    FJALAR_DPRINTF("Copying over stack [%p] -> [%p] %d bytes\n",(void *)(stack_ptr - VG_STACK_REDZONE_SZB),  (void *)newEntry->virtualStack, size);
-    mc_copy_address_range_state(stack_ptr - VG_STACK_REDZONE_SZB,
-				(Addr)(newEntry->virtualStack), size);
+    FJALAR_DPRINTF("Copying over stack [%p] -> [%p] %d bytes\n",(void *)(stack_ptr - VG_STACK_REDZONE_SZB + copy_offset),  (void *)(newEntry->virtualStack + copy_offset), size - copy_offset);
+    mc_copy_address_range_state(stack_ptr - VG_STACK_REDZONE_SZB + copy_offset,
+				(Addr)(newEntry->virtualStack + copy_offset),
+				size - copy_offset);
 
 
     newEntry->func->guestStackStart = stack_ptr - VG_STACK_REDZONE_SZB;
@@ -832,12 +1079,17 @@ void exit_function(FunctionEntry* f)
       if(top->func == f) {
         break;
       }
-      fnStackPop(currentTID);
+      popFunctionExecutionState(currentTID);
     }
 
     tl_assert(top->func == f);
   }
 
+  if (!top->sampled) {
+    popFunctionExecutionState(currentTID);
+    return;
+  }
+
   top->xAX = xAX;
   top->xDX = xDX;
   top->FPU = fpuReturnVal;
@@ -864,18 +1116,6 @@ void exit_function(FunctionEntry* f)
 
   fjalar_tool_handle_function_exit(top);
 
-  // Destroy the memory allocated by virtualStack
-  // AFTER the tool has handled the exit
-  if (top->virtualStack) {
-    /* We were previously using the V bits associated with the area to
-       store guest V bits, but Memcheck doesn't normally expect
-       VG_(malloc)'ed memory to be client accessible, so we have to
-       make it inaccessible again before allowing Valgrind's malloc to
-       use it, lest assertions fail later. */
-    mc_make_noaccess((Addr)top->virtualStack, top->virtualStackByteSize);
-    VG_(free)(top->virtualStack);
-  }
-
   // Pop at the VERY end after the tool is done handling the exit.
   // This is subtle but important - this must be done AFTER the tool
   // runs all of it's function exit code, as functions in fjalar_traversal
@@ -883,7 +1123,12 @@ void exit_function(FunctionEntry* f)
   // pop the function, however, the stack will be left in an inconsistant
   // state and the "!top->func == f" check will fail causing no more
   // program points to be printed.
-  fnStackPop(currentTID);
+  /* This also gives back the memory of virtualStack.  We were
+     previously using the V bits associated with the area to store
+     guest V bits, but Memcheck doesn't normally expect VG_(malloc)'ed
+     memory to be client accessible, so releaseVirtualStack() makes it
+     inaccessible again, lest assertions fail later. */
+  popFunctionExecutionState(currentTID);
 
 }
 
@@ -993,6 +1238,7 @@ void fjalar_pre_clo_init()
 {
    fn_stack_first_free_index = VG_(malloc)("fjalar_main.c: fjalar_pre_clo_init1", VG_N_THREADS * sizeof fn_stack_first_free_index[0]);
    FunctionExecutionStateStack = VG_(malloc)("fjalar_main.c: fjalar_pre_clo_init2", VG_N_THREADS * FN_STACK_SIZE * sizeof FunctionExecutionStateStack[0][0]);
+   virtualStackTop = VG_(calloc)("fjalar_main.c: fjalar_pre_clo_init3", VG_N_THREADS, sizeof virtualStackTop[0]);
 
   // Clear FunctionExecutionStateStack
 /*   VG_(memset)(FunctionExecutionStateStack, 0, */
@@ -1058,8 +1304,13 @@ void fjalar_post_clo_init()
 
   FJALAR_DPRINTF("Typedata structures completed\n");
 
-  // Calls into readelf.c:
-  process_elf_binary_data(executable_filename);
+  // Calls into readelf.c, unless an earlier run on the same binary
+  // left the results in --fjalar-cache-dir:
+  if (!loadDebugInfoCache(executable_filename)) {
+    if (process_elf_binary_data(executable_filename) == 0) {
+      saveDebugInfoCache(executable_filename);
+    }
+  }
 
   FJALAR_DPRINTF("Process elf binary completed\n");
   // Call this BEFORE initializeAllFjalarData() so that the vars_tree
@@ -1099,6 +1350,15 @@ void fjalar_print_usage()
 "    --ignore-static-vars     Ignores all static variables [--no-ignore-static-vars]\n"
 "    --ignore-constants       Ignores all constant variables [--no-ignore-constants]\n"
 "    --all-static-vars        Output all static vars [--no-all-static-vars]\n"
+"    --trace-shared-libs=<pattern>  Also trace functions in the shared libraries\n"
+"                             whose paths match <pattern> (e.g. '*/libfoo*.so')\n"
+
+"\n  Program point sampling (0 turns a policy off; they can be combined):\n"
+"    --ppt-sample-rate=N      Only trace 1 in every N invocations of each function\n"
+"    --ppt-sample-backoff=K   Trace the first K invocations of each function, then\n"
+"                             only invocations K, 2K, 4K, 8K, ...\n"
+"    --ppt-sample-budget=N    Trace at most N invocations of each function, then\n"
+"                             stop instrumenting it altogether\n"
 
 "\n  Pointer type disambiguation:\n"
 "    --disambig-file=<string> Reads in disambig file if exists; otherwise creates one\n"
@@ -1118,6 +1378,8 @@ void fjalar_print_usage()
 "                             defined structures (i.e. linked lists) to N (default is 4)\n"
 "                             (N must be an integer between 0 and 100)\n"
 "    --output-struct-vars     Outputs struct variables along with their contents\n"
+"    --fjalar-cache-dir=<dir>  Saves the debugging information read from the binary\n"
+"                             in <dir> and reuses it on later runs of the same binary\n"
 
 "\n  Debugging:\n"
 "    --xml-output-file=<string>  Output declarations in XML format to a file\n"
@@ -1158,6 +1420,12 @@ Bool fjalar_process_cmd_line_option(const HChar* arg)
   else if VG_YESNO_CLO(arg, "disambig-ptrs", fjalar_disambig_ptrs) {}
   else if VG_BINT_CLO(arg, "--array-length-limit", fjalar_array_length_limit,
 		      -1, 0x7fffffff) {}
+  else if VG_BINT_CLO(arg, "--ppt-sample-rate", fjalar_ppt_sample_rate,
+		      0, 0x7fffffff) {}
+  else if VG_BINT_CLO(arg, "--ppt-sample-backoff", fjalar_ppt_sample_backoff,
+		      0, 0x7fffffff) {}
+  else if VG_BINT_CLO(arg, "--ppt-sample-budget", fjalar_ppt_sample_budget,
+		      0, 0x7fffffff) {}
 
   /* else if VG_BINT_CLO(arg, "--struct-depth",  fjalar_max_visit_struct_depth, 0, 100)  {} // [0 to 100]
      else if VG_BINT_CLO(arg, "--nesting-depth", fjalar_max_visit_nesting_depth, 0, 100) {} // [0 to 100] */
@@ -1171,6 +1439,8 @@ Bool fjalar_process_cmd_line_option(const HChar* arg)
   else if VG_STR_CLO(arg, "--var-list-file",  fjalar_trace_vars_filename) {}
   else if VG_STR_CLO(arg, "--disambig-file",  fjalar_disambig_filename) {}
   else if VG_STR_CLO(arg, "--xml-output-file", fjalar_xml_output_filename) {}
+  else if VG_STR_CLO(arg, "--fjalar-cache-dir", fjalar_cache_dir) {}
+  else if VG_STR_CLO(arg, "--trace-shared-libs", fjalar_trace_shared_libs) {}
   else
     return fjalar_tool_process_cmd_line_option(arg);
 
@@ -0,0 +1,247 @@
+/*
+   This file is part of Fjalar, a dynamic analysis framework for C/C++
+   programs.
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* fjalar_objects.c:
+
+Reads the DWARF debug. info. of shared libraries on demand
+(--trace-shared-libs).  See fjalar_objects.h.
+
+*/
+
+#include "my_libc.h"
+
+#include "fjalar_main.h"
+#include "fjalar_objects.h"
+#include "fjalar_cache.h"
+#include "fjalar_tool.h"
+#include "generate_fjalar_entries.h"
+#include "typedata.h"
+
+#include "pub_tool_debuginfo.h"
+#include "pub_tool_seqmatch.h"
+
+// located in typedata.c
+extern struct genhashtable* typedef_names_map;
+
+// A shared library that Valgrind has read debug. info. for
+typedef struct {
+  Addr textStart;
+  SizeT textSize;
+  PtrdiffT bias;               // Load address - link-time address
+  HChar* filename;
+  Bool loaded;                 // We have read its DWARF (or given up on it)
+  Bool unmapped;               // Something else has been mapped over it
+  struct genhashtable* locLists; // Its loc_list_map, once loaded
+} SharedObject;
+
+static SharedObject* sharedObjects = 0;
+static UInt numSharedObjects = 0;
+static UInt maxSharedObjects = 0;
+
+// How many entries of sharedObjects have code but haven't been
+// loaded, so that loadSharedObjectForAddr() can return right away
+// when there aren't any
+static UInt numPendingSharedObjects = 0;
+
+// How many entries of sharedObjects have their own locLists
+static UInt numLoadedSharedObjects = 0;
+
+static SharedObject* addSharedObject(Addr textStart, SizeT textSize,
+                                     PtrdiffT bias, const HChar* filename) {
+  SharedObject* obj;
+
+  if (numSharedObjects == maxSharedObjects) {
+    maxSharedObjects = maxSharedObjects ? 2 * maxSharedObjects : 16;
+    sharedObjects = VG_(realloc)("fjalar_objects.c: addSharedObject",
+                                 sharedObjects,
+                                 maxSharedObjects * sizeof(*sharedObjects));
+  }
+
+  obj = &sharedObjects[numSharedObjects++];
+  obj->textStart = textStart;
+  obj->textSize = textSize;
+  obj->bias = bias;
+  obj->filename = VG_(strdup)("fjalar_objects.c: addSharedObject", filename);
+  obj->loaded = False;
+  obj->unmapped = False;
+  obj->locLists = 0;
+  return obj;
+}
+
+void registerSharedObjects(Bool atStartup) {
+  const DebugInfo* di;
+
+  for (di = VG_(next_DebugInfo)(0); di; di = VG_(next_DebugInfo)(di)) {
+    Addr textStart = VG_(DebugInfo_get_text_avma)(di);
+    SizeT textSize = VG_(DebugInfo_get_text_size)(di);
+    const HChar* filename = VG_(DebugInfo_get_filename)(di);
+    Bool known = False;
+    SharedObject* obj;
+    UInt i;
+
+    if (!textSize || !filename) {
+      continue;
+    }
+
+    for (i = 0; i < numSharedObjects; i++) {
+      obj = &sharedObjects[i];
+      if (obj->unmapped ||
+          (obj->textStart + obj->textSize <= textStart) ||
+          (textStart + textSize <= obj->textStart)) {
+        continue;
+      }
+      if ((obj->textStart == textStart) && (obj->textSize == textSize) &&
+          VG_STREQ(obj->filename, filename)) {
+        known = True;
+      }
+      // Something else has been mapped where this library used to
+      // be.  (If we had loaded it, its functions stay in
+      // FunctionTable, since the program may still have them on the
+      // stack.)
+      else {
+        FJALAR_DPRINTF("Shared library %s is gone\n", obj->filename);
+        if (!obj->loaded) {
+          obj->loaded = True;
+          numPendingSharedObjects--;
+        }
+        obj->unmapped = True;
+      }
+    }
+
+    if (known) {
+      continue;
+    }
+
+    // The executable and the dynamic linker are already there at
+    // startup, and we never want to load them a second time
+    if (atStartup) {
+      obj = addSharedObject(textStart, textSize, 0, filename);
+      obj->loaded = True;
+      continue;
+    }
+
+    if (!VG_(string_match)(fjalar_trace_shared_libs, filename)) {
+      continue;
+    }
+
+    FJALAR_DPRINTF("Registered shared library %s: code at %p (%lu bytes)\n",
+                   filename, (void*)textStart, (unsigned long)textSize);
+
+    addSharedObject(textStart, textSize,
+                    VG_(DebugInfo_get_text_bias)(di), filename);
+    numPendingSharedObjects++;
+  }
+}
+
+// Reads obj's DWARF debug. info. and adds its functions to
+// FunctionTable, leaving the executable's debug. info. as it was
+static void loadSharedObject(SharedObject* obj) {
+  typedata_state executableState;
+  FunctionEntry** added = 0;
+  UInt numAdded = 0;
+  Bool ok;
+
+  FJALAR_DPRINTF("Loading debug info for shared library %s\n", obj->filename);
+
+  obj->loaded = True;
+  numPendingSharedObjects--;
+
+  save_typedata_state(&executableState);
+  initialize_typedata_structures();
+
+  ok = loadDebugInfoCache(obj->filename);
+  if (!ok && (process_elf_binary_data(obj->filename) == 0)) {
+    saveDebugInfoCache(obj->filename);
+    ok = True;
+  }
+
+  if (ok) {
+    added = addSharedObjectFunctions(obj->bias, &numAdded);
+  }
+
+  // The entries made from this library's DWARF data point into it,
+  // so only the lookup tables can go
+  if (numAdded) {
+    obj->locLists = loc_list_map;
+    numLoadedSharedObjects++;
+  }
+  else {
+    genfreehashtable(loc_list_map);
+  }
+  genfreehashtable(FunctionSymbolTable);
+  genfreehashtable(ReverseFunctionSymbolTable);
+  genfreehashtable(VariableSymbolTable);
+  genfreehashtable(next_line_addr);
+  if (typedef_names_map) {
+    genfreehashtable(typedef_names_map);
+  }
+
+  restore_typedata_state(&executableState);
+
+  if (added) {
+    fjalar_tool_handle_new_functions(added, numAdded);
+    VG_(free)(added);
+  }
+
+  FJALAR_DPRINTF("Added %u functions from shared library %s\n",
+                 numAdded, obj->filename);
+}
+
+void loadSharedObjectForAddr(Addr addr) {
+  const HChar* fnname;
+  UInt i;
+
+  if (!numPendingSharedObjects) {
+    return;
+  }
+
+  for (i = 0; i < numSharedObjects; i++) {
+    SharedObject* obj = &sharedObjects[i];
+
+    if (obj->loaded ||
+        (addr < obj->textStart) || (addr >= obj->textStart + obj->textSize)) {
+      continue;
+    }
+
+    // Only functions that we will actually trace are worth reading
+    // the debug. info. for.  We don't have Fjalar names without the
+    // debug. info., so go by the symbol table.
+    if (VG_(get_fnname_if_entry)(addr, &fnname) &&
+        (!fjalar_trace_prog_pts_filename ||
+         prog_pts_tree_may_contain_symbol(fnname))) {
+      loadSharedObject(obj);
+    }
+    return;
+  }
+}
+
+struct genhashtable* getLocationListsForFunction(FunctionEntry* f,
+                                                 PtrdiffT* bias) {
+  UInt i;
+
+  // Newest first, in case a library has been mapped over an old one
+  if (numLoadedSharedObjects) {
+    for (i = numSharedObjects; i-- > 0; ) {
+      SharedObject* obj = &sharedObjects[i];
+      if (obj->locLists &&
+          (f->startPC >= obj->textStart) &&
+          (f->startPC < obj->textStart + obj->textSize)) {
+        *bias = obj->bias;
+        return obj->locLists;
+      }
+    }
+  }
+
+  *bias = 0;
+  return loc_list_map;
+}
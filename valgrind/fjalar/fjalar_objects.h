@@ -0,0 +1,52 @@
+/*
+   This file is part of Fjalar, a dynamic analysis framework for C/C++
+   programs.
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* fjalar_objects.h:
+
+Tracing functions in shared libraries (--trace-shared-libs).
+
+Every time the program maps a shared library that Valgrind reads
+debug. info. for, and whose file name matches --trace-shared-libs,
+we note down where its code lives, and nothing more.  Its own DWARF
+debug. info. is only read (through readelf.c, exactly like the
+executable's, or from --fjalar-cache-dir) once Valgrind translates
+the first instruction of a function in it that we are going to
+trace.  Its functions are then added to FunctionTable, so startup
+only costs as much as the libraries that are actually traced.
+
+*/
+
+#ifndef FJALAR_OBJECTS_H
+#define FJALAR_OBJECTS_H
+
+#include "fjalar_include.h"
+
+// Notes down any shared libraries that Valgrind has read debug. info.
+// for since the last call (called whenever a mapping brings some in).
+// The ones that are there atStartup are the executable and the
+// dynamic linker, which are never loaded.
+void registerSharedObjects(Bool atStartup);
+
+// Called before instrumenting the guest instruction at addr.  If it
+// is the first instruction of a function that we trace, in a shared
+// library that we haven't read the DWARF debug. info. for yet, reads
+// it and adds the library's functions to FunctionTable.
+void loadSharedObjectForAddr(Addr addr);
+
+// Returns the location lists (see loc_list_map) that f's frame base
+// has to be looked up in, and sets *bias to the amount that f's
+// addresses were moved by when its library was loaded
+struct genhashtable* getLocationListsForFunction(FunctionEntry* f,
+                                                 PtrdiffT* bias);
+
+#endif
@@ -174,6 +174,142 @@ static VariableEntry* searchForArrayWithinStruct(VariableEntry* structVar,
   return 0;
 }
 
+// An index over the extents of the global array and struct variables
+// in globalVars (the only ones that returnArrayVariableWithAddr() can
+// return), sorted by start address.  It is built the first time that
+// it's needed rather than in initializeAllFjalarData() because a
+// .disambig file may still coerce the types of globals, and thus
+// their sizes, after that.
+typedef struct {
+  Addr start;
+  Addr end;           // One past the last byte
+  Addr maxEnd;        // The largest end of this and all earlier extents
+  UInt listIndex;     // Position in globalVars
+  VariableEntry* var;
+} GlobalVarExtent;
+
+static GlobalVarExtent* globalVarExtents = 0;
+static UInt numGlobalVarExtents = 0;
+
+static Int compareGlobalVarExtents(const void* a, const void* b) {
+  const GlobalVarExtent* e1 = (const GlobalVarExtent*)a;
+  const GlobalVarExtent* e2 = (const GlobalVarExtent*)b;
+  if (e1->start < e2->start) return -1;
+  if (e1->start > e2->start) return 1;
+  if (e1->listIndex < e2->listIndex) return -1;
+  if (e1->listIndex > e2->listIndex) return 1;
+  return 0;
+}
+
+static void buildGlobalVarExtents(void) {
+  VarNode* cur_node;
+  UInt listIndex = 0;
+  UInt i;
+
+  globalVarExtents =
+    VG_(malloc)("fjalar_runtime.c: buildGlobalVarExtents",
+                (globalVars.numVars + 1) * sizeof(*globalVarExtents));
+  numGlobalVarExtents = 0;
+
+  for (cur_node = globalVars.first;
+       cur_node != 0;
+       cur_node = cur_node->next, listIndex++) {
+    VariableEntry* var = cur_node->var;
+    GlobalVarExtent* extent;
+    Addr size;
+
+    if (!var)
+      continue;
+
+    tl_assert(IS_GLOBAL_VAR(var));
+
+    if (IS_STATIC_ARRAY_VAR(var)) {
+      size = var->staticArr->upperBounds[0] * getBytesBetweenElts(var);
+    }
+    else if (VAR_IS_BASE_STRUCT(var)) {
+      size = getBytesBetweenElts(var);
+    }
+    else {
+      continue;
+    }
+
+    if (size == 0)
+      continue;
+
+    tl_assert(numGlobalVarExtents < globalVars.numVars + 1);
+    extent = &globalVarExtents[numGlobalVarExtents++];
+    extent->start = var->globalVar->globalLocation;
+    extent->end = extent->start + size;
+    extent->listIndex = listIndex;
+    extent->var = var;
+  }
+
+  VG_(ssort)(globalVarExtents, numGlobalVarExtents,
+             sizeof(*globalVarExtents), compareGlobalVarExtents);
+
+  for (i = 0; i < numGlobalVarExtents; i++) {
+    globalVarExtents[i].maxEnd =
+      ((i > 0) && (globalVarExtents[i - 1].maxEnd > globalVarExtents[i].end)) ?
+      globalVarExtents[i - 1].maxEnd : globalVarExtents[i].end;
+  }
+
+  FJALAR_DPRINTF("[buildGlobalVarExtents] %u array and struct extents\n",
+                 numGlobalVarExtents);
+}
+
+// returnArrayVariableWithAddr() for globalVars: binary searches
+// globalVarExtents instead of looking at every global.  If several
+// extents contain "a" (which hardly ever happens), the variable that
+// comes first in globalVars wins, just like in the linear search.
+static VariableEntry*
+returnGlobalArrayVariableWithAddr(Addr a, Addr* baseAddr) {
+  UInt lo = 0;
+  UInt hi;
+  GlobalVarExtent* found = 0;
+
+  if (!globalVarExtents) {
+    buildGlobalVarExtents();
+  }
+
+  // Find the number of extents which start at or before a
+  hi = numGlobalVarExtents;
+  while (lo < hi) {
+    UInt mid = lo + (hi - lo) / 2;
+    if (globalVarExtents[mid].start <= a) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  while ((lo > 0) && (globalVarExtents[lo - 1].maxEnd > a)) {
+    GlobalVarExtent* extent = &globalVarExtents[lo - 1];
+    if ((a < extent->end) &&
+        (!found || (extent->listIndex < found->listIndex))) {
+      found = extent;
+    }
+    lo--;
+  }
+
+  if (found) {
+    VariableEntry* potentialVar = found->var;
+    FJALAR_DPRINTF("[returnGlobalArrayVariableWithAddr] Addr: %p in %s at %p\n",
+                   (void *)a, potentialVar->name, (void *)found->start);
+    if (IS_STATIC_ARRAY_VAR(potentialVar)) {
+      *baseAddr = found->start;
+      return potentialVar;
+    }
+    else {
+      return searchForArrayWithinStruct(potentialVar, found->start,
+                                        a, baseAddr);
+    }
+  }
+
+  *baseAddr = 0;
+  return 0;
+}
+
 // Returns an array or struct variable within varList
 // that encompasses the address provided by "a".
 // Properties for return value r = &(returnNode.var):
@@ -195,6 +331,9 @@ returnArrayVariableWithAddr(VarList* varList,
   Addr var_loc = 0;
 
   FJALAR_DPRINTF("[returnArrayVariableWithAddr] varList: %p, Addr: %p, %s\n", varList, (void *)a, (isGlobal)?"Global":"NonGlobal");
+  if (isGlobal && (varList == &globalVars)) {
+    return returnGlobalArrayVariableWithAddr(a, baseAddr);
+  }
   if (!isGlobal) {
     FJALAR_DPRINTF("frame_ptr: %p, stack_ptr: %p\n", (void *)e->FP, (void *)e->lowSP);
   }
@@ -357,57 +496,57 @@ VariableEntry* returnGlobalSingletonWithAddress(Addr a) {
 // an array are uninitialized.  For example, this function will return
 // 10 for an int array allocated to hold 1000 elements but only with
 // the first 10 elements initialized.
+//
+// Neither pass goes element by element any more: if startAddr is the
+// start of a heap block, Memcheck's MC_(malloc_list) tells us where
+// it ends, otherwise mc_addressable_prefix_length() finds the end a
+// word of A-bits at a time, and mc_initialized_prefix_length() does
+// the backwards pass over the V-bits the same way.
 int probeAheadDiscoverHeapArraySize(Addr startAddr, UInt typeSize)
 {
-  int arraySize = 0;
+  MC_Chunk* chunk;
+  SizeT numBytes;
+  SizeT arraySize;
   /*tl_assert(typeSize > 0);*/
   if (typeSize == 0)
     return 0;
   FJALAR_DPRINTF ( "typeSize: 0x%x\n", typeSize);
-  while (mc_check_writable( startAddr, typeSize, 0))
-    {
-      if (arraySize % 1000 == 0)
-        FJALAR_DPRINTF ( "Made it to %d elements at 0x%x\n", arraySize,
-                         (unsigned int)startAddr);
-      /* Cut off the search if we can already see it's really big:
-         no need to look further than we're going to print. */
-      // RUDD TEMP
-/*       if (fjalar_array_length_limit != -1 && */
-/*           arraySize > fjalar_array_length_limit) */
-/*         break; */
-
-      arraySize++;
-      startAddr+=typeSize;
-    }
 
-  startAddr -= typeSize;
-  // Now do a SECOND pass and probe BACKWARDS until we reach the
-  // first set of bytes with at least one byte whose V-bit is SET
-  while ((arraySize > 0) &&
-         // If at least ONE byte within the element of size typeSize
-         // is initialized, then consider the entire element to be
-         // initialized.  This is done because sometimes only certain
-         // members of a struct are initialized, and if we perform the
-         // more stringent check for whether ALL members are
-         // initialized, then we will falsely mark
-         // partially-initialized structs as uninitialized and lose
-         // information.  For instance, consider struct point{int x;
-         // int y;} - Let's say you had struct point foo[10] and
-         // initialized only the 'x' member var. in every element of
-         // foo (foo[0].x, foo[1].x, etc...)  but left the 'y' member
-         // var uninitialized.  Every element of foo has typeSize = 2
-         // * sizeof(int) = 8, but only the first 4 bytes are
-         // initialized ('x') while the last 4 are uninitialized
-         // ('y').  This function should return 10 for the size of
-         // foo, so it must mark each element as initialized when at
-         // least ONE byte is initialized (in this case, a byte within
-         // 'x').
-         !mc_are_some_bytes_initialized(startAddr, typeSize)) {
-    arraySize--;
-    startAddr-=typeSize;
+  // The first pass: how many elements of size typeSize are entirely
+  // addressable (a heap block is followed by an inaccessible
+  // redzone, so this is how many fit in the block)
+  chunk = VG_(HT_lookup)(MC_(malloc_list), (UWord)startAddr);
+  if (chunk) {
+    numBytes = chunk->szB;
+    FJALAR_DPRINTF ( "Heap block at %p has 0x%lx bytes\n",
+                     (void *)startAddr, (unsigned long)numBytes);
+  }
+  else {
+    numBytes = mc_addressable_prefix_length(startAddr, ~(SizeT)0);
   }
+  arraySize = numBytes / typeSize;
 
-  return arraySize;
+  // Now do a SECOND pass and probe BACKWARDS until we reach the
+  // first set of bytes with at least one byte whose V-bit is SET.
+  // If at least ONE byte within the element of size typeSize is
+  // initialized, then consider the entire element to be initialized.
+  // This is done because sometimes only certain members of a struct
+  // are initialized, and if we perform the more stringent check for
+  // whether ALL members are initialized, then we will falsely mark
+  // partially-initialized structs as uninitialized and lose
+  // information.  For instance, consider struct point{int x; int y;}
+  // - Let's say you had struct point foo[10] and initialized only the
+  // 'x' member var. in every element of foo (foo[0].x, foo[1].x,
+  // etc...)  but left the 'y' member var uninitialized.  Every
+  // element of foo has typeSize = 2 * sizeof(int) = 8, but only the
+  // first 4 bytes are initialized ('x') while the last 4 are
+  // uninitialized ('y').  This function should return 10 for the
+  // size of foo, so it must mark each element as initialized when at
+  // least ONE byte is initialized (in this case, a byte within 'x').
+  numBytes = mc_initialized_prefix_length(startAddr, arraySize * typeSize);
+  arraySize = (numBytes + typeSize - 1) / typeSize;
+
+  return (int)arraySize;
 }
 
 // Return the number of bytes between elements of this variable
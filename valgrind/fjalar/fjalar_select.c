@@ -243,6 +243,68 @@ Bool prog_pts_tree_entry_found(FunctionEntry* cur_entry) {
   }
 }
 
+// The names of the functions in prog_pts_tree with their file,
+// class, and parameters stripped off, for
+// prog_pts_tree_may_contain_symbol():
+static struct genhashtable* prog_pts_bare_names = 0;
+
+// Returns a newly-allocated copy of the bare name of a function,
+// given either its Fjalar name ("Stack.cpp.Stack::pop()" -> "pop")
+// or a symbol table name ("Stack::pop()" -> "pop", "main" -> "main")
+static char* getBareFunctionName(const char* name) {
+  const char* end = VG_(strchr)(name, '(');
+  const char* start;
+  char* bare;
+
+  if (!end) {
+    end = name + VG_(strlen)(name);
+  }
+
+  start = end;
+  while ((start > name) && (start[-1] != '.') && (start[-1] != ':')) {
+    start--;
+  }
+
+  bare = VG_(malloc)("fjalar_select.c: getBareFunctionName", end - start + 1);
+  VG_(memcpy)(bare, start, end - start);
+  bare[end - start] = '\0';
+  return bare;
+}
+
+// Returns 1 if the function named fnname in the symbol table might
+// be one of the program points in prog_pts_tree.  This is for
+// deciding whether a function is worth reading the debug. info. for,
+// before we know its Fjalar name, so it errs on the side of 1.
+Bool prog_pts_tree_may_contain_symbol(const char* fnname) {
+  char* bare;
+  Bool found;
+
+  if (!prog_pts_bare_names) {
+    prog_pts_bare_names =
+      genallocatehashtable((unsigned int (*)(void *)) &hashString,
+                           (int (*)(void *,void *)) &equivalentStrings);
+
+    if (prog_pts_tree) {
+      struct tree_iter_t* it = titer((void*)prog_pts_tree);
+      while (titer_hasnext(it)) {
+        char* name = getBareFunctionName((char*)titer_next(it));
+        if (gencontains(prog_pts_bare_names, name)) {
+          VG_(free)(name);
+        }
+        else {
+          genputtable(prog_pts_bare_names, name, (void*)1);
+        }
+      }
+      titer_destroy(it);
+    }
+  }
+
+  bare = getBareFunctionName(fnname);
+  found = gencontains(prog_pts_bare_names, bare);
+  VG_(free)(bare);
+  return found;
+}
+
 // Compares the function's fjalar names names
 int compareFunctionTrees(const void *a, const void *b)
 {
@@ -99,6 +99,12 @@ void fjalar_tool_finish(void);
 void fjalar_tool_handle_function_entrance(FunctionExecutionState* f_state);
 void fjalar_tool_handle_function_exit(FunctionExecutionState* f_state);
 
+// Runs when Fjalar adds functions to FunctionTable after
+// initialization, which only happens when it reads the debug. info.
+// of a shared library (--trace-shared-libs).  None of the num
+// functions in funcs has been entered yet.
+void fjalar_tool_handle_new_functions(FunctionEntry** funcs, UInt num);
+
 
 /*********************************************************************
 Constructors and destructors for classes that can be subclassed:
@@ -240,6 +240,137 @@ const HChar* stringStackStrdup(StringStack *stack)
 }
 
 
+// Building full variable names out of fullNameStack (and looking them
+// up in trace_vars_tree) is the most expensive part of a traversal,
+// and the names come out the same every time a program point is
+// traversed.  So the first traversal of each group of variables at a
+// program point records every full name it builds, in order, in a
+// plan, and later traversals take them from there.  fullNameStack
+// only ever holds pointers to strings which never change (variable
+// and class names, the symbols above, and FLATTENED_INDEX_STRINGS),
+// so a planned name can be checked with a cheap comparison of
+// pointers.  If the traversal ever goes differently from last time,
+// the rest of the plan is thrown out and rebuilt.
+typedef struct {
+  int numComponents;
+  const HChar** components;  // copy of fullNameStack
+  const HChar* fullName;
+  // The result of interestedInVar() for fullName and traceVarsTree
+  // (-1 if it hasn't been needed yet)
+  char* traceVarsTree;
+  char interested;
+} TraversalPlanEntry;
+
+typedef struct _TraversalPlan {
+  UInt size;
+  UInt capacity;
+  TraversalPlanEntry* entries;
+} TraversalPlan;
+
+// The plan being followed by the current traversal (0 if none), and
+// the entry for the next full name
+static TraversalPlan* curPlan = NULL;
+static UInt curPlanIndex = 0;
+
+// Index strings for flattened arrays (see visitClassMemberVariables())
+static const HChar* FLATTENED_INDEX_STRINGS[MAXIMUM_ARRAY_SIZE_TO_EXPAND] =
+  {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9"};
+
+static void beginTraversalPlan(FunctionEntry* funcPtr,
+                               Bool isEnter,
+                               VariableOrigin varOrigin) {
+  TraversalPlan** pPlan;
+  int group = ((varOrigin == GLOBAL_VAR) ? 0 :
+               (varOrigin == FUNCTION_FORMAL_PARAM) ? 1 : 2);
+
+  curPlanIndex = 0;
+  if (!funcPtr) {
+    curPlan = NULL;
+    return;
+  }
+
+  pPlan = &funcPtr->traversalPlans[isEnter ? 1 : 0][group];
+  if (!*pPlan) {
+    *pPlan = VG_(calloc)("fjalar_traversal.c: beginTraversalPlan", 1, sizeof(TraversalPlan));
+  }
+  curPlan = *pPlan;
+}
+
+static void endTraversalPlan(void) {
+  curPlan = NULL;
+}
+
+// Throws out all entries of the current plan from curPlanIndex on
+static void truncateTraversalPlan(void) {
+  UInt i;
+  for (i = curPlanIndex; i < curPlan->size; i++) {
+    VG_(free)(curPlan->entries[i].components);
+    VG_(free)((void*)curPlan->entries[i].fullName);
+  }
+  curPlan->size = curPlanIndex;
+}
+
+// Returns the full name of the variable on fullNameStack.  If
+// *pPlanned is set, the name belongs to the current plan; otherwise
+// it was allocated with stringStackStrdup() and the caller must free
+// it.
+static const HChar* getFullFjalarName(Bool* pPlanned) {
+  TraversalPlanEntry* entry;
+
+  if (!curPlan) {
+    *pPlanned = False;
+    return stringStackStrdup(&fullNameStack);
+  }
+
+  if (curPlanIndex < curPlan->size) {
+    entry = &curPlan->entries[curPlanIndex];
+    if ((entry->numComponents == fullNameStack.size) &&
+        (VG_(memcmp)(entry->components, fullNameStack.stack,
+                     fullNameStack.size * sizeof(HChar*)) == 0)) {
+      curPlanIndex++;
+      *pPlanned = True;
+      return entry->fullName;
+    }
+    truncateTraversalPlan();
+  }
+
+  if (curPlan->size == curPlan->capacity) {
+    curPlan->capacity = (curPlan->capacity ? curPlan->capacity * 2 : 16);
+    curPlan->entries = VG_(realloc)("fjalar_traversal.c: getFullFjalarName.1",
+                                    curPlan->entries,
+                                    curPlan->capacity * sizeof(TraversalPlanEntry));
+  }
+
+  entry = &curPlan->entries[curPlan->size++];
+  entry->numComponents = fullNameStack.size;
+  entry->components = VG_(malloc)("fjalar_traversal.c: getFullFjalarName.2",
+                                  fullNameStack.size * sizeof(HChar*));
+  VG_(memcpy)(entry->components, fullNameStack.stack,
+              fullNameStack.size * sizeof(HChar*));
+  entry->fullName = stringStackStrdup(&fullNameStack);
+  entry->traceVarsTree = NULL;
+  entry->interested = -1;
+
+  curPlanIndex++;
+  *pPlanned = True;
+  return entry->fullName;
+}
+
+
+// Empties VisitedStructsTable for a new round of variable visits,
+// allocating it the first time (clearing the old one is much cheaper
+// than freeing it and allocating a new one every time)
+static void resetVisitedStructsTable(void) {
+  if (VisitedStructsTable) {
+    genclearhashtable(VisitedStructsTable);
+  }
+  else {
+    // Use a small hashtable to save time and space:
+    VisitedStructsTable =
+      genallocateSMALLhashtable(0, (int (*)(void *,void *)) &equivalentIDs);
+  }
+}
+
 // Visits all member variables of the class and superclass without
 // regard to actually grabbing pointer values.  This is useful for
 // printing out names and performing other non-value-dependent
@@ -250,14 +381,7 @@ void visitClassMembersNoValues(TypeEntry* class,
   VisitArgs new_args;
   const HChar *fullFjalarName = NULL, *top = NULL;
 
-  if (VisitedStructsTable) {
-    genfreehashtable(VisitedStructsTable);
-    VisitedStructsTable = NULL;
-  }
-
-  // Use a small hashtable to save time and space:
-  VisitedStructsTable =
-    genallocateSMALLhashtable(0, (int (*)(void *,void *)) &equivalentIDs);
+  resetVisitedStructsTable();
 
   // RUDD 2.0 Making use of EnclosingVarStack to keep track of
   // struct/class members.
@@ -336,6 +460,7 @@ void visitClassMemberVariables(VisitArgs* args) {
   VisitArgs new_args;
 
   const HChar* fullFjalarName = NULL;
+  Bool fullNameIsPlanned = False;
 
   tl_assert(((class->decType == D_STRUCT_CLASS) || (class->decType == D_UNION)) &&
             IS_AGGREGATE_TYPE(class));
@@ -409,11 +534,9 @@ void visitClassMemberVariables(VisitArgs* args) {
         // Only look at the first dimension:
         UInt arrayIndex;
         for (arrayIndex = 0; arrayIndex <= curVar->staticArr->upperBounds[0]; arrayIndex++) {
-          char indexStr[5];
+          const HChar* indexStr = FLATTENED_INDEX_STRINGS[arrayIndex];
           top = stringStackTop(&fullNameStack);
 
-          sprintf(indexStr, "%d", arrayIndex);
-
           // (comment added 2005)  
           // TODO: Subtract and add is a HACK!  Subtract one from the
           // type of curVar just because we are looping through and
@@ -785,7 +908,7 @@ void visitClassMemberVariables(VisitArgs* args) {
 
       // RUDD - 2.0  Trying to make use of EnclosingVar stack for Nested Classes and Structs.
       // Push fullFjalarName onto enclosingVarNamesStack:
-      fullFjalarName = stringStackStrdup(&fullNameStack);
+      fullFjalarName = getFullFjalarName(&fullNameIsPlanned);
       if (fullFjalarName) {
         stringStackPush(&enclosingVarNamesStack, fullFjalarName);
       }
@@ -841,7 +964,7 @@ void visitClassMemberVariables(VisitArgs* args) {
     }
   }
 
-  if (fullFjalarName) {
+  if (fullFjalarName && !fullNameIsPlanned) {
     VG_(free)((void*)fullFjalarName);
   }
 
@@ -905,6 +1028,7 @@ void visitVariableGroup(VariableOrigin varOrigin,
   }
 
   stringStackClear(&fullNameStack);
+  beginTraversalPlan(funcPtr, isEnter, varOrigin);
 
   tl_assert(varListPtr);
   //RUDD EXCEPTION
@@ -1143,6 +1267,7 @@ void visitVariableGroup(VariableOrigin varOrigin,
   }
 
   deleteVarIterator(varIt);
+  endTraversalPlan();
 
   FJALAR_DPRINTF("Exit  visitVariableGroup\n");
 }
@@ -1175,6 +1300,7 @@ void visitReturnValue(FunctionExecutionState* e,
 
   // We need to push the return value name onto the string stack!
   stringStackClear(&fullNameStack);
+  beginTraversalPlan(funcPtr, False, FUNCTION_RETURN_VAR);
 
   tl_assert(cur_node->var);
   tl_assert(cur_node->var->name);
@@ -1341,6 +1467,7 @@ void visitReturnValue(FunctionExecutionState* e,
   }
 
   stringStackPop(&fullNameStack);
+  endTraversalPlan();
 
   FJALAR_DPRINTF("Exit  visitReturnValue - var: %s\n", cur_node->var->name);
 }
@@ -1376,6 +1503,25 @@ static char interestedInVar(const HChar* fullFjalarName, char* trace_vars_tree)
   return 1;
 }
 
+// interestedInVar() for the full name just returned by
+// getFullFjalarName(), using the answer from the plan if there is one
+static char interestedInNewestVar(const HChar* fullFjalarName,
+                                  Bool planned,
+                                  char* trace_vars_tree) {
+  TraversalPlanEntry* entry;
+
+  if (!planned) {
+    return interestedInVar(fullFjalarName, trace_vars_tree);
+  }
+
+  entry = &curPlan->entries[curPlanIndex - 1];
+  if ((entry->interested < 0) || (entry->traceVarsTree != trace_vars_tree)) {
+    entry->interested = interestedInVar(fullFjalarName, trace_vars_tree);
+    entry->traceVarsTree = trace_vars_tree;
+  }
+  return entry->interested;
+}
+
 
 // This visits a variable by delegating to visitSingleVar()
 // Pre: varOrigin != DERIVED_VAR, varOrigin != DERIVED_FLATTENED_ARRAY_VAR
@@ -1427,15 +1573,7 @@ void visitVariable(VariableEntry* var,
   // (otherwise, it's not necessary because there are no derived
   // variables):
   if (IS_AGGREGATE_TYPE(var->varType)) {
-
-    if (VisitedStructsTable) {
-      genfreehashtable(VisitedStructsTable);
-      VisitedStructsTable = NULL;
-    }
-
-    // Use a small hashtable to save time and space:
-    VisitedStructsTable =
-      genallocateSMALLhashtable(0, (int (*)(void *,void *)) &equivalentIDs);
+    resetVisitedStructsTable();
   }
 
   // Also initialize trace_vars_tree based on varOrigin and
@@ -1501,6 +1639,7 @@ void visitSingleVar(VisitArgs* args) {
   VisitArgs new_args;
 
   const HChar* fullFjalarName = NULL;
+  Bool fullNameIsPlanned = False;
   int layersBeforeBase;
 
   // Initialize these in a group later
@@ -1576,7 +1715,7 @@ void visitSingleVar(VisitArgs* args) {
 
     // (Notice that this uses strdup to allocate on the heap)
     tl_assert(fullNameStack.size > 0);
-    fullFjalarName = stringStackStrdup(&fullNameStack);
+    fullFjalarName = getFullFjalarName(&fullNameIsPlanned);
 
     // For disambig: While observing the runtime values, set
     // pointerHasEverBeenObserved to 1 if the contents of a pointer
@@ -1604,7 +1743,7 @@ void visitSingleVar(VisitArgs* args) {
     // interesting. Now we will not return, but simply not
     // pass uninteresting variables to the tool.
     
-    if (interestedInVar(fullFjalarName, trace_vars_tree)) {
+    if (interestedInNewestVar(fullFjalarName, fullNameIsPlanned, trace_vars_tree)) {
 
       // Perform the action action for this particular variable:
       tResult = (*performAction)(var,
@@ -1627,7 +1766,9 @@ void visitSingleVar(VisitArgs* args) {
 
       // Punt!
       if (tResult == STOP_TRAVERSAL) {
-        VG_(free)((void*)fullFjalarName);
+        if (!fullNameIsPlanned) {
+          VG_(free)((void*)fullFjalarName);
+        }
         return;
       }
     }
@@ -1873,7 +2014,7 @@ void visitSingleVar(VisitArgs* args) {
         (top && VG_STREQ(top, ZEROTH_ELT)) ||
         (top && VG_STREQ(top, ARROW))) {
       stringStackPop(&fullNameStack);
-      fullFjalarName = stringStackStrdup(&fullNameStack);
+      fullFjalarName = getFullFjalarName(&fullNameIsPlanned);
 
       if (fullFjalarName) {
         stringStackPush(&enclosingVarNamesStack, fullFjalarName);
@@ -1881,7 +2022,7 @@ void visitSingleVar(VisitArgs* args) {
       stringStackPush(&fullNameStack, top);
     }
     else {
-      fullFjalarName = stringStackStrdup(&fullNameStack);
+      fullFjalarName = getFullFjalarName(&fullNameIsPlanned);
       if (fullFjalarName) {
         stringStackPush(&enclosingVarNamesStack, fullFjalarName);
       }
@@ -1910,7 +2051,7 @@ void visitSingleVar(VisitArgs* args) {
 
 
   }
-  if (fullFjalarName)
+  if (fullFjalarName && !fullNameIsPlanned)
     VG_(free)((void*)fullFjalarName);
   
   FJALAR_DPRINTF("Exit  visitSingleVar - var: %s\n", var->name);
@@ -1942,6 +2083,7 @@ void visitSequence(VisitArgs* args) {
   VisitArgs new_args;
 
   const HChar* fullFjalarName = NULL;
+  Bool fullNameIsPlanned = False;
   int layersBeforeBase;
 
   TraversalResult tResult = INVALID_RESULT;
@@ -1984,7 +2126,7 @@ void visitSequence(VisitArgs* args) {
 
     // (Notice that this uses strdup to allocate on the heap)
     tl_assert(fullNameStack.size > 0);
-    fullFjalarName = stringStackStrdup(&fullNameStack);
+    fullFjalarName = getFullFjalarName(&fullNameIsPlanned);
 
     // For disambig: While observing the runtime values, set
     // var->disambigMultipleElts and var->pointerHasEverBeenObserved
@@ -2037,7 +2179,7 @@ void visitSequence(VisitArgs* args) {
                    fullFjalarName);
 
     // See: PARTIAL_STRUCT_TRAVERSAL
-    if (interestedInVar(fullFjalarName, trace_vars_tree)) {
+    if (interestedInNewestVar(fullFjalarName, fullNameIsPlanned, trace_vars_tree)) {
 
       // Perform the action action for this particular variable:
       tResult = (*performAction)(var,
@@ -2060,7 +2202,9 @@ void visitSequence(VisitArgs* args) {
 
       // Punt!
       if (tResult == STOP_TRAVERSAL) {
-        VG_(free)((void*)fullFjalarName);
+        if (!fullNameIsPlanned) {
+          VG_(free)((void*)fullFjalarName);
+        }
         return;
       }
     }
@@ -2201,7 +2345,7 @@ void visitSequence(VisitArgs* args) {
     }
 
   }
-  if (fullFjalarName)
+  if (fullFjalarName && !fullNameIsPlanned)
     VG_(free)((void*)fullFjalarName);
 
   FJALAR_DPRINTF("Exit  visitSequence - var: %s\n", var->name);
@@ -39,15 +39,18 @@ extern char * cplus_demangle_v3 (const char *, int);
 static void initializeFunctionTable(void);
 static void initializeGlobalVarsList(void);
 static void initFunctionFjalarNames(void);
+static void buildFunctionAddrIndex(void);
 static void updateAllGlobalVariableNames(void);
 static void initMemberFuncs(void);
 static void initConstructorsAndDestructors(void);
 static void createNamesForUnnamedDwarfEntries(void);
 static void updateAllVarTypes(void);
 static void processFunctions(void);
+static int entry_is_valid_function(dwarf_entry *entry);
 
 int determineFormalParametersStackByteSize(FunctionEntry* f);
 int determineFormalParametersLowerStackByteSize(FunctionEntry* f);
+Bool determineFormalParametersStackBytesKnown(FunctionEntry* f);
 
 static void extractFormalParameterVars(FunctionEntry* f, function* dwarfFunctionEntry);
 static void extractLocalArrayAndStructVariables(FunctionEntry* f, function* dwarfFunctionEntry);
@@ -208,6 +211,14 @@ const char* DeclaredTypeString[] = {
 struct genhashtable* TypesTable = 0;
 struct genhashtable* FunctionTable = 0;
 struct genhashtable* FunctionTable_by_entryPC = 0;
+
+// All entries of FunctionTable sorted by startPC, for
+// getFunctionEntryFromAddr().  FunctionsMaxEndPC[i] is the largest
+// endPC of FunctionsByStartPC[0..i], which bounds how far back an
+// address lookup has to look when function ranges overlap.
+static FunctionEntry** FunctionsByStartPC = 0;
+static Addr* FunctionsMaxEndPC = 0;
+static UInt numFunctionsByStartPC = 0;
 struct genhashtable* VisitedStructsTable = 0;
 
 // Data structure to check for duplicate function names in the
@@ -563,6 +574,9 @@ void initializeAllFjalarData(void)
   // FunctionTable:
   initFunctionFjalarNames();
 
+  // The address ranges of functions don't change from here on:
+  buildFunctionAddrIndex();
+
   FJALAR_DPRINTF(".data:   0x%x bytes starting at %p\n.bss:    0x%x bytes starting at %p\n.rodata: 0x%x bytes starting at %p\n.data.rel.ro: 0x%x bytes starting at %p\n",
                  data_section_size, VoidPtr(data_section_addr),
                  bss_section_size, VoidPtr(bss_section_addr),
@@ -578,6 +592,123 @@ void initializeAllFjalarData(void)
   FJALAR_DPRINTF("EXIT  initializeAllFjalarData\n");
 }
 
+// Like initializeAllFjalarData(), but for the DWARF data of a shared
+// object that has been loaded bias bytes away from the addresses in
+// its debug. info. (see fjalar_objects.c).  Its functions are
+// relocated and added to FunctionTable and its types to TypesTable,
+// except for those whose names are already taken.  Its global
+// variables are NOT added to globalVars, since that would change the
+// variables of every program point that has already been declared.
+// Returns the newly added functions (VG_(free) the array when done),
+// or 0 if there weren't any, and sets *numAdded to how many there are.
+FunctionEntry** addSharedObjectFunctions(PtrdiffT bias, UInt* numAdded)
+{
+  struct genhashtable* mainFunctionTable = FunctionTable;
+  struct genhashtable* mainFunctionTable_by_entryPC = FunctionTable_by_entryPC;
+  struct genhashtable* mainFunctionTable_by_endOfBb = FunctionTable_by_endOfBb;
+  struct genhashtable* mainFuncNameTable = FuncNameTable;
+  struct genhashtable* mainTypesTable = TypesTable;
+  struct genhashtable* objectFunctionTable;
+  struct geniterator* it;
+  FuncIterator* funcIt;
+  FunctionEntry** added;
+  unsigned long i;
+  UInt n = 0;
+
+  *numAdded = 0;
+
+  // initializeFunctionTable() gives up on the whole run if it can't
+  // find any functions, which is fine for the executable but not for
+  // a library that happens to have no debug. info.
+  for (i = 0; i < dwarf_entry_array_size; i++) {
+    if (entry_is_valid_function(&dwarf_entry_array[i])) {
+      break;
+    }
+  }
+  if (i == dwarf_entry_array_size) {
+    return 0;
+  }
+
+  FJALAR_DPRINTF("ENTER addSharedObjectFunctions (bias %p)\n", VoidPtr(bias));
+
+  // Run the same passes as initializeAllFjalarData() over fresh
+  // tables, so that names and addresses can't collide with the
+  // executable's until we're ready to merge them
+  VisitedStructsTable = 0;
+  TypesTable =
+    genallocatehashtable((unsigned int (*)(void *)) &hashString,
+                         (int (*)(void *,void *)) &equivalentStrings);
+
+  createNamesForUnnamedDwarfEntries();
+  initializeFunctionTable();
+  updateAllVarTypes();
+  initMemberFuncs();
+  initConstructorsAndDestructors();
+  processFunctions();
+  initFunctionFjalarNames();
+
+  added = VG_(malloc)("generate_fjalar_entries.c: addSharedObjectFunctions",
+                      hashsize(FunctionTable) * sizeof(*added));
+
+  funcIt = newFuncIterator();
+  while (hasNextFunc(funcIt)) {
+    FunctionEntry* f = nextFunc(funcIt);
+
+    if (gencontains(mainFuncNameTable, f->fjalar_name) ||
+        gencontains(mainFunctionTable, (void*)(f->startPC + bias))) {
+      FJALAR_DPRINTF("Skipping %s, which the executable already has\n", f->fjalar_name);
+      continue;
+    }
+
+    f->startPC += bias;
+    f->endPC += bias;
+    f->entryPC += bias;
+    f->cuBase += bias;
+    added[n++] = f;
+  }
+  deleteFuncIterator(funcIt);
+
+  it = gengetiterator(TypesTable);
+  while (!it->finished) {
+    char* typeName = (char*)gennext(it);
+    if (!gencontains(mainTypesTable, typeName)) {
+      genputtable(mainTypesTable, typeName, gengettable(TypesTable, typeName));
+    }
+  }
+  genfreeiterator(it);
+
+  objectFunctionTable = FunctionTable;
+  genfreehashtable(TypesTable);
+  genfreehashtable(FunctionTable_by_entryPC);
+  genfreehashtable(FunctionTable_by_endOfBb);
+  genfreehashtable(FuncNameTable);
+
+  FunctionTable = mainFunctionTable;
+  FunctionTable_by_entryPC = mainFunctionTable_by_entryPC;
+  FunctionTable_by_endOfBb = mainFunctionTable_by_endOfBb;
+  FuncNameTable = mainFuncNameTable;
+  TypesTable = mainTypesTable;
+
+  for (i = 0; i < n; i++) {
+    FunctionEntry* f = added[i];
+    genputtable(FunctionTable, (void*)f->startPC, (void*)f);
+    genputtable(FunctionTable_by_entryPC, (void*)f->entryPC, (void*)f);
+    genputtable(FuncNameTable, (void*)f->fjalar_name, (void*)f);
+  }
+  genfreehashtable(objectFunctionTable);
+
+  buildFunctionAddrIndex();
+
+  FJALAR_DPRINTF("EXIT  addSharedObjectFunctions: %u functions\n", n);
+
+  if (!n) {
+    VG_(free)(added);
+    return 0;
+  }
+  *numAdded = n;
+  return added;
+}
+
 // Returns true iff the address is within a global area as specified
 // by the executable's symbol table (it lies within the .data, .bss,
 // or .rodata sections):
@@ -1741,6 +1872,9 @@ void initializeFunctionTable(void)
           cur_func_entry->formalParamLowerStackByteSize
             = determineFormalParametersLowerStackByteSize(cur_func_entry);
 
+          cur_func_entry->formalParamStackBytesKnown
+            = determineFormalParametersStackBytesKnown(cur_func_entry);
+
           num_functions_added++;
         }
     }
@@ -2413,6 +2547,40 @@ int determineFormalParametersLowerStackByteSize(FunctionEntry* f)
 }
 
 
+// Determines whether every formal parameter with a location is at a
+// plain offset from the frame base (DW_OP_fbreg, or a bare offset
+// with older compilers), so that the two functions above really do
+// bound the parameters.  Parameters that are found through registers
+// or longer DWARF expressions make this False.
+Bool determineFormalParametersStackBytesKnown(FunctionEntry* f)
+{
+  VarNode* cur_node;
+
+  if(!f){
+    return False;
+  }
+
+  for (cur_node = f->formalParameters.first;
+       cur_node != NULL;
+       cur_node = cur_node->next)
+    {
+      VariableEntry* var = cur_node->var;
+      if (!var->validLoc) {
+        continue;
+      }
+      if (var->locationType != FP_OFFSET_LOCATION) {
+        return False;
+      }
+      if (var->location_expression_size > 1 ||
+          ((var->location_expression_size == 1) &&
+           (var->location_expression[0].atom != DW_OP_fbreg))) {
+        return False;
+      }
+    }
+  return True;
+}
+
+
 // dwarfParamEntry->tag_name == DW_TAG_formal_parameter
 static void extractOneFormalParameterVar(FunctionEntry* f,
                                          dwarf_entry* dwarfParamEntry)
@@ -3214,22 +3382,84 @@ FunctionEntry* getFunctionEntryFromFjalarName(char* fjalar_name) {
   return 0;
 }
 
-// This is SLOW because we must traverse all values
-// looking for an entry whose startPC and endPC encompass the
-// desired address addr, inclusive.  Thus addr is in the range of
-// [startPC, endPC]
-FunctionEntry* getFunctionEntryFromAddr(Addr addr) {
+static Int compareFunctionsByStartPC(const void* a, const void* b) {
+  const FunctionEntry* f1 = *(const FunctionEntry* const*)a;
+  const FunctionEntry* f2 = *(const FunctionEntry* const*)b;
+  if (f1->startPC < f2->startPC) return -1;
+  if (f1->startPC > f2->startPC) return 1;
+  return 0;
+}
+
+// Builds FunctionsByStartPC and FunctionsMaxEndPC from FunctionTable.
+// Run this after all entries in FunctionTable have their final
+// startPC and endPC.
+static void buildFunctionAddrIndex(void) {
   FuncIterator* funcIt = newFuncIterator();
+  UInt i = 0;
+
+  // Rebuilt whenever a shared object adds functions:
+  if (FunctionsByStartPC) {
+    VG_(free)(FunctionsByStartPC);
+    VG_(free)(FunctionsMaxEndPC);
+  }
+
+  numFunctionsByStartPC = hashsize(FunctionTable);
+  FunctionsByStartPC =
+    VG_(malloc)("generate_fjalar_entries.c: buildFunctionAddrIndex.1",
+                (numFunctionsByStartPC + 1) * sizeof(*FunctionsByStartPC));
+  FunctionsMaxEndPC =
+    VG_(malloc)("generate_fjalar_entries.c: buildFunctionAddrIndex.2",
+                (numFunctionsByStartPC + 1) * sizeof(*FunctionsMaxEndPC));
+
   while (hasNextFunc(funcIt)) {
     FunctionEntry* entry = nextFunc(funcIt);
     tl_assert(entry && entry->startPC && entry->endPC);
-    if ((entry->startPC <= addr) &&
-        (addr <= entry->endPC)) {
-      deleteFuncIterator(funcIt);
+    tl_assert(i < numFunctionsByStartPC);
+    FunctionsByStartPC[i++] = entry;
+  }
+  deleteFuncIterator(funcIt);
+  tl_assert(i == numFunctionsByStartPC);
+
+  VG_(ssort)(FunctionsByStartPC, numFunctionsByStartPC,
+             sizeof(*FunctionsByStartPC), compareFunctionsByStartPC);
+
+  for (i = 0; i < numFunctionsByStartPC; i++) {
+    Addr endPC = FunctionsByStartPC[i]->endPC;
+    FunctionsMaxEndPC[i] = ((i > 0) && (FunctionsMaxEndPC[i - 1] > endPC)) ?
+      FunctionsMaxEndPC[i - 1] : endPC;
+  }
+}
+
+// Returns the entry whose startPC and endPC encompass the desired
+// address addr, inclusive.  Thus addr is in the range of
+// [startPC, endPC].  We binary search FunctionsByStartPC for the last
+// entry that starts at or before addr and then walk backwards, which
+// only goes past one entry if some ranges overlap (FunctionsMaxEndPC
+// tells us when no earlier entry can reach addr any more).  If
+// several ranges contain addr, the one that starts last wins.
+FunctionEntry* getFunctionEntryFromAddr(Addr addr) {
+  UInt lo = 0;
+  UInt hi = numFunctionsByStartPC;
+  tl_assert(FunctionsByStartPC);
+
+  // Find the number of entries with startPC <= addr
+  while (lo < hi) {
+    UInt mid = lo + (hi - lo) / 2;
+    if (FunctionsByStartPC[mid]->startPC <= addr) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  while ((lo > 0) && (FunctionsMaxEndPC[lo - 1] >= addr)) {
+    FunctionEntry* entry = FunctionsByStartPC[lo - 1];
+    if (addr <= entry->endPC) {
       return entry;
     }
+    lo--;
   }
-  deleteFuncIterator(funcIt);
   return 0;
 }
 
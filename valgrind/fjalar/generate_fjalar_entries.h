@@ -74,6 +74,7 @@ struct genhashtable* FunctionTable_by_endOfBb;
 struct genhashtable* TypesTable;
 
 void initializeAllFjalarData(void);
+struct _FunctionEntry** addSharedObjectFunctions(PtrdiffT bias, UInt* numAdded);
 
 // Call this function whenever you want to check that the data
 // structures in this file all satisfy their respective
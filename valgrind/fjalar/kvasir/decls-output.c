@@ -28,6 +28,8 @@
 #include "kvasir_main.h"
 #include "dyncomp_runtime.h"
 #include "dyncomp_main.h"
+#include "dyncomp_state.h"
+#include "dtrace-writer.h"
 
 #include "pub_tool_libcbase.h" // For VG_STREQ
 #include "pub_tool_libcprint.h"
@@ -128,9 +130,13 @@ static void printDeclaredType(const char* name, FILE* fp) {
   }
 }
 
-// Use this function to print out a function name for .decls/.dtrace.
-void printDaikonFunctionName(FunctionEntry* f, FILE* fp) {
+// Returns the name of function f as it should appear in .decls/.dtrace.
+// Caller is responsible for destroying the string
+HChar* makeDaikonFunctionName(FunctionEntry* f) {
     char* name = f->fjalar_name;
+    HChar* result = VG_(malloc)("decls-output.c: makeDaikonFunctionName",
+                                2 * VG_(strlen)(name) + 1);
+    HChar* out = result;
 
     // Spaces in program point names must be backslashed,
     // so change ' ' to '\_'.
@@ -140,20 +146,28 @@ void printDaikonFunctionName(FunctionEntry* f, FILE* fp) {
 
     while (*name != '\0') {
       if (*name == ' ') {
-        fputs("\\_", fp);
+        *out++ = '\\';
+        *out++ = '_';
       }
       else if (*name == '\\') {
-        fputs("\\\\", fp);
+        *out++ = '\\';
+        *out++ = '\\';
       }
       else {
-        fputc(*name, fp);
+        *out++ = *name;
       }
       name++;
     }
+    *out = '\0';
+    return result;
 }
 
-
-
+// Use this function to print out a function name for .decls/.dtrace.
+void printDaikonFunctionName(FunctionEntry* f, FILE* fp) {
+  HChar* name = makeDaikonFunctionName(f);
+  fputs(name, fp);
+  VG_(free)(name);
+}
 
 
 // Converts a variable name given by Fjalar into a Daikon external
@@ -173,13 +187,15 @@ void printDaikonFunctionName(FunctionEntry* f, FILE* fp) {
 //       a static variable declared within the returnIntSum() function of
 //       the file 'custom-dir/ArrayTest.c'.)
 // For new .decls format (designed in April 2006)
-void printDaikonExternalVarName(VariableEntry* var, const HChar* fjalarName, FILE* fp) {
+HChar* makeDaikonExternalVarName(const HChar* fjalarName) {
   int indexOfLastSlash = -1;
   int len = VG_(strlen)(fjalarName);
   int i;
   const HChar* working_name;
   Bool alreadyPrintedBrackets = False; // Only print out one set of "[..]" max.
-  (void) var;
+  HChar* result = VG_(malloc)("decls-output.c: makeDaikonExternalVarName",
+                              2 * len + 3);
+  HChar* out = result;
 
   for (i = 0; i < len; i++) {
     if (fjalarName[i] == '/') {
@@ -198,7 +214,8 @@ void printDaikonExternalVarName(VariableEntry* var, const HChar* fjalarName, FIL
 
   // Special case for printing out leading '/' as '::':
   if (*working_name == '/') {
-      fputs("::", fp);
+      *out++ = ':';
+      *out++ = ':';
       working_name++;
   }
 
@@ -206,17 +223,30 @@ void printDaikonExternalVarName(VariableEntry* var, const HChar* fjalarName, FIL
     if ((*working_name == '[') &&
         (*(working_name + 1) == ']') &&
         !alreadyPrintedBrackets) {
-      fputs("[..", fp);
+      *out++ = '[';
+      *out++ = '.';
+      *out++ = '.';
       alreadyPrintedBrackets = True;
     }else if(*working_name == ' ') {
-      fputs("\\_", fp);
+      *out++ = '\\';
+      *out++ = '_';
     }else if(*working_name == '\\') {
-      fputs("\\\\", fp);
+      *out++ = '\\';
+      *out++ = '\\';
     }else {
-      fputc(*working_name, fp);
+      *out++ = *working_name;
     }
     working_name++;
   }
+  *out = '\0';
+  return result;
+}
+
+void printDaikonExternalVarName(VariableEntry* var, const HChar* fjalarName, FILE* fp) {
+  HChar* name = makeDaikonExternalVarName(fjalarName);
+  (void) var;
+  fputs(name, fp);
+  VG_(free)(name);
 }
 
 
@@ -1203,6 +1233,8 @@ printDeclsEntryAction(VariableEntry* var,
         if (dyncomp_detailed_mode) {
           DC_convert_bitmatrix_to_sets((DaikonFunctionEntry *)funcPtr, isEnter);
         }
+
+        DC_begin_ppt_state((DaikonFunctionEntry *)funcPtr, isEnter);
       }
     }
 
@@ -1260,6 +1292,7 @@ printDeclsEntryAction(VariableEntry* var,
         allocate_ppt_structures((DaikonFunctionEntry*)funcPtr, isEnter, g_variableIndex);
       }
       else {
+        DC_end_ppt_state();
         genfreehashtable(g_compNumberMap);
       }
     }
@@ -1807,3 +1840,57 @@ static void harvestAllFunctionObjects(void) {
     genputtable(funcObjectTable, cur_entry, used_objects);
   }
 }
+
+
+// Declares the program points of functions that Fjalar only found
+// after outputDeclsFile() ran, in a shared library
+// (--trace-shared-libs).  Without DynComp, the .decls file may be
+// long gone, so the declarations go into the .dtrace file ahead of
+// any records for them.  With DynComp, this is just the faux pass
+// that sets up their data structures, and DC_outputDeclsAtEnd()
+// declares them along with everything else.
+void outputDeclsForNewFunctions(FunctionEntry** funcs, UInt num) {
+  FILE* saved_decls_fp = decls_fp;
+  char faux_decls = kvasir_with_dyncomp;
+  UInt i;
+
+  if (!print_declarations) {
+    return;
+  }
+
+  if (!faux_decls) {
+    if (!dtrace_fp) {
+      return;
+    }
+    // Don't split up a record that is still being buffered
+    dtrace_writer_drain();
+    decls_fp = dtrace_fp;
+  }
+
+  initDecls();
+
+  for (i = 0; i < num; i++) {
+    FunctionEntry* cur_entry = funcs[i];
+
+    if (fjalar_trace_prog_pts_filename &&
+        !prog_pts_tree_entry_found(cur_entry)) {
+      continue;
+    }
+
+    if (kvasir_object_ppts && !faux_decls) {
+      struct genhashtable* used_objects =
+        genallocateSMALLhashtable(NULL,
+                                  (int (*)(void *, void *)) &equivalentIDs);
+      harvestOneFunctionObject(cur_entry, used_objects);
+      genputtable(funcObjectTable, cur_entry, used_objects);
+    }
+
+    printOneFunctionDecl(cur_entry, 1, faux_decls);
+    printOneFunctionDecl(cur_entry, 0, faux_decls);
+  }
+
+  if (!faux_decls) {
+    cleanupDecls();
+  }
+  decls_fp = saved_decls_fp;
+}
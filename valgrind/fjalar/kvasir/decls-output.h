@@ -44,6 +44,7 @@ void initDecls(void);
 void cleanupDecls(void);
 void outputDeclsFile(char faux_decls);
 void DC_outputDeclsAtEnd(void);
+void outputDeclsForNewFunctions(FunctionEntry** funcs, UInt num);
 void debug_print_decls(void);
 
 DaikonRepType decTypeToDaikonRepType(DeclaredType decType,
@@ -54,6 +55,8 @@ void printOneFunctionDecl(FunctionEntry* funcPtr,
                           char faux_decls);
 
 // For new .decls format (designed in April 2006)
+HChar* makeDaikonFunctionName(FunctionEntry* f);
+HChar* makeDaikonExternalVarName(const HChar* fjalarName);
 void printDaikonFunctionName(FunctionEntry* f, FILE* fp);
 void printDaikonExternalVarName(VariableEntry* var, const HChar* fjalarName, FILE* fp);
 const HChar* removeSuperElements(char** stringArr, VariableEntry* var);
@@ -0,0 +1,309 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-binary.c:
+   Encoding of program point records in the binary .dtrace format
+   (see dtrace-binary.h)
+*/
+
+#include "../my_libc.h"
+
+#include "dtrace-binary.h"
+#include "dtrace-writer.h"
+#include "dtrace-output.h"
+#include "decls-output.h"
+#include "kvasir_main.h"
+
+#include "pub_tool_mallocfree.h"
+
+// A growable array of bytes
+typedef struct {
+  UChar* bytes;
+  UInt used;
+  UInt capacity;
+} ByteBuf;
+
+// The values of the program point being written (they can only be
+// handed off to dtrace-writer.c at the end, once we know whether a
+// new schema has to go in front of them and how long they are)
+static ByteBuf values = {0, 0, 0};
+// One bit per variable of the program point being written
+static ByteBuf modbits = {0, 0, 0};
+// Scratch space for building schema records
+static ByteBuf schema_rec = {0, 0, 0};
+
+// The program point being written, where its schema lives, and how
+// many of its variables have been seen so far
+static FunctionEntry* cur_func = 0;
+static char cur_isEnter = 0;
+static DtraceSchema** cur_schema_slot = 0;
+static UInt cur_var = 0;
+
+// Non-null once this execution has strayed from the current schema of
+// the program point, in which case it is built up here instead
+static DtraceSchema* new_schema = 0;
+
+static UInt next_ppt_id = 0;
+
+static void bytebuf_reserve(ByteBuf* b, UInt n) {
+  if (b->used + n > b->capacity) {
+    UInt newCapacity = (b->capacity ? b->capacity * 2 : 256);
+    while (newCapacity < b->used + n) {
+      newCapacity *= 2;
+    }
+    b->bytes = VG_(realloc)("dtrace-binary.c: bytebuf_reserve", b->bytes, newCapacity);
+    b->capacity = newCapacity;
+  }
+}
+
+static __inline__ void bytebuf_put(ByteBuf* b, UChar c) {
+  bytebuf_reserve(b, 1);
+  b->bytes[b->used++] = c;
+}
+
+static void bytebuf_put_mem(ByteBuf* b, const void* p, UInt len) {
+  bytebuf_reserve(b, len);
+  VG_(memcpy)(b->bytes + b->used, p, len);
+  b->used += len;
+}
+
+// Writes n as a varint to buf and returns the number of bytes used
+// (at most 10)
+static UInt encode_varint(UChar* buf, ULong n) {
+  UInt len = 0;
+  while (n >= 0x80) {
+    buf[len++] = (UChar)(n | 0x80);
+    n >>= 7;
+  }
+  buf[len++] = (UChar)n;
+  return len;
+}
+
+static void bytebuf_put_varint(ByteBuf* b, ULong n) {
+  bytebuf_reserve(b, 10);
+  b->used += encode_varint(b->bytes + b->used, n);
+}
+
+static void bytebuf_put_string(ByteBuf* b, const char* s) {
+  UInt len = VG_(strlen)(s);
+  bytebuf_put_varint(b, len);
+  bytebuf_put_mem(b, s, len);
+}
+
+// Writes the start of a record of the given type and payload length
+static void put_record_start(char type, UInt len) {
+  UChar buf[12];
+  buf[0] = 0;
+  buf[1] = type;
+  dtrace_put_mem((char*)buf, 2 + encode_varint(buf + 2, len));
+}
+
+static DtraceSchema* schema_new(void) {
+  return VG_(calloc)("dtrace-binary.c: schema_new", 1, sizeof(DtraceSchema));
+}
+
+static void schema_append(DtraceSchema* s, VariableEntry* var, const HChar* name) {
+  if (s->num_vars == s->capacity) {
+    s->capacity = (s->capacity ? s->capacity * 2 : 16);
+    s->vars = VG_(realloc)("dtrace-binary.c: schema_append.1", s->vars,
+                           s->capacity * sizeof(*s->vars));
+    s->names = VG_(realloc)("dtrace-binary.c: schema_append.2", s->names,
+                            s->capacity * sizeof(*s->names));
+  }
+  s->vars[s->num_vars] = var;
+  s->names[s->num_vars] = VG_(strdup)("dtrace-binary.c: schema_append.3", name);
+  s->num_vars++;
+}
+
+static void schema_free(DtraceSchema* s) {
+  UInt i;
+  for (i = 0; i < s->num_vars; i++) {
+    VG_(free)(s->names[i]);
+  }
+  if (s->vars) {
+    VG_(free)(s->vars);
+    VG_(free)(s->names);
+  }
+  VG_(free)(s);
+}
+
+// Starts a new schema from the first n variables of the current one
+// (if there is no current one, n is 0)
+static void start_new_schema(UInt n) {
+  DtraceSchema* old = *cur_schema_slot;
+  UInt i;
+  new_schema = schema_new();
+  for (i = 0; i < n; i++) {
+    schema_append(new_schema, old->vars[i], old->names[i]);
+  }
+}
+
+static void write_schema(DtraceSchema* s) {
+  HChar* funcName = makeDaikonFunctionName(cur_func);
+  UInt i;
+
+  schema_rec.used = 0;
+  bytebuf_put_varint(&schema_rec, s->ppt_id);
+  bytebuf_put_varint(&schema_rec,
+                     VG_(strlen)(funcName) +
+                     VG_(strlen)(cur_isEnter ? ENTER_PPT : EXIT_PPT));
+  bytebuf_put_mem(&schema_rec, funcName, VG_(strlen)(funcName));
+  bytebuf_put_mem(&schema_rec, cur_isEnter ? ENTER_PPT : EXIT_PPT,
+                  VG_(strlen)(cur_isEnter ? ENTER_PPT : EXIT_PPT));
+  VG_(free)(funcName);
+
+  bytebuf_put_varint(&schema_rec, s->num_vars);
+  for (i = 0; i < s->num_vars; i++) {
+    HChar* externalName = makeDaikonExternalVarName(s->names[i]);
+    bytebuf_put_string(&schema_rec, externalName);
+    VG_(free)(externalName);
+  }
+
+  put_record_start('S', schema_rec.used);
+  dtrace_put_mem((char*)schema_rec.bytes, schema_rec.used);
+}
+
+// Writes the header record which marks the file as binary
+void dtrace_bin_init(void) {
+  ByteBuf header = {0, 0, 0};
+  bytebuf_put_mem(&header, DTRACE_BINARY_MAGIC, VG_(strlen)(DTRACE_BINARY_MAGIC));
+  bytebuf_put_varint(&header, DTRACE_BINARY_VERSION);
+  bytebuf_put_string(&header, UNINIT);
+  bytebuf_put_string(&header, NONSENSICAL);
+  put_record_start('H', header.used);
+  dtrace_put_mem((char*)header.bytes, header.used);
+  VG_(free)(header.bytes);
+}
+
+void dtrace_bin_begin_ppt(FunctionEntry* funcPtr, char isEnter) {
+  DaikonFunctionEntry* daikonFuncPtr = (DaikonFunctionEntry*)funcPtr;
+
+  cur_func = funcPtr;
+  cur_isEnter = isEnter;
+  cur_schema_slot = (isEnter ?
+                     &daikonFuncPtr->dtrace_enter_schema :
+                     &daikonFuncPtr->dtrace_exit_schema);
+  cur_var = 0;
+  new_schema = 0;
+
+  values.used = 0;
+  modbits.used = 0;
+}
+
+void dtrace_bin_end_ppt(void) {
+  DtraceSchema* s = *cur_schema_slot;
+  UChar prefix[30];
+  UInt prefixLen;
+  UInt numModbitBytes = (cur_var + 7) / 8;
+
+  // Fewer variables than last time
+  if (!new_schema && (!s || cur_var != s->num_vars)) {
+    start_new_schema(cur_var);
+  }
+
+  if (new_schema) {
+    new_schema->ppt_id = next_ppt_id++;
+    if (s) {
+      schema_free(s);
+    }
+    *cur_schema_slot = s = new_schema;
+    new_schema = 0;
+    write_schema(s);
+  }
+
+  prefixLen = encode_varint(prefix, s->ppt_id);
+  prefixLen += encode_varint(prefix + prefixLen, cur_func->nonce);
+  prefixLen += encode_varint(prefix + prefixLen, cur_var);
+
+  put_record_start('I', prefixLen + numModbitBytes + values.used);
+  dtrace_put_mem((char*)prefix, prefixLen);
+  dtrace_put_mem((char*)modbits.bytes, numModbitBytes);
+  dtrace_put_mem((char*)values.bytes, values.used);
+}
+
+// Called in place of writing the name of each variable
+void dtrace_bin_var(VariableEntry* var, const HChar* varName) {
+  DtraceSchema* s = *cur_schema_slot;
+
+  if (new_schema ||
+      !s || cur_var >= s->num_vars ||
+      s->vars[cur_var] != var ||
+      !VG_STREQ(s->names[cur_var], varName)) {
+    if (!new_schema) {
+      start_new_schema(cur_var);
+    }
+    schema_append(new_schema, var, varName);
+  }
+
+  if ((cur_var & 7) == 0) {
+    bytebuf_put(&modbits, 0);
+  }
+  cur_var++;
+}
+
+// Called in place of writing the modbit of the current variable
+void dtrace_bin_end_var(char hasValue, char isUninit) {
+  tl_assert(cur_var > 0);
+  if (hasValue) {
+    modbits.bytes[(cur_var - 1) / 8] |= 1 << ((cur_var - 1) & 7);
+  }
+  else {
+    bytebuf_put(&values, isUninit ? 'U' : 'N');
+  }
+}
+
+void dtrace_bin_int(Long n) {
+  bytebuf_reserve(&values, 11);
+  values.bytes[values.used++] = 'i';
+  values.used += encode_varint(values.bytes + values.used,
+                               ((ULong)n << 1) ^ (ULong)(n >> 63));
+}
+
+void dtrace_bin_uint(ULong n) {
+  bytebuf_reserve(&values, 11);
+  values.bytes[values.used++] = 'u';
+  values.used += encode_varint(values.bytes + values.used, n);
+}
+
+void dtrace_bin_hashcode(Addr a) {
+  bytebuf_reserve(&values, 11);
+  values.bytes[values.used++] = 'p';
+  values.used += encode_varint(values.bytes + values.used, a);
+}
+
+// Every platform that Kvasir runs on is little-endian, so floats and
+// doubles are just copied
+void dtrace_bin_float(float f) {
+  bytebuf_put(&values, 'f');
+  bytebuf_put_mem(&values, &f, sizeof(f));
+}
+
+void dtrace_bin_double(double d) {
+  bytebuf_put(&values, 'd');
+  bytebuf_put_mem(&values, &d, sizeof(d));
+}
+
+void dtrace_bin_string(const char* s, UInt len) {
+  bytebuf_put(&values, 's');
+  bytebuf_put_varint(&values, len);
+  bytebuf_put_mem(&values, s, len);
+}
+
+void dtrace_bin_sequence_start(UInt count) {
+  bytebuf_put(&values, '[');
+  bytebuf_put_varint(&values, count);
+}
+
+void dtrace_bin_nonsensical_elt(void) {
+  bytebuf_put(&values, 'N');
+}
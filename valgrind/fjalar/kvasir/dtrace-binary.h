@@ -0,0 +1,89 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-binary.h:
+   The compact binary .dtrace format (--dtrace-format=binary).
+
+   Everything that Kvasir writes to the .dtrace file outside of the
+   program point records (the header lines and the declarations) stays
+   as text.  Each program point record is replaced by a binary record,
+   which a reader can tell apart from a text line because it starts
+   with a 0 byte:
+
+     0x00  <type byte>  <payload length: varint>  <payload>
+
+   'H' (once at the start):
+     "KVASIR-DTRACE-BINARY" <version: varint>
+     <len> <uninit string> <len> <nonsensical string>
+   The two strings are what the text format prints for the value of an
+   uninitialized variable and of a nonsensical one.
+
+   'S' (schema, written before the first record that uses it):
+     <ppt id> <len> <ppt name> <num vars> { <len> <var name> }*
+   The names are exactly as they appear in the text format.
+
+   'I' (one program point execution):
+     <ppt id> <nonce> <num vars> <modbits> { <value> }*
+   <modbits> has one bit per variable (low bit first); a 1 means the
+   modbit is 1, and a 0 means that it is 2 and the variable's value
+   is 'U' (uninitialized) or 'N' (nonsensical).
+
+   A value is a tag byte followed by its data:
+     'i' zigzag varint    'u' varint     'p' varint (hashcode)
+     'f' IEEE float       'd' IEEE double   (little-endian)
+     's' <len> <bytes>    (unescaped)
+     '[' <count> { <value> or 'N' for nonsensical }*
+
+   All integers are unsigned LEB128 varints.  The schema for a program
+   point only changes if its list of variables does, so the variable
+   names are written once instead of on every execution.
+   tools/dtrace_binary_to_text.py converts the result back to the
+   ordinary text format.
+*/
+
+#ifndef DTRACE_BINARY_H
+#define DTRACE_BINARY_H
+
+#include "../fjalar_include.h"
+
+#define DTRACE_BINARY_MAGIC "KVASIR-DTRACE-BINARY"
+#define DTRACE_BINARY_VERSION 2
+
+// The schema of one program point: the variables (and their names)
+// in the order that they are traversed
+typedef struct _DtraceSchema {
+  UInt ppt_id;
+  UInt num_vars;
+  UInt capacity;
+  VariableEntry** vars;
+  HChar** names;     // Fjalar names
+} DtraceSchema;
+
+void dtrace_bin_init(void);
+
+void dtrace_bin_begin_ppt(FunctionEntry* funcPtr, char isEnter);
+void dtrace_bin_end_ppt(void);
+
+void dtrace_bin_var(VariableEntry* var, const HChar* varName);
+void dtrace_bin_end_var(char hasValue, char isUninit);
+
+void dtrace_bin_int(Long n);
+void dtrace_bin_uint(ULong n);
+void dtrace_bin_hashcode(Addr a);
+void dtrace_bin_float(float f);
+void dtrace_bin_double(double d);
+void dtrace_bin_string(const char* s, UInt len);
+void dtrace_bin_sequence_start(UInt count);
+void dtrace_bin_nonsensical_elt(void);
+
+#endif
@@ -0,0 +1,721 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-gzip.c:
+   A small deflate (RFC 1951) compressor and gzip (RFC 1952) writer
+   for the .dtrace file, since we can't link against zlib.
+
+   Each block is compressed on its own: LZ77 with hash chains (greedy
+   matching at levels 1-3, one step of lazy matching above that), then
+   a single dynamic Huffman block, or a stored block if that turns out
+   to be smaller.  Level 0 stores everything.
+*/
+
+#include "../my_libc.h"
+
+#include "dtrace-gzip.h"
+
+#include "pub_tool_basics.h"
+#include "pub_tool_libcassert.h"
+#include "pub_tool_libcbase.h"
+#include "pub_tool_libcfile.h"
+#include "pub_tool_mallocfree.h"
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MAX_DISTANCE 32768
+
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+
+#define NUM_LITLEN_CODES 286
+#define NUM_DIST_CODES 30
+#define NUM_CLEN_CODES 19
+#define END_OF_BLOCK 256
+
+#define MAX_CODE_BITS 15
+#define MAX_CLEN_BITS 7
+
+// gzip header (10 bytes) + XLEN (2) + the 'BC' subfield (6)
+#define GZIP_HEADER_SIZE 18
+#define GZIP_TRAILER_SIZE 8
+
+typedef struct {
+  UShort litlen; // A literal byte, or a match length (when dist != 0)
+  UShort dist;
+} LZSymbol;
+
+typedef struct {
+  int fd;
+  int level;
+
+  UChar* in;         // The current block of uncompressed input
+  UInt in_used;
+
+  UChar* out;        // One compressed gzip member
+  UInt out_pos;
+  UInt bit_buf;
+  UInt bit_count;
+
+  UShort* head;      // Most recent position (+1) with each hash
+  UShort* prev;      // Previous position (+1) with the same hash
+  LZSymbol* syms;
+  UInt num_syms;
+
+  Bool error;
+} GzipStream;
+
+static const UShort LEN_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const UChar LEN_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const UShort DIST_BASE[NUM_DIST_CODES] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+  16385, 24577 };
+static const UChar DIST_EXTRA[NUM_DIST_CODES] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const UChar CLEN_ORDER[NUM_CLEN_CODES] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// How hard to look for matches at each level
+static const UShort MAX_CHAIN[10] = { 0, 4, 8, 16, 16, 32, 128, 256, 1024, 4096 };
+static const UShort NICE_LENGTH[10] = { 0, 8, 16, 32, 16, 32, 128, 128, 258, 258 };
+
+// Filled in by init_tables()
+static Bool tables_ready = False;
+static UInt crc_table[256];
+static UChar len_code[MAX_MATCH + 1];   // Match length -> index into LEN_BASE
+static UChar dist_code_lo[256];         // (distance - 1) -> code, for distances <= 256
+static UChar dist_code_hi[256];         // (distance - 1) >> 7 -> code, for the rest
+
+static void init_tables(void) {
+  UInt i, code;
+
+  for (i = 0; i < 256; i++) {
+    UInt c = i;
+    int k;
+    for (k = 0; k < 8; k++) {
+      c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+    }
+    crc_table[i] = c;
+  }
+
+  for (code = 0; code < 29; code++) {
+    UInt len;
+    for (len = LEN_BASE[code];
+         (len < LEN_BASE[code] + (1U << LEN_EXTRA[code])) && (len <= MAX_MATCH);
+         len++) {
+      len_code[len] = code;
+    }
+  }
+  // 258 has a code of its own, even though code 27 could also reach it
+  len_code[MAX_MATCH] = 28;
+
+  for (code = 0; code < NUM_DIST_CODES; code++) {
+    UInt d;
+    for (d = DIST_BASE[code]; d < DIST_BASE[code] + (1U << DIST_EXTRA[code]); d++) {
+      if (d <= 256) {
+        dist_code_lo[d - 1] = code;
+      }
+      else {
+        dist_code_hi[(d - 1) >> 7] = code;
+      }
+    }
+  }
+
+  tables_ready = True;
+}
+
+static __inline__ UInt dist_code(UInt dist) {
+  return (dist <= 256) ? dist_code_lo[dist - 1] : dist_code_hi[(dist - 1) >> 7];
+}
+
+static UInt crc32(UInt crc, const UChar* buf, UInt len) {
+  UInt i;
+  crc = ~crc;
+  for (i = 0; i < len; i++) {
+    crc = crc_table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+
+// Output
+
+static __inline__ void put_bits(GzipStream* gz, UInt value, UInt nbits) {
+  gz->bit_buf |= value << gz->bit_count;
+  gz->bit_count += nbits;
+  while (gz->bit_count >= 8) {
+    gz->out[gz->out_pos++] = gz->bit_buf & 0xff;
+    gz->bit_buf >>= 8;
+    gz->bit_count -= 8;
+  }
+}
+
+static void align_bits(GzipStream* gz) {
+  if (gz->bit_count) {
+    gz->out[gz->out_pos++] = gz->bit_buf & 0xff;
+  }
+  gz->bit_buf = 0;
+  gz->bit_count = 0;
+}
+
+static void put_le16(GzipStream* gz, UInt v) {
+  gz->out[gz->out_pos++] = v & 0xff;
+  gz->out[gz->out_pos++] = (v >> 8) & 0xff;
+}
+
+static void put_le32(GzipStream* gz, UInt v) {
+  put_le16(gz, v & 0xffff);
+  put_le16(gz, v >> 16);
+}
+
+static void write_all(GzipStream* gz, const UChar* buf, UInt len) {
+  while (len && !gz->error) {
+    Int ret = VG_(write)(gz->fd, buf, len);
+    if (ret <= 0) {
+      gz->error = True;
+    }
+    else {
+      buf += ret;
+      len -= ret;
+    }
+  }
+}
+
+
+// LZ77
+
+static __inline__ UInt hash3(const UChar* p) {
+  return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (HASH_SIZE - 1);
+}
+
+static __inline__ void insert_hash(GzipStream* gz, UInt pos) {
+  UInt h = hash3(gz->in + pos);
+  gz->prev[pos] = gz->head[h];
+  gz->head[h] = pos + 1;
+}
+
+// Returns the length of the longest match for the bytes at pos (0 if
+// there isn't one of at least MIN_MATCH), and its distance in *pDist
+static UInt longest_match(GzipStream* gz, UInt pos, UInt* pDist) {
+  const UChar* buf = gz->in;
+  UInt maxLen = MIN(MAX_MATCH, gz->in_used - pos);
+  UInt chain = MAX_CHAIN[gz->level];
+  UInt nice = NICE_LENGTH[gz->level];
+  UInt best = MIN_MATCH - 1;
+  UInt cand;
+
+  if (maxLen < MIN_MATCH) {
+    return 0;
+  }
+
+  cand = gz->head[hash3(buf + pos)];
+  while (cand && chain--) {
+    UInt c = cand - 1;
+    if (pos - c > MAX_DISTANCE) {
+      break;
+    }
+    if ((buf[c + best] == buf[pos + best]) && (buf[c] == buf[pos])) {
+      UInt len = 1;
+      while ((len < maxLen) && (buf[c + len] == buf[pos + len])) {
+        len++;
+      }
+      if (len > best) {
+        best = len;
+        *pDist = pos - c;
+        if ((len >= nice) || (len >= maxLen)) {
+          break;
+        }
+      }
+    }
+    cand = gz->prev[c];
+  }
+
+  return (best >= MIN_MATCH) ? best : 0;
+}
+
+// Turns the current block into LZ77 symbols in gz->syms
+static void find_matches(GzipStream* gz) {
+  UInt n = gz->in_used;
+  UInt inserted = 0; // Every position before this one is in the hash chains
+  UInt pos = 0;
+  Bool lazy = (gz->level >= 4);
+
+  VG_(memset)(gz->head, 0, HASH_SIZE * sizeof(*gz->head));
+  gz->num_syms = 0;
+
+#define INSERT_UNTIL(p) \
+  while ((inserted < (p)) && (inserted + MIN_MATCH <= n)) { \
+    insert_hash(gz, inserted); \
+    inserted++; \
+  }
+
+  while (pos < n) {
+    UInt dist = 0;
+    UInt len;
+
+    INSERT_UNTIL(pos);
+    len = longest_match(gz, pos, &dist);
+
+    // If the next position has a longer match, emit a literal here
+    // and take that one instead
+    if (lazy && len && (len < NICE_LENGTH[gz->level]) && (pos + 1 < n)) {
+      UInt nextDist = 0;
+      UInt nextLen;
+      INSERT_UNTIL(pos + 1);
+      nextLen = longest_match(gz, pos + 1, &nextDist);
+      if (nextLen > len) {
+        len = 0;
+      }
+    }
+
+    if (len) {
+      gz->syms[gz->num_syms].litlen = len;
+      gz->syms[gz->num_syms].dist = dist;
+      pos += len;
+    }
+    else {
+      gz->syms[gz->num_syms].litlen = gz->in[pos];
+      gz->syms[gz->num_syms].dist = 0;
+      pos++;
+    }
+    gz->num_syms++;
+  }
+
+#undef INSERT_UNTIL
+}
+
+
+// Huffman codes
+
+// Computes code lengths (no longer than limit) for the n symbols with
+// the given frequencies.  There are always at least two codes, since
+// some inflaters don't cope with fewer.
+static void build_code_lengths(const UInt* freq, UInt n, UInt limit, UChar* lengths) {
+  UInt f[2 * NUM_LITLEN_CODES];
+  Int parent[2 * NUM_LITLEN_CODES];
+  Bool done[2 * NUM_LITLEN_CODES];
+  UInt leaves[NUM_LITLEN_CODES];
+  UInt numLeaves = 0;
+  UInt i;
+
+  tl_assert(n <= NUM_LITLEN_CODES);
+
+  for (i = 0; i < n; i++) {
+    f[i] = freq[i];
+    if (freq[i]) {
+      leaves[numLeaves++] = i;
+    }
+  }
+  // Pad up to two codes with unused symbols
+  for (i = 0; (numLeaves < 2) && (i < n); i++) {
+    if (!f[i]) {
+      f[i] = 1;
+      leaves[numLeaves++] = i;
+    }
+  }
+
+  for (;;) {
+    UInt numNodes = n;
+    UInt remaining = numLeaves;
+    UInt maxDepth = 0;
+
+    for (i = 0; i < n; i++) {
+      parent[i] = -1;
+      done[i] = (f[i] == 0);
+    }
+
+    // Repeatedly join the two lightest trees (n is small, so a linear
+    // scan is good enough)
+    while (remaining > 1) {
+      Int a = -1, b = -1;
+      for (i = 0; i < numNodes; i++) {
+        if (done[i]) {
+          continue;
+        }
+        if ((a < 0) || (f[i] < f[a])) {
+          b = a;
+          a = i;
+        }
+        else if ((b < 0) || (f[i] < f[b])) {
+          b = i;
+        }
+      }
+      f[numNodes] = f[a] + f[b];
+      parent[numNodes] = -1;
+      done[numNodes] = False;
+      parent[a] = parent[b] = numNodes;
+      done[a] = done[b] = True;
+      numNodes++;
+      remaining--;
+    }
+
+    for (i = 0; i < n; i++) {
+      UInt depth = 0;
+      Int node = i;
+      if (!f[i]) {
+        lengths[i] = 0;
+        continue;
+      }
+      while (parent[node] >= 0) {
+        node = parent[node];
+        depth++;
+      }
+      lengths[i] = depth;
+      if (depth > maxDepth) {
+        maxDepth = depth;
+      }
+    }
+
+    if (maxDepth <= limit) {
+      return;
+    }
+
+    // Too deep, so flatten the frequencies and try again
+    for (i = 0; i < numLeaves; i++) {
+      UInt s = leaves[i];
+      f[s] = (f[s] + 1) >> 1;
+    }
+  }
+}
+
+// Assigns canonical codes (RFC 1951 3.2.2), bit-reversed since deflate
+// sends Huffman codes starting from the most significant bit
+static void build_codes(const UChar* lengths, UInt n, UShort* codes) {
+  UInt count[MAX_CODE_BITS + 1];
+  UInt next[MAX_CODE_BITS + 1];
+  UInt code = 0;
+  UInt i, bits;
+
+  VG_(memset)(count, 0, sizeof(count));
+  for (i = 0; i < n; i++) {
+    count[lengths[i]]++;
+  }
+  count[0] = 0;
+  for (bits = 1; bits <= MAX_CODE_BITS; bits++) {
+    code = (code + count[bits - 1]) << 1;
+    next[bits] = code;
+  }
+
+  for (i = 0; i < n; i++) {
+    UInt len = lengths[i];
+    if (len) {
+      UInt c = next[len]++;
+      UInt rev = 0;
+      UInt k;
+      for (k = 0; k < len; k++) {
+        rev = (rev << 1) | (c & 1);
+        c >>= 1;
+      }
+      codes[i] = rev;
+    }
+    else {
+      codes[i] = 0;
+    }
+  }
+}
+
+// Run-length encodes the code lengths with symbols 16-18; each entry
+// of out is a symbol in the low 5 bits and its extra bits above that
+static UInt encode_code_lengths(const UChar* lengths, UInt n, UShort* out) {
+  UInt num = 0;
+  UInt i = 0;
+
+  while (i < n) {
+    UChar len = lengths[i];
+    UInt run = 1;
+    while ((i + run < n) && (lengths[i + run] == len)) {
+      run++;
+    }
+    i += run;
+
+    if (len == 0) {
+      while (run >= 11) {
+        UInt r = MIN(run, 138);
+        out[num++] = 18 | ((r - 11) << 5);
+        run -= r;
+      }
+      if (run >= 3) {
+        out[num++] = 17 | ((run - 3) << 5);
+        run = 0;
+      }
+    }
+    else {
+      out[num++] = len;
+      run--;
+      while (run >= 3) {
+        UInt r = MIN(run, 6);
+        out[num++] = 16 | ((r - 3) << 5);
+        run -= r;
+      }
+    }
+    while (run--) {
+      out[num++] = len;
+    }
+  }
+
+  return num;
+}
+
+static const UChar CLEN_EXTRA_BITS[NUM_CLEN_CODES] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+
+// Compresses the current block into gz->out as one final deflate block
+static void deflate_block(GzipStream* gz) {
+  UInt litFreq[NUM_LITLEN_CODES];
+  UInt distFreq[NUM_DIST_CODES];
+  UInt clenFreq[NUM_CLEN_CODES];
+  UChar lengths[NUM_LITLEN_CODES + NUM_DIST_CODES];
+  UChar* litLengths = lengths;
+  UChar distLengths[NUM_DIST_CODES];
+  UChar clenLengths[NUM_CLEN_CODES];
+  UShort litCodes[NUM_LITLEN_CODES];
+  UShort distCodes[NUM_DIST_CODES];
+  UShort clenCodes[NUM_CLEN_CODES];
+  UShort clenSyms[NUM_LITLEN_CODES + NUM_DIST_CODES];
+  UInt numClenSyms;
+  UInt hlit, hdist, hclen;
+  ULong dynamicBits, storedBits;
+  UInt i;
+
+  if (gz->level > 0) {
+    find_matches(gz);
+  }
+
+  if (gz->level == 0) {
+    dynamicBits = ~0ULL;
+  }
+  else {
+    VG_(memset)(litFreq, 0, sizeof(litFreq));
+    VG_(memset)(distFreq, 0, sizeof(distFreq));
+    VG_(memset)(clenFreq, 0, sizeof(clenFreq));
+
+    for (i = 0; i < gz->num_syms; i++) {
+      LZSymbol* sym = &gz->syms[i];
+      if (sym->dist) {
+        litFreq[257 + len_code[sym->litlen]]++;
+        distFreq[dist_code(sym->dist)]++;
+      }
+      else {
+        litFreq[sym->litlen]++;
+      }
+    }
+    litFreq[END_OF_BLOCK]++;
+
+    build_code_lengths(litFreq, NUM_LITLEN_CODES, MAX_CODE_BITS, litLengths);
+    build_code_lengths(distFreq, NUM_DIST_CODES, MAX_CODE_BITS, distLengths);
+
+    for (hlit = NUM_LITLEN_CODES; (hlit > 257) && !litLengths[hlit - 1]; hlit--);
+    for (hdist = NUM_DIST_CODES; (hdist > 1) && !distLengths[hdist - 1]; hdist--);
+
+    // The two sets of lengths are sent back to back
+    VG_(memmove)(lengths + hlit, distLengths, hdist);
+    numClenSyms = encode_code_lengths(lengths, hlit + hdist, clenSyms);
+    for (i = hlit; i < NUM_LITLEN_CODES; i++) {
+      litLengths[i] = 0;
+    }
+
+    for (i = 0; i < numClenSyms; i++) {
+      clenFreq[clenSyms[i] & 0x1f]++;
+    }
+    build_code_lengths(clenFreq, NUM_CLEN_CODES, MAX_CLEN_BITS, clenLengths);
+
+    for (hclen = NUM_CLEN_CODES; (hclen > 4) && !clenLengths[CLEN_ORDER[hclen - 1]]; hclen--);
+
+    // Work out exactly how big the dynamic block would be
+    dynamicBits = 3 + 5 + 5 + 4 + 3 * hclen;
+    for (i = 0; i < numClenSyms; i++) {
+      UInt s = clenSyms[i] & 0x1f;
+      dynamicBits += clenLengths[s] + CLEN_EXTRA_BITS[s];
+    }
+    for (i = 0; i < NUM_LITLEN_CODES; i++) {
+      dynamicBits += (ULong)litFreq[i] * litLengths[i];
+      if (i > 256) {
+        dynamicBits += (ULong)litFreq[i] * LEN_EXTRA[i - 257];
+      }
+    }
+    for (i = 0; i < NUM_DIST_CODES; i++) {
+      dynamicBits += (ULong)distFreq[i] * (distLengths[i] + DIST_EXTRA[i]);
+    }
+  }
+
+  storedBits = 3 + 7 + 32 + 8 * (ULong)gz->in_used;
+
+  if (dynamicBits < storedBits) {
+    build_codes(litLengths, NUM_LITLEN_CODES, litCodes);
+    build_codes(distLengths, NUM_DIST_CODES, distCodes);
+    build_codes(clenLengths, NUM_CLEN_CODES, clenCodes);
+
+    put_bits(gz, 1, 1); // BFINAL
+    put_bits(gz, 2, 2); // BTYPE = dynamic Huffman
+    put_bits(gz, hlit - 257, 5);
+    put_bits(gz, hdist - 1, 5);
+    put_bits(gz, hclen - 4, 4);
+    for (i = 0; i < hclen; i++) {
+      put_bits(gz, clenLengths[CLEN_ORDER[i]], 3);
+    }
+    for (i = 0; i < numClenSyms; i++) {
+      UInt s = clenSyms[i] & 0x1f;
+      put_bits(gz, clenCodes[s], clenLengths[s]);
+      if (CLEN_EXTRA_BITS[s]) {
+        put_bits(gz, clenSyms[i] >> 5, CLEN_EXTRA_BITS[s]);
+      }
+    }
+
+    for (i = 0; i < gz->num_syms; i++) {
+      LZSymbol* sym = &gz->syms[i];
+      if (sym->dist) {
+        UInt lc = len_code[sym->litlen];
+        UInt dc = dist_code(sym->dist);
+        put_bits(gz, litCodes[257 + lc], litLengths[257 + lc]);
+        if (LEN_EXTRA[lc]) {
+          put_bits(gz, sym->litlen - LEN_BASE[lc], LEN_EXTRA[lc]);
+        }
+        put_bits(gz, distCodes[dc], distLengths[dc]);
+        if (DIST_EXTRA[dc]) {
+          put_bits(gz, sym->dist - DIST_BASE[dc], DIST_EXTRA[dc]);
+        }
+      }
+      else {
+        put_bits(gz, litCodes[sym->litlen], litLengths[sym->litlen]);
+      }
+    }
+    put_bits(gz, litCodes[END_OF_BLOCK], litLengths[END_OF_BLOCK]);
+    align_bits(gz);
+  }
+  else {
+    put_bits(gz, 1, 1); // BFINAL
+    put_bits(gz, 0, 2); // BTYPE = stored
+    align_bits(gz);
+    put_le16(gz, gz->in_used);
+    put_le16(gz, ~gz->in_used & 0xffff);
+    VG_(memcpy)(gz->out + gz->out_pos, gz->in, gz->in_used);
+    gz->out_pos += gz->in_used;
+  }
+}
+
+// Compresses the current block into a gzip member and writes it out.
+// (An empty block makes the end-of-file marker.)
+static void write_member(GzipStream* gz) {
+  gz->out_pos = 0;
+  gz->bit_buf = 0;
+  gz->bit_count = 0;
+
+  // ID1, ID2, CM = deflate, FLG = FEXTRA
+  gz->out[gz->out_pos++] = 0x1f;
+  gz->out[gz->out_pos++] = 0x8b;
+  gz->out[gz->out_pos++] = 8;
+  gz->out[gz->out_pos++] = 4;
+  put_le32(gz, 0);                  // MTIME
+  gz->out[gz->out_pos++] = 0;       // XFL
+  gz->out[gz->out_pos++] = 0xff;    // OS = unknown
+  put_le16(gz, 6);                  // XLEN
+  gz->out[gz->out_pos++] = 'B';
+  gz->out[gz->out_pos++] = 'C';
+  put_le16(gz, 2);
+  put_le16(gz, 0);                  // BSIZE, filled in below
+
+  if (gz->in_used) {
+    deflate_block(gz);
+  }
+  else {
+    // A final fixed-Huffman block holding nothing but end-of-block
+    put_bits(gz, 1, 1);
+    put_bits(gz, 1, 2);
+    put_bits(gz, 0, 7);
+    align_bits(gz);
+  }
+
+  put_le32(gz, crc32(0, gz->in, gz->in_used));
+  put_le32(gz, gz->in_used);
+
+  // BSIZE is the size of the whole member minus one
+  tl_assert(gz->out_pos <= 0x10000);
+  gz->out[GZIP_HEADER_SIZE - 2] = (gz->out_pos - 1) & 0xff;
+  gz->out[GZIP_HEADER_SIZE - 1] = ((gz->out_pos - 1) >> 8) & 0xff;
+
+  write_all(gz, gz->out, gz->out_pos);
+  gz->in_used = 0;
+}
+
+static int gzip_write(void* cookie, const char* buf, size_t len) {
+  GzipStream* gz = (GzipStream*)cookie;
+  size_t left = len;
+
+  while (left) {
+    UInt n = MIN(left, DTRACE_GZIP_BLOCK_SIZE - gz->in_used);
+    VG_(memcpy)(gz->in + gz->in_used, buf, n);
+    gz->in_used += n;
+    buf += n;
+    left -= n;
+    if (gz->in_used == DTRACE_GZIP_BLOCK_SIZE) {
+      write_member(gz);
+    }
+  }
+
+  return gz->error ? -1 : (int)len;
+}
+
+static void free_stream(GzipStream* gz) {
+  VG_(free)(gz->in);
+  VG_(free)(gz->out);
+  VG_(free)(gz->head);
+  VG_(free)(gz->prev);
+  VG_(free)(gz->syms);
+  VG_(free)(gz);
+}
+
+static int gzip_close(void* cookie) {
+  GzipStream* gz = (GzipStream*)cookie;
+  int res;
+
+  if (gz->in_used) {
+    write_member(gz);
+  }
+  write_member(gz); // End-of-file marker
+  res = gz->error ? -1 : 0;
+
+  free_stream(gz);
+  return res;
+}
+
+FILE* dtrace_gzip_fdopen(int fd, const char* mode, int level) {
+  GzipStream* gz;
+  FILE* fp;
+
+  if (!tables_ready) {
+    init_tables();
+  }
+
+  gz = VG_(calloc)("dtrace-gzip.c: dtrace_gzip_fdopen.1", 1, sizeof(*gz));
+  gz->fd = fd;
+  gz->level = MAX(0, MIN(level, 9));
+  gz->in = VG_(malloc)("dtrace-gzip.c: dtrace_gzip_fdopen.2", DTRACE_GZIP_BLOCK_SIZE);
+  gz->out = VG_(malloc)("dtrace-gzip.c: dtrace_gzip_fdopen.3", 2 * DTRACE_GZIP_BLOCK_SIZE);
+  gz->head = VG_(malloc)("dtrace-gzip.c: dtrace_gzip_fdopen.4", HASH_SIZE * sizeof(*gz->head));
+  gz->prev = VG_(malloc)("dtrace-gzip.c: dtrace_gzip_fdopen.5",
+                         DTRACE_GZIP_BLOCK_SIZE * sizeof(*gz->prev));
+  gz->syms = VG_(malloc)("dtrace-gzip.c: dtrace_gzip_fdopen.6",
+                         DTRACE_GZIP_BLOCK_SIZE * sizeof(*gz->syms));
+
+  fp = fdopen_filtered(fd, mode, &gzip_write, &gzip_close, gz);
+  if (!fp) {
+    free_stream(gz);
+  }
+  return fp;
+}
@@ -0,0 +1,39 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-gzip.h:
+   In-process gzip compression of the .dtrace file (--dtrace-gzip).
+
+   The output is a series of independent gzip members, each holding
+   up to DTRACE_GZIP_BLOCK_SIZE bytes of .dtrace text, followed by an
+   empty member to mark the end.  Like BGZF, every member carries its
+   own compressed size in a 'BC' extra subfield, so a reader can skip
+   from block to block (and find any uncompressed offset) without
+   inflating anything.  Since it is still ordinary multi-member gzip,
+   gunzip and java.util.zip.GZIPInputStream read it as usual.
+*/
+
+#ifndef DTRACE_GZIP_H
+#define DTRACE_GZIP_H
+
+#include "../my_libc.h"
+
+// Keep a stored (uncompressed) member under 64KB so that its size
+// fits in the 16-bit 'BC' field
+#define DTRACE_GZIP_BLOCK_SIZE 0xff00
+
+// Returns a FILE* which compresses everything written to it at the
+// given level (0-9) before writing it to fd, or 0 on failure
+FILE* dtrace_gzip_fdopen(int fd, const char* mode, int level);
+
+#endif
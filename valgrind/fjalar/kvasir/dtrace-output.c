@@ -26,8 +26,11 @@
 #include "../my_libc.h"
 
 #include "dtrace-output.h"
+#include "dtrace-writer.h"
+#include "dtrace-binary.h"
 #include "decls-output.h"
 #include "kvasir_main.h"
+#include "kvasir_profile.h"
 #include "../fjalar_include.h"
 
 #include "dyncomp_main.h"
@@ -41,8 +44,19 @@
 #define max(a, b) ((a) < (b) ? (a) : (b))
 
 
+// All output to the .dtrace file goes through dtrace-writer.c so that
+// it stays in order.  (The text-only ones are never used for values
+// with --dtrace-format=binary.)
 #define DTRACE_PRINTF(...) do { if (!dyncomp_without_dtrace) \
-       fprintf(dtrace_fp, __VA_ARGS__); } while (0)
+       dtrace_printf(__VA_ARGS__); } while (0)
+#define DTRACE_PUTS(s) do { if (!dyncomp_without_dtrace) \
+       dtrace_put_str(s); } while (0)
+#define DTRACE_PUTC(c) do { if (!dyncomp_without_dtrace) \
+       dtrace_put_char(c); } while (0)
+#define DTRACE_PUT_INT(n) do { if (!dyncomp_without_dtrace) \
+       printDtraceSigned(n); } while (0)
+#define DTRACE_PUT_PTR(a) do { if (!dyncomp_without_dtrace) \
+       printDtraceHashcode((Addr)(a)); } while (0)
 
 // Global variable storing the current variable name.
 // currently used for debugging comparability values
@@ -52,8 +66,9 @@ const HChar* cur_var_name = NULL;
 
 // Daikon officially supports only "nonsensical", not "uninit".
 // Having two strings in this code makes the reason clearer, though.
-const HChar* UNINIT = "nonsensical";
-const HChar* NONSENSICAL = "nonsensical";
+// (They are arrays so that printDtraceValueEnd() can tell them apart.)
+const HChar UNINIT[] = "nonsensical";
+const HChar NONSENSICAL[] = "nonsensical";
 const HChar* func_name = 0;
 
 UWord nonce[300];
@@ -98,27 +113,34 @@ extern const int DecTypeByteSizes[];
 // to the .dtrace file:
 static void printDtraceFunctionHeader(FunctionEntry* funcPtr, char isEnter)
 {
+  DaikonFunctionEntry* daikonFuncPtr = (DaikonFunctionEntry*)funcPtr;
+  char** pHeader = (isEnter ?
+                    &daikonFuncPtr->dtrace_enter_header :
+                    &daikonFuncPtr->dtrace_exit_header);
+
   DPRINTF("Printing dtrace header for %s\n", funcPtr->fjalar_name);
   DPRINTF("dtrace_fp is %p\n", dtrace_fp);
   tl_assert(dtrace_fp);
 
-  fputs("\n", dtrace_fp);
-  printDaikonFunctionName(funcPtr, dtrace_fp);
-
-  if (isEnter) {
-    fputs(ENTER_PPT, dtrace_fp);
-    fputs("\n", dtrace_fp);
-    fputs("this_invocation_nonce\n", dtrace_fp);
-    DTRACE_PRINTF("%d\n", funcPtr->nonce);
-
-  }
-  else {
-    fputs(EXIT_PPT, dtrace_fp);
-    fputs("\n", dtrace_fp);
-    fputs("this_invocation_nonce\n", dtrace_fp);
-    DTRACE_PRINTF("%d\n", funcPtr->nonce);
+  // The header only depends on the function, so build it the first
+  // time around and reuse it after that
+  if (!*pHeader) {
+    HChar* name = makeDaikonFunctionName(funcPtr);
+    const char* ppt = (isEnter ? ENTER_PPT : EXIT_PPT);
+    const char* nonceLine = "\nthis_invocation_nonce\n";
+    Int len = 1 + VG_(strlen)(name) + VG_(strlen)(ppt) + VG_(strlen)(nonceLine);
+
+    *pHeader = VG_(malloc)("dtrace-output.c: printDtraceFunctionHeader", len + 1);
+    VG_(strcpy)(*pHeader, "\n");
+    VG_(strcat)(*pHeader, name);
+    VG_(strcat)(*pHeader, ppt);
+    VG_(strcat)(*pHeader, nonceLine);
+    VG_(free)(name);
   }
 
+  DTRACE_PUTS(*pHeader);
+  dtrace_put_int(funcPtr->nonce);
+  DTRACE_PUTC('\n');
 
   DPRINTF("Done printing header for %s\n", funcPtr->fjalar_name);
 }
@@ -138,106 +160,267 @@ static char mapInitToModbit(char init)
     }
 }
 
-// Prints a string to dtrace_fp, keeping in mind to quote
-// special characters so that the lines don't get screwed up
-static void printOneDtraceString(char* str1)
+// Prints the end of the value line followed by the modbit line
+// (Same as DTRACE_PRINTF("%s\n%d\n", value, mapInitToModbit(init)))
+static void printDtraceValueEnd(const char* value, char init)
+{
+  if (dyncomp_without_dtrace) {
+    return;
+  }
+
+  if (kvasir_dtrace_binary) {
+    dtrace_bin_end_var(init, value == UNINIT);
+  }
+  else {
+    dtrace_put_str(value);
+    dtrace_put_char('\n');
+    dtrace_put_char('0' + mapInitToModbit(init));
+    dtrace_put_char('\n');
+  }
+}
+
+// The rest of these write one value (or part of one) in whichever
+// format the .dtrace file is in.  The callers check
+// dyncomp_without_dtrace.
+static void printDtraceSigned(Long n)
+{
+  if (kvasir_dtrace_binary) {
+    dtrace_bin_int(n);
+  }
+  else {
+    dtrace_put_int(n);
+  }
+}
+
+static void printDtraceUnsigned(ULong n)
+{
+  if (kvasir_dtrace_binary) {
+    dtrace_bin_uint(n);
+  }
+  else {
+    dtrace_put_uint(n);
+  }
+}
+
+static void printDtraceHashcode(Addr a)
+{
+  if (kvasir_dtrace_binary) {
+    dtrace_bin_hashcode(a);
+  }
+  else {
+    dtrace_put_ptr(a);
+  }
+}
+
+// Starts a sequence of numElts elements, each of which is followed by
+// a call to printDtraceEltEnd() or is printed by
+// printDtraceNonsensicalElt()
+static void printDtraceSequenceStart(UInt numElts)
+{
+  if (dyncomp_without_dtrace) {
+    return;
+  }
+
+  if (kvasir_dtrace_binary) {
+    dtrace_bin_sequence_start(numElts);
+  }
+  else {
+    dtrace_put_str("[ ");
+  }
+}
+
+static void printDtraceEltEnd(void)
+{
+  if (!dyncomp_without_dtrace && !kvasir_dtrace_binary) {
+    dtrace_put_char(' ');
+  }
+}
+
+static void printDtraceNonsensicalElt(void)
+{
+  if (dyncomp_without_dtrace) {
+    return;
+  }
+
+  // Daikon currently only supports 'nonsensical' values
+  // inside of sequences, not 'uninit' value.
+  if (kvasir_dtrace_binary) {
+    dtrace_bin_nonsensical_elt();
+  }
+  else {
+    dtrace_put_str(NONSENSICAL);
+    dtrace_put_char(' ');
+  }
+}
+
+// Prints the value of type decType at address pValue, as the matching
+// entry of TYPE_FORMAT_STRINGS would
+static void printDtraceNumber(DeclaredType decType, Addr pValue)
+{
+  if (dyncomp_without_dtrace) {
+    return;
+  }
+
+  switch (decType) {
+  case D_BOOL:
+  case D_UNSIGNED_CHAR:
+    printDtraceUnsigned(*(unsigned char*)pValue);
+    break;
+  case D_CHAR:
+    printDtraceSigned(*(char*)pValue);
+    break;
+  case D_UNSIGNED_SHORT:
+    printDtraceUnsigned(*(unsigned short*)pValue);
+    break;
+  case D_SHORT:
+    printDtraceSigned(*(short*)pValue);
+    break;
+  case D_UNSIGNED_INT:
+    printDtraceUnsigned(*(unsigned int*)pValue);
+    break;
+  case D_INT:
+  case D_ENUMERATION:
+    printDtraceSigned(*(int*)pValue);
+    break;
+  case D_UNSIGNED_LONG:
+    printDtraceUnsigned(*(unsigned long*)pValue);
+    break;
+  case D_LONG:
+    printDtraceSigned(*(long*)pValue);
+    break;
+  case D_UNSIGNED_LONG_LONG_INT:
+    printDtraceUnsigned(*(unsigned long long int*)pValue);
+    break;
+  case D_LONG_LONG_INT:
+    printDtraceSigned(*(long long int*)pValue);
+    break;
+  case D_FLOAT:
+    if (kvasir_dtrace_binary) {
+      dtrace_bin_float(*(float*)pValue);
+    }
+    else {
+      dtrace_put_double(*(float*)pValue, 9);
+    }
+    break;
+  case D_DOUBLE:
+    if (kvasir_dtrace_binary) {
+      dtrace_bin_double(*(double*)pValue);
+    }
+    else {
+      dtrace_put_double(*(double*)pValue, 17);
+    }
+    break;
+  default:
+    dtrace_put_str("printDtraceNumber() - unknown type");
+    tl_assert(0 && "printDtraceNumber() - unknown type");
+    break;
+  }
+}
+
+// Returns the length of the string str1, or of its readable prefix
+// if it runs into an unreadable character
+static int dtraceStringLength(char* str1)
 {
-  char readable;
-  Addr strHead = (Addr)str1;
   int len = 0;
-  // Print leading and trailing quotes to "QUOTE" the string
-  DTRACE_PRINTF("\"");
-  readable = addressIsInitialized((Addr)str1, sizeof(char));
+  char readable = addressIsInitialized((Addr)str1, sizeof(char));
   tl_assert(readable);
-  while (*str1 != '\0')
+  while (str1[len] != '\0')
     {
-      switch (*str1) {
-      case '\n':
-	DTRACE_PRINTF( "\\n");
-	break;
-      case '\r':
-	DTRACE_PRINTF( "\\r");
-	break;
-      case '\"':
-	DTRACE_PRINTF( "\\\"");
-	break;
-      case '\\':
-	DTRACE_PRINTF( "\\\\");
-	break;
-      default:
-	DTRACE_PRINTF( "%c", *str1);
-      }
-
-      str1++;
       len++;
 
-      readable = addressIsInitialized((Addr)str1, sizeof(char));
+      readable = addressIsInitialized((Addr)(str1 + len), sizeof(char));
 
       if (!readable) {
 	printf("  Error!  Ran into unreadable character!\n");
 	break;
       }
     }
-  DTRACE_PRINTF("\"");
-
-  // We know the length of the string so merge the tags
-  // for that many contiguous bytes in memory
-  if (kvasir_with_dyncomp) {
-    DYNCOMP_TPRINTF("dtrace call val_uf_union_tags_in_range(%p, %d) (string)\n",
-		    (void *)strHead, len);
-    val_uf_union_tags_in_range(strHead, len);
-  }
+  return len;
 }
 
-// Prints one character as though it were a string to .dtrace,
-// making sure to not mess up the line format
-static void printOneCharAsDtraceString(char c)
+// Prints one character of a string, keeping in mind to quote
+// special characters so that the lines don't get screwed up
+static void printDtraceEscapedChar(char c)
 {
-  // Print leading and trailing quotes to "QUOTE" the string
-  DTRACE_PRINTF( "\"");
-
   switch (c) {
   case '\n':
-    DTRACE_PRINTF( "\\n");
+    DTRACE_PUTS( "\\n");
     break;
   case '\r':
-    DTRACE_PRINTF( "\\r");
+    DTRACE_PUTS( "\\r");
     break;
   case '\"':
-    DTRACE_PRINTF( "\\\"");
+    DTRACE_PUTS( "\\\"");
     break;
   case '\\':
-    DTRACE_PRINTF( "\\\\");
+    DTRACE_PUTS( "\\\\");
     break;
   default:
-    DTRACE_PRINTF( "%c", c);
+    DTRACE_PUTC(c);
   }
-
-  DTRACE_PRINTF( "\"");
 }
 
-static void printOneDtraceStringAsIntArray(char* str1) {
-  char readable;
+// Prints a string to dtrace_fp, keeping in mind to quote
+// special characters so that the lines don't get screwed up
+static void printOneDtraceString(char* str1)
+{
   Addr strHead = (Addr)str1;
-  int len = 0;
+  int len = dtraceStringLength(str1);
+  int i;
 
-  DTRACE_PRINTF("[ ");
-  readable = addressIsInitialized((Addr)str1, sizeof(char));
-  tl_assert(readable);
-  while (*str1 != '\0')
-    {
-      DTRACE_PRINTF( "%d ", *str1);
+  if (kvasir_dtrace_binary) {
+    if (!dyncomp_without_dtrace) {
+      dtrace_bin_string(str1, len);
+    }
+  }
+  else {
+    // Print leading and trailing quotes to "QUOTE" the string
+    DTRACE_PUTC('"');
+    for (i = 0; i < len; i++) {
+      printDtraceEscapedChar(str1[i]);
+    }
+    DTRACE_PUTC('"');
+  }
 
-      str1++;
-      len++;
+  // We know the length of the string so merge the tags
+  // for that many contiguous bytes in memory
+  if (kvasir_with_dyncomp) {
+    DYNCOMP_TPRINTF("dtrace call val_uf_union_tags_in_range(%p, %d) (string)\n",
+		    (void *)strHead, len);
+    val_uf_union_tags_in_range(strHead, len);
+  }
+}
 
-      readable = addressIsInitialized((Addr)str1, sizeof(char));
-      if (!readable) {
-	printf("  Error!  Ran into unreadable character!\n");
-	break;
-      }
+// Prints one character as though it were a string to .dtrace,
+// making sure to not mess up the line format
+static void printOneCharAsDtraceString(char c)
+{
+  if (kvasir_dtrace_binary) {
+    if (!dyncomp_without_dtrace) {
+      dtrace_bin_string(&c, 1);
     }
-  DTRACE_PRINTF("]");
+    return;
+  }
+
+  // Print leading and trailing quotes to "QUOTE" the string
+  DTRACE_PUTC('"');
+  printDtraceEscapedChar(c);
+  DTRACE_PUTC('"');
+}
+
+static void printOneDtraceStringAsIntArray(char* str1) {
+  Addr strHead = (Addr)str1;
+  int len = dtraceStringLength(str1);
+  int i;
+
+  printDtraceSequenceStart(len);
+  for (i = 0; i < len; i++) {
+    DTRACE_PUT_INT(str1[i]);
+    printDtraceEltEnd();
+  }
+  if (!kvasir_dtrace_binary) {
+    DTRACE_PUTC(']');
+  }
 
   // We know the length of the string so merge the tags
   // for that many contiguous bytes in memory
@@ -327,12 +510,6 @@ switch (decType) \
 }
 
 
-#define DTRACE_PRINT_ONE_VAR(TYPE) \
-  DTRACE_PRINTF( TYPE_FORMAT_STRINGS[decType], *((TYPE*)(pValue)));
-
-#define DTRACE_PRINT_ONE_VAR_WITHIN_SEQUENCE(TYPE) \
-  DTRACE_PRINTF( TYPE_FORMAT_STRINGS[decType], *((TYPE*)(pCurValue)));
-
 #define DEBUG_ONE_VAR_SEQUENCE(TYPE) \
   DPRINTF( TYPE_FORMAT_STRINGS[decType], *((TYPE*)(pCurValue)));
 
@@ -379,9 +556,7 @@ static char printDtraceSingleVar(VariableEntry* var,
   // dereference:
   if (!pValue) {
     DPRINTF("no address\n");
-    DTRACE_PRINTF("%s\n%d\n",
-		  NONSENSICAL,
-		  mapInitToModbit(0));
+    printDtraceValueEnd(NONSENSICAL, 0);
     return 0;
   }
 
@@ -392,9 +567,7 @@ static char printDtraceSingleVar(VariableEntry* var,
 
   if (!allocated) {
     DPRINTF("unallocated\n");
-    DTRACE_PRINTF("%s\n%d\n",
-		  NONSENSICAL,
-		  mapInitToModbit(0));
+    printDtraceValueEnd(NONSENSICAL, 0);
     return 0;
   }
 
@@ -403,9 +576,7 @@ static char printDtraceSingleVar(VariableEntry* var,
 
   if (!initialized) {
     DPRINTF("uninit\n");
-    DTRACE_PRINTF("%s\n%d\n",
-		  UNINIT,
-		  mapInitToModbit(0));
+    printDtraceValueEnd(UNINIT, 0);
     return 0;
   }
 
@@ -421,9 +592,8 @@ static char printDtraceSingleVar(VariableEntry* var,
     // TODO: What about a pointer to a static array?
     //       var->isStaticArray says that the base variable is a
     //       static array after all dereferences are done.
-    DTRACE_PRINTF("%p\n%d\n",
-		  IS_STATIC_ARRAY_VAR(var) ? (void *)pValueGuest : (void *)(*(Addr *)pValue),
-		  mapInitToModbit(1));
+    DTRACE_PUT_PTR(IS_STATIC_ARRAY_VAR(var) ? pValueGuest : *(Addr *)pValue);
+    printDtraceValueEnd("", 1);
 
     // The note above about static arrays does not go quite far
     // enough.  See the comments in "printDtraceEntryAction" for
@@ -459,18 +629,15 @@ static char printDtraceSingleVar(VariableEntry* var,
 			      disambigOverride);
     }
     else {
-      DTRACE_PRINTF("%s\n%d\n",
-		    UNINIT,
-		    mapInitToModbit(0));
+      printDtraceValueEnd(UNINIT, 0);
       return 0;
     }
   }
   // Base (non-hashcode) struct or union type
   // Simply print out its hashcode location
   else if (IS_AGGREGATE_TYPE(var->varType)) {
-    DTRACE_PRINTF("%p\n%d\n",
-		  ((void *)pValue),
-		  mapInitToModbit(1));
+    DTRACE_PUT_PTR(pValue);
+    printDtraceValueEnd("", 1);
   }
   // Base type
   else {
@@ -535,9 +702,7 @@ static char printDtraceSequence(VariableEntry* var,
   // there is no content to dereference:
   if (!pValueArray || !numElts) {
     DPRINTF("Pointer null or 0 elements\n");
-    DTRACE_PRINTF("%s\n%d\n",
-		  NONSENSICAL,
-		  mapInitToModbit(0));
+    printDtraceValueEnd(NONSENSICAL, 0);
     return 0;
   }
 
@@ -551,9 +716,7 @@ static char printDtraceSequence(VariableEntry* var,
   }
   if (!someEltNonZero) {
     DPRINTF("All elements 0\n");
-    DTRACE_PRINTF("%s\n%d\n",
-		  NONSENSICAL,
-		  mapInitToModbit(0));
+    printDtraceValueEnd(NONSENSICAL, 0);
     return 0;
   }
 
@@ -572,9 +735,7 @@ static char printDtraceSequence(VariableEntry* var,
 
   if (!someEltInit) {
     DPRINTF("All elements uninit\n");
-    DTRACE_PRINTF("%s\n%d\n",
-                  UNINIT,
-                  mapInitToModbit(0));
+    printDtraceValueEnd(UNINIT, 0);
     return 0;
   }
 
@@ -589,7 +750,7 @@ static char printDtraceSequence(VariableEntry* var,
         limit = min(limit, fjalar_array_length_limit);
       }
 
-      DTRACE_PRINTF( "[ ");
+      printDtraceSequenceStart(limit);
 
       for (ind = 0; ind < limit; ind++) {
         Addr pCurValue = pValueArray[ind];
@@ -608,9 +769,10 @@ static char printDtraceSequence(VariableEntry* var,
             firstInitEltFound = 1;
           }
 
-          DTRACE_PRINTF("%p ", IS_STATIC_ARRAY_VAR(var) ?
-                        (void *)pCurValueGuest :
-		                (void *)(*(Addr *)pCurValue));
+          DTRACE_PUT_PTR(IS_STATIC_ARRAY_VAR(var) ?
+                         pCurValueGuest :
+                         *(Addr *)pCurValue);
+          printDtraceEltEnd();
 
           // Merge the tags of the 4-bytes of the observed pointer as
           // well as the tags of the first initialized address and the
@@ -627,14 +789,11 @@ static char printDtraceSequence(VariableEntry* var,
           }
         }
         else {
-          // Daikon currently only supports 'nonsensical' values
-          // inside of sequences, not 'uninit' value.
-          DTRACE_PRINTF("%s ", NONSENSICAL);
+          printDtraceNonsensicalElt();
         }
       }
 
-      DTRACE_PRINTF( "]\n%d\n",
-                     mapInitToModbit(1));
+      printDtraceValueEnd("]", 1);
   }
   // String (not pointer to string)
   else if (IS_STRING(var)) {
@@ -653,15 +812,15 @@ static char printDtraceSequence(VariableEntry* var,
       limit = min(limit, fjalar_array_length_limit);
     }
 
-    DTRACE_PRINTF( "[ ");
+    printDtraceSequenceStart(limit);
 
     for (ind = 0; ind < limit; ind++) {
       Addr pCurValueGuest = pValueArray[ind];
-      DTRACE_PRINTF("%p ", (void *)pCurValueGuest);
+      DTRACE_PUT_PTR(pCurValueGuest);
+      printDtraceEltEnd();
     }
 
-    DTRACE_PRINTF( "]\n%d\n",
-                   mapInitToModbit(1));
+    printDtraceValueEnd("]", 1);
   }
   // Base type
   else {
@@ -701,9 +860,7 @@ char printDtraceSingleBaseValue(Addr pValue,
   // This check is to make sure that we don't segfault
   if (!overrideIsInit &&
       !(addressIsAllocated(pValue, DecTypeByteSizes[decType]))) {
-    DTRACE_PRINTF("%s\n%d\n",
-                  NONSENSICAL,
-                  mapInitToModbit(0));
+    printDtraceValueEnd(NONSENSICAL, 0);
     return 0;
   }
 
@@ -723,12 +880,12 @@ char printDtraceSingleBaseValue(Addr pValue,
     // Special case for .disambig:
     if (OVERRIDE_CHAR_AS_STRING == disambigOverride) {
       printOneCharAsDtraceString(*((char*)pValue));
-      DTRACE_PRINTF( "\n%d\n", mapInitToModbit(1));
+      printDtraceValueEnd("", 1);
     }
     else {
       // This is where the acutal printing of the variable is done. This
       // was a bit hard to figure out.
-      TYPES_SWITCH(DTRACE_PRINT_ONE_VAR)
+      printDtraceNumber(decType, pValue);
 
       if (kvasir_with_dyncomp) {
         DYNCOMP_TPRINTF("dtrace call val_uf_union_tags_in_range(%p, %d) (single base)\n",
@@ -736,15 +893,13 @@ char printDtraceSingleBaseValue(Addr pValue,
         val_uf_union_tags_in_range((Addr)pValue, DecTypeByteSizes[decType]);
       }
 
-      DTRACE_PRINTF( "\n%d\n", mapInitToModbit(1));
+      printDtraceValueEnd("", 1);
     }
     return 1;
   }
   // Print out "uninit" and modbit=2 for uninitialized values
   else {
-    DTRACE_PRINTF("%s\n%d\n",
-                  UNINIT,
-                  mapInitToModbit(0));
+    printDtraceValueEnd(UNINIT, 0);
     return 0;
   }
 }
@@ -791,13 +946,11 @@ void printDtraceBaseValueSequence(DeclaredType decType,
   // Don't support printing of these types:
   if ((decType == D_FUNCTION) || (decType == D_VOID)) {
     // Just punt
-    DTRACE_PRINTF("%s\n%d\n",
-                  NONSENSICAL,
-                  mapInitToModbit(0));
+    printDtraceValueEnd(NONSENSICAL, 0);
     return;
   }
 
-  DTRACE_PRINTF( "[ ");
+  printDtraceSequenceStart(limit);
 
   for (i = 0; i < limit; i++) {
     Addr pCurValue = pValueArray[i];
@@ -826,7 +979,7 @@ void printDtraceBaseValueSequence(DeclaredType decType,
         }
 
 
-        TYPES_SWITCH(DTRACE_PRINT_ONE_VAR_WITHIN_SEQUENCE)
+        printDtraceNumber(decType, pCurValue);
 
         // Merge the tags of all bytes read for this element:
         if (kvasir_with_dyncomp) {
@@ -842,18 +995,14 @@ void printDtraceBaseValueSequence(DeclaredType decType,
         val_uf_union_tags_at_addr((Addr)firstInitElt, (Addr)pCurValue);
       }
 
-      DTRACE_PRINTF(" ");
+      printDtraceEltEnd();
     }
     else {
-      // Daikon currently only supports 'nonsensical' values
-      // inside of sequences, not 'uninit' value.
-
-      DTRACE_PRINTF("%s ", NONSENSICAL);
+      printDtraceNonsensicalElt();
     }
   }
 
-  DTRACE_PRINTF("]\n%d\n",
-                mapInitToModbit(1));
+  printDtraceValueEnd("]", 1);
 
   // Set return value via pointer:
   if (pFirstInitElt) {
@@ -870,7 +1019,7 @@ void printDtraceSingleString(char* actualString,
   }
   else if (OVERRIDE_STRING_AS_ONE_INT == disambigOverride) {
     char intToPrint = actualString[0];
-    DTRACE_PRINTF( "%d", intToPrint);
+    DTRACE_PUT_INT(intToPrint);
   }
   else if (OVERRIDE_STRING_AS_INT_ARRAY == disambigOverride) {
     printOneDtraceStringAsIntArray(actualString);
@@ -879,8 +1028,7 @@ void printDtraceSingleString(char* actualString,
     printOneDtraceString(actualString);
   }
 
-  DTRACE_PRINTF("\n%d\n",
-                mapInitToModbit(1));
+  printDtraceValueEnd("", 1);
 }
 
 
@@ -918,7 +1066,7 @@ void printDtraceStringSequence(VariableEntry* var,
     limit = min(limit, fjalar_array_length_limit);
   }
 
-  DTRACE_PRINTF( "[ ");
+  printDtraceSequenceStart(limit);
 
   for (i = 0; i < limit; i++) {
     char* pCurValue = (char*)pValueArray[i];
@@ -951,28 +1099,25 @@ void printDtraceStringSequence(VariableEntry* var,
         else if ((OVERRIDE_STRING_AS_ONE_INT == disambigOverride) ||
                  (OVERRIDE_STRING_AS_INT_ARRAY == disambigOverride)) {
           char intToPrint = pCurValue[0];
-          DTRACE_PRINTF( "%d", intToPrint);
+          DTRACE_PUT_INT(intToPrint);
         }
         else {
           printOneDtraceString(pCurValue);
         }
 
-        DTRACE_PRINTF(" ");
+        printDtraceEltEnd();
       }
       else {
-        // Daikon currently only supports 'nonsensical' values
-        // inside of sequences, not 'uninit' value.
-        DTRACE_PRINTF("%s ", NONSENSICAL);
+        printDtraceNonsensicalElt();
       }
     }
     else {
       DPRINTF("Not initialized\n");
-      DTRACE_PRINTF("%s ", NONSENSICAL);
+      printDtraceNonsensicalElt();
     }
   }
 
-  DTRACE_PRINTF("]\n%d\n",
-                mapInitToModbit(1));
+  printDtraceValueEnd("]", 1);
 
   // Set return value via pointer:
   if (pFirstInitElt) {
@@ -1011,6 +1156,7 @@ TraversalResult printDtraceEntryAction(VariableEntry* var,
                                        Bool isEnter) {
   char variableHasBeenObserved = 0;
   Addr firstInitElt = 0;
+  ULong profileStart;
 
   char isHashcode = (layersBeforeBase > 0);
 
@@ -1029,12 +1175,18 @@ TraversalResult printDtraceEntryAction(VariableEntry* var,
             (void*)(*(Addr *)pValue));
 
 
+  profileStart = kvasir_profile_start();
+
   // Line 1: Variable name
     // The DTRACE_PRINTF() macro had this condition, so we should
     // follow it too ...
     if (!dyncomp_without_dtrace) {
-      printDaikonExternalVarName(var, varName, dtrace_fp);
-      fputs("\n", dtrace_fp);
+      if (kvasir_dtrace_binary) {
+        dtrace_bin_var(var, varName);
+      }
+      else {
+        dtrace_put_var_name(varName);
+      }
     }
 
   // Lines 2 & 3: Value and modbit
@@ -1062,11 +1214,14 @@ TraversalResult printDtraceEntryAction(VariableEntry* var,
                            disambigOverride);
   }
 
+  kvasir_profile_add_output(profileStart);
+
   // DynComp post-processing after observing a variable:
   if (kvasir_with_dyncomp && variableHasBeenObserved) {
     Addr a = 0;
     Addr ptrInQuestion = 0;
     char ptrAllocAndInit = 0;
+    profileStart = kvasir_profile_start();
     DPRINTF("printDtraceEntryAction %s\n", varName);
 
     // Pick the first initialized element from the sequence
@@ -1131,6 +1286,7 @@ TraversalResult printDtraceEntryAction(VariableEntry* var,
                                    g_variableIndex,
                                    a);
     }
+    kvasir_profile_add_dyncomp(profileStart);
   }
   DPRINTF("\n*********************************\n%s\n*********************************\n\n", varName);
   if (variableHasBeenObserved) {
@@ -1148,12 +1304,14 @@ TraversalResult printDtraceEntryAction(VariableEntry* var,
 void printDtraceForFunction(FunctionExecutionState* f_state, char isEnter) {
   FunctionEntry* funcPtr = 0;
   extern int g_variableIndex;
+  ULong profileStart;
 
   tl_assert(f_state);
   funcPtr = f_state->func;
   tl_assert(funcPtr);
 
   ((DaikonFunctionEntry*)funcPtr)->num_invocations++;  
+  kvasir_profile_begin_ppt((DaikonFunctionEntry*)funcPtr, isEnter);
 
   DPRINTF("* %s %s at FP=%p, lowestSP=%p, startPC=%p\n",
           (isEnter ? "ENTER" : "EXIT "),
@@ -1167,9 +1325,17 @@ void printDtraceForFunction(FunctionExecutionState* f_state, char isEnter) {
 
   func_name = f_state->func->fjalar_name;
 
-  // Print out function header
+  // Print out function header (the binary format puts everything in
+  // front of the values once they have all been seen)
   if (!dyncomp_without_dtrace) {
-    printDtraceFunctionHeader(funcPtr, isEnter);
+    profileStart = kvasir_profile_start();
+    if (kvasir_dtrace_binary) {
+      dtrace_bin_begin_ppt(funcPtr, isEnter);
+    }
+    else {
+      printDtraceFunctionHeader(funcPtr, isEnter);
+    }
+    kvasir_profile_add_output(profileStart);
   }
 
 #if 0 // debugging code
@@ -1192,6 +1358,8 @@ static int exit_count = 0;
   }
 #endif
 
+  profileStart = kvasir_profile_begin_traversal();
+
   // Print out globals:
   visitVariableGroup(GLOBAL_VAR,
                      funcPtr,
@@ -1218,6 +1386,13 @@ static int exit_count = 0;
                      &printDtraceEntryAction);
   }
 
+  kvasir_profile_end_traversal(profileStart);
+
+  profileStart = kvasir_profile_start();
+
+  if (kvasir_dtrace_binary && !dyncomp_without_dtrace) {
+    dtrace_bin_end_ppt();
+  }
 
   // For debugging only - print out a .decls entry with all
   // comparability sets calculated thus far for this program point
@@ -1225,6 +1400,7 @@ static int exit_count = 0;
   // to occur:
   if (dyncomp_print_incremental && kvasir_with_dyncomp) {
     FILE *saved_decls_fp = decls_fp;
+    dtrace_writer_drain();
     /* Though this is a declaration, send it to the .dtrace file so
        it's easier to correlate with execution. */
     decls_fp = dtrace_fp;
@@ -1234,19 +1410,26 @@ static int exit_count = 0;
     decls_fp = saved_decls_fp;
   }
 
-  // Flush the buffer so that everything for this program point gets
-  // printed to the .dtrace file (useful for observing executions of
-  // interactive programs):
-  if (dtrace_fp) {
-    fflush(dtrace_fp);
+  // Hand the record for this program point off to dtrace_fp (which is
+  // only flushed every so often, or every time with
+  // --dtrace-flush-every-ppt for observing executions of interactive
+  // programs):
+  if (!dyncomp_without_dtrace) {
+    dtrace_writer_end_ppt();
   }
 
+  kvasir_profile_add_output(profileStart);
+
   // If --dyncomp-detailed-mode is on, at this point we have collected
   // all of the leader tags of the values of all Daikon variables
-  // during a certain program point execution, so we can process them
-  // all in an O(n^2) manner to mutate bitmatrix.
+  // during a certain program point execution, so we can group them
+  // by leader to mutate bitmatrix.
   if (kvasir_with_dyncomp && dyncomp_detailed_mode) {
+    profileStart = kvasir_profile_start();
     DC_detailed_mode_process_ppt_execution((DaikonFunctionEntry *)funcPtr,
                                            isEnter);
+    kvasir_profile_add_dyncomp(profileStart);
   }
+
+  kvasir_profile_end_ppt();
 }
@@ -24,6 +24,11 @@
 
 #include "../fjalar_include.h"
 
+// What is printed for the value of an uninitialized variable and of
+// one that doesn't exist
+extern const HChar UNINIT[];
+extern const HChar NONSENSICAL[];
+
 void printDtraceForFunction(FunctionExecutionState* f_state, char isEnter);
 
 #endif
@@ -0,0 +1,340 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-sink.c:
+   A helper process which writes the .dtrace file, fed through a ring
+   buffer in shared memory (see dtrace-sink.h)
+*/
+
+#include "../my_libc.h"
+
+#include "dtrace-sink.h"
+#include "dtrace-gzip.h"
+
+#include "pub_tool_basics.h"
+#include "pub_tool_vki.h"
+#include "pub_tool_libcassert.h"
+#include "pub_tool_libcbase.h"
+#include "pub_tool_libcfile.h"
+#include "pub_tool_libcproc.h"
+#include "pub_tool_libcsignal.h"
+#include "pub_tool_mallocfree.h"
+#include "../../coregrind/pub_core_aspacemgr.h"  // needed for am_shared_mmap_file_float_valgrind
+#include "../../coregrind/pub_core_libcsignal.h"  // needed for sigfillset
+
+// The part of the ring that lives in shared memory.  head and tail
+// count all of the bytes ever written and read, so head - tail is
+// the number of bytes waiting (even after they wrap around).
+typedef struct {
+  volatile UInt head;              // Only written by Kvasir
+  volatile UInt tail;              // Only written by the helper
+  volatile UInt closed;            // Kvasir is done writing
+  volatile UInt error;             // The helper couldn't write the file
+  volatile UInt consumer_waiting;  // The helper is asleep on an empty ring
+  volatile UInt producer_waiting;  // Kvasir is asleep on a full ring
+  Int owner_pid;                   // The Kvasir process writing the file
+  UChar data[DTRACE_SINK_RING_SIZE];
+} DtraceRing;
+
+// Kvasir's end of the sink
+typedef struct {
+  DtraceRing* ring;
+  int wake_consumer_fd;  // Write end of the helper's doorbell
+  int wake_producer_fd;  // Read end of Kvasir's doorbell
+} DtraceSink;
+
+static void ring_doorbell(int fd) {
+  char c = 0;
+  VG_(write)(fd, &c, 1);
+}
+
+// Waits for a ring_doorbell() on fd, and returns False if the other
+// end of the pipe has gone away instead
+static Bool wait_doorbell(int fd) {
+  char buf[64];
+  return VG_(read)(fd, buf, sizeof(buf)) > 0;
+}
+
+// How often (in milliseconds) the helper checks that Kvasir is still
+// alive while it waits for data
+#define OWNER_CHECK_INTERVAL 1000
+
+// Like wait_doorbell(), but for the helper, which can't count on the
+// doorbell's write end going away when Kvasir dies: a child that the
+// program fork()ed (without exec()ing) holds a copy of it too.  So it
+// also gives up once the owner process is gone.
+static Bool wait_doorbell_from_owner(int fd, Int owner_pid) {
+  struct vki_pollfd pfd;
+
+  while (1) {
+    SysRes sr;
+
+    pfd.fd = fd;
+    pfd.events = VKI_POLLIN;
+    pfd.revents = 0;
+    sr = VG_(poll)(&pfd, 1, OWNER_CHECK_INTERVAL);
+    if (!sr_isError(sr) && sr_Res(sr) > 0) {
+      return wait_doorbell(fd);
+    }
+    if (VG_(kill)(owner_pid, 0) != 0) {
+      return False;
+    }
+  }
+}
+
+// The helper process.  Copies everything out of the ring into out
+// until Kvasir closes its end or the Kvasir process exits, then
+// exits.
+static void sink_main(DtraceRing* ring, FILE* out,
+                      int wake_consumer_fd, int wake_producer_fd) {
+  Bool orphaned = False;
+
+  while (1) {
+    UInt tail = ring->tail;
+    UInt closed = ring->closed;
+    UInt head;
+
+    __sync_synchronize();
+    head = ring->head;
+
+    if (head != tail) {
+      UInt offset = tail & (DTRACE_SINK_RING_SIZE - 1);
+      UInt n = MIN(head - tail, DTRACE_SINK_RING_SIZE - offset);
+
+      if (!ring->error && fwrite(ring->data + offset, n, 1, out) != 1) {
+        ring->error = 1;
+      }
+
+      __sync_synchronize();
+      ring->tail = tail + n;
+      __sync_synchronize();
+      if (__sync_lock_test_and_set(&ring->producer_waiting, 0)) {
+        ring_doorbell(wake_producer_fd);
+      }
+      continue;
+    }
+
+    if (closed || orphaned) {
+      break;
+    }
+
+    // Nothing to do, so push out what we have (for anyone watching
+    // the file) and go to sleep.  The flag has to be set before
+    // looking at the ring one last time, or we could miss a wakeup.
+    fflush(out);
+    ring->consumer_waiting = 1;
+    __sync_synchronize();
+    if (ring->head != tail || ring->closed) {
+      ring->consumer_waiting = 0;
+      continue;
+    }
+    if (!wait_doorbell_from_owner(wake_consumer_fd, ring->owner_pid)) {
+      // Kvasir went away without closing the file.  Write out
+      // whatever it managed to put in the ring.
+      orphaned = True;
+    }
+  }
+
+  if (fclose(out) != 0) {
+    ring->error = 1;
+  }
+  // Exiting closes Kvasir's doorbell, which is what sink_close()
+  // waits for
+  VG_(exit)(0);
+}
+
+static int sink_write(void* cookie, const char* buf, size_t len) {
+  DtraceSink* sink = (DtraceSink*)cookie;
+  DtraceRing* ring = sink->ring;
+  size_t left = len;
+
+  // The ring is still mapped in a child that the program fork()ed,
+  // but only the process that set up the sink may write to it
+  if (VG_(getpid)() != ring->owner_pid) {
+    return (int)len;
+  }
+
+  while (left) {
+    UInt head = ring->head;
+    UInt space = DTRACE_SINK_RING_SIZE - (head - ring->tail);
+    UInt offset, n, first;
+
+    if (ring->error) {
+      return -1;
+    }
+
+    if (space == 0) {
+      ring->producer_waiting = 1;
+      __sync_synchronize();
+      if (ring->tail == head - DTRACE_SINK_RING_SIZE &&
+          !wait_doorbell(sink->wake_producer_fd)) {
+        return -1;
+      }
+      ring->producer_waiting = 0;
+      continue;
+    }
+
+    offset = head & (DTRACE_SINK_RING_SIZE - 1);
+    n = MIN(left, space);
+    first = MIN(n, DTRACE_SINK_RING_SIZE - offset);
+    VG_(memcpy)(ring->data + offset, buf, first);
+    VG_(memcpy)(ring->data, buf + first, n - first);
+
+    __sync_synchronize();
+    ring->head = head + n;
+    __sync_synchronize();
+    if (__sync_lock_test_and_set(&ring->consumer_waiting, 0)) {
+      ring_doorbell(sink->wake_consumer_fd);
+    }
+
+    buf += n;
+    left -= n;
+  }
+
+  return (int)len;
+}
+
+// Called by fclose() before it closes wake_consumer_fd
+static int sink_close(void* cookie) {
+  DtraceSink* sink = (DtraceSink*)cookie;
+  DtraceRing* ring = sink->ring;
+  int res;
+
+  // Leave the ring (and the helper) alone in a fork()ed child
+  if (VG_(getpid)() != ring->owner_pid) {
+    VG_(close)(sink->wake_producer_fd);
+    VG_(free)(sink);
+    return 0;
+  }
+
+  __sync_synchronize();
+  ring->closed = 1;
+  __sync_synchronize();
+  ring_doorbell(sink->wake_consumer_fd);
+
+  // Wait for the helper to finish writing the file and exit
+  while (wait_doorbell(sink->wake_producer_fd))
+    ;
+  VG_(close)(sink->wake_producer_fd);
+
+  res = ring->error ? -1 : 0;
+  VG_(free)(sink);
+  return res;
+}
+
+static void close_pipe(int fds[2]) {
+  VG_(close)(fds[0]);
+  VG_(close)(fds[1]);
+}
+
+FILE* dtrace_sink_fdopen(int fd, const char* mode, int gzip_level) {
+  DtraceRing* ring;
+  DtraceSink* sink;
+  FILE* fp;
+  int to_consumer[2], to_producer[2];
+  int pid, status;
+  SysRes sr;
+
+  // A shared mapping of /dev/zero is shared anonymous memory which
+  // survives the fork
+  sr = VG_(open)("/dev/zero", VKI_O_RDWR, 0);
+  if (sr_isError(sr)) {
+    VG_(close)(fd);
+    return 0;
+  }
+  {
+    int zero_fd = sr_Res(sr);
+    sr = VG_(am_shared_mmap_file_float_valgrind)(sizeof(DtraceRing),
+                                                 VKI_PROT_READ | VKI_PROT_WRITE,
+                                                 zero_fd, 0);
+    VG_(close)(zero_fd);
+  }
+  if (sr_isError(sr)) {
+    VG_(close)(fd);
+    return 0;
+  }
+  ring = (DtraceRing*)sr_Res(sr);
+  ring->owner_pid = VG_(getpid)();
+
+  if (VG_(pipe)(to_consumer) < 0) {
+    VG_(close)(fd);
+    return 0;
+  }
+  if (VG_(pipe)(to_producer) < 0) {
+    close_pipe(to_consumer);
+    VG_(close)(fd);
+    return 0;
+  }
+
+  // Fork twice so that the helper isn't a child of the program, which
+  // might otherwise wait() for it
+  pid = VG_(fork)();
+  if (pid == 0) {
+    vki_sigset_t all;
+    FILE* out;
+    int helper_pid = VG_(fork)();
+
+    if (helper_pid != 0) {
+      if (helper_pid < 0) {
+        ring->error = 1;
+      }
+      VG_(exit)(0);
+    }
+
+    // Signals meant for the program are no business of ours, and the
+    // helper exits anyway once Kvasir does
+    VG_(sigfillset)(&all);
+    VG_(sigprocmask)(VKI_SIG_SETMASK, &all, NULL);
+
+    VG_(close)(to_consumer[1]);
+    VG_(close)(to_producer[0]);
+
+    if (gzip_level >= 0) {
+      out = dtrace_gzip_fdopen(fd, mode, gzip_level);
+    } else {
+      out = fdopen(fd, mode);
+    }
+    if (!out) {
+      ring->error = 1;
+      VG_(exit)(1);
+    }
+    sink_main(ring, out, to_consumer[0], to_producer[1]);
+  }
+
+  VG_(close)(fd);
+  VG_(close)(to_consumer[0]);
+  VG_(close)(to_producer[1]);
+  if (pid < 0) {
+    VG_(close)(to_consumer[1]);
+    VG_(close)(to_producer[0]);
+    return 0;
+  }
+  VG_(waitpid)(pid, &status, 0);
+
+  VG_(fcntl)(to_consumer[1], VKI_F_SETFD, VKI_FD_CLOEXEC);
+  VG_(fcntl)(to_producer[0], VKI_F_SETFD, VKI_FD_CLOEXEC);
+
+  sink = VG_(malloc)("dtrace-sink.c: dtrace_sink_fdopen", sizeof(*sink));
+  sink->ring = ring;
+  sink->wake_consumer_fd = to_consumer[1];
+  sink->wake_producer_fd = to_producer[0];
+
+  fp = fdopen_filtered(to_consumer[1], mode, &sink_write, &sink_close, sink);
+  if (!fp) {
+    // Closing the doorbells makes the helper exit
+    VG_(close)(to_consumer[1]);
+    VG_(close)(to_producer[0]);
+    VG_(free)(sink);
+  }
+  return fp;
+}
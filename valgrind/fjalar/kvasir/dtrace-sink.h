@@ -0,0 +1,44 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-sink.h:
+   Writing the .dtrace file from a separate process
+   (--dtrace-sink-process).
+
+   Everything written to the returned FILE is copied into a ring
+   buffer in memory shared with a helper process, which writes it
+   (compressing it first with --dtrace-gzip) to the real file.  The
+   instrumented program then only pays for the copy, and the
+   compression and file I/O happen on another core.
+
+   There is one producer (Kvasir, which only writes while holding the
+   big lock) and one consumer, so the ring needs no locks: each side
+   only ever advances its own index.  A side that finds the ring
+   empty (or full) sleeps on a pipe until the other side wakes it.
+*/
+
+#ifndef DTRACE_SINK_H
+#define DTRACE_SINK_H
+
+#include "../my_libc.h"
+
+// Must be a power of two
+#define DTRACE_SINK_RING_SIZE (4 << 20)
+
+// Returns a FILE* whose output is written to fd by a helper process,
+// or 0 on failure.  If gzip_level is between 0 and 9, the helper
+// compresses the output as --dtrace-gzip does.  fd is closed in
+// Kvasir either way.
+FILE* dtrace_sink_fdopen(int fd, const char* mode, int gzip_level);
+
+#endif
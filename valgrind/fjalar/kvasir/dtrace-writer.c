@@ -0,0 +1,224 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-writer.c:
+   Buffering and number formatting for the .dtrace file
+   (see dtrace-writer.h)
+*/
+
+#include "../my_libc.h"
+
+#include "dtrace-writer.h"
+#include "dtrace-binary.h"
+#include "decls-output.h"
+#include "kvasir_main.h"
+#include "../GenericHashtable.h"
+
+#include "pub_tool_libcproc.h"
+
+char* dtrace_buf = 0;
+UInt dtrace_buf_used = 0;
+ULong dtrace_bytes_written = 0;
+
+// Program points written since the clock was last checked, and the
+// time of the last flush of dtrace_fp
+static UInt ppts_since_flush_check = 0;
+static UInt last_flush_ms = 0;
+
+// Maps a variable name given by Fjalar to its Daikon external name
+// (see makeDaikonExternalVarName()), followed by a newline, so that
+// each name only gets converted once.
+// Key: Fjalar name (char*, owned by the table)
+// Value: Daikon external name + "\n" (char*)
+static struct genhashtable* dtrace_var_name_cache = 0;
+
+static const char DIGIT_PAIRS[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+void dtrace_writer_init(void) {
+  if (!dtrace_buf) {
+    dtrace_buf = VG_(malloc)("dtrace-writer.c: dtrace_writer_init", DTRACE_BUF_SIZE);
+  }
+  dtrace_buf_used = 0;
+
+  if (!dtrace_var_name_cache) {
+    dtrace_var_name_cache =
+      genallocatehashtable((unsigned int (*)(void *)) &hashString,
+                           (int (*)(void *,void *)) &equivalentStrings);
+  }
+
+  last_flush_ms = VG_(read_millisecond_timer)();
+
+  if (kvasir_dtrace_binary) {
+    dtrace_bin_init();
+  }
+}
+
+// Hands everything in the buffer off to dtrace_fp
+void dtrace_writer_drain(void) {
+  if (dtrace_buf_used && dtrace_fp) {
+    fwrite(dtrace_buf, dtrace_buf_used, 1, dtrace_fp);
+    dtrace_bytes_written += dtrace_buf_used;
+  }
+  dtrace_buf_used = 0;
+}
+
+// Called after the record for each program point has been written
+void dtrace_writer_end_ppt(void) {
+  dtrace_writer_drain();
+
+  if (!dtrace_fp) {
+    return;
+  }
+
+  if (kvasir_dtrace_flush_every_ppt) {
+    fflush(dtrace_fp);
+  }
+  // Reading the clock is a system call, so don't do it every time
+  else if (++ppts_since_flush_check >= DTRACE_FLUSH_CHECK_PPTS) {
+    UInt now = VG_(read_millisecond_timer)();
+    ppts_since_flush_check = 0;
+    if (now - last_flush_ms >= DTRACE_FLUSH_INTERVAL_MS) {
+      fflush(dtrace_fp);
+      last_flush_ms = now;
+    }
+  }
+}
+
+void dtrace_writer_finish(void) {
+  dtrace_writer_drain();
+  if (dtrace_fp) {
+    fflush(dtrace_fp);
+  }
+}
+
+// Writes the decimal digits of n so that they end just before end,
+// and returns a pointer to the first one
+static char* format_decimal(char* end, ULong n) {
+  while (n >= 100) {
+    UInt pair = (UInt)(n % 100) * 2;
+    n /= 100;
+    *--end = DIGIT_PAIRS[pair + 1];
+    *--end = DIGIT_PAIRS[pair];
+  }
+  if (n >= 10) {
+    UInt pair = (UInt)n * 2;
+    *--end = DIGIT_PAIRS[pair + 1];
+    *--end = DIGIT_PAIRS[pair];
+  }
+  else {
+    *--end = '0' + (char)n;
+  }
+  return end;
+}
+
+void dtrace_put_uint(ULong n) {
+  char buf[24];
+  char* start = format_decimal(buf + sizeof(buf), n);
+  dtrace_put_mem(start, buf + sizeof(buf) - start);
+}
+
+void dtrace_put_int(Long n) {
+  char buf[24];
+  char* start;
+  if (n < 0) {
+    start = format_decimal(buf + sizeof(buf), -(ULong)n);
+    *--start = '-';
+  }
+  else {
+    start = format_decimal(buf + sizeof(buf), (ULong)n);
+  }
+  dtrace_put_mem(start, buf + sizeof(buf) - start);
+}
+
+// Same output as "%p"
+void dtrace_put_ptr(Addr a) {
+  char buf[24];
+  char* start = buf + sizeof(buf);
+  do {
+    *--start = "0123456789abcdef"[a & 0xf];
+    a >>= 4;
+  } while (a);
+  *--start = 'x';
+  *--start = '0';
+  dtrace_put_mem(start, buf + sizeof(buf) - start);
+}
+
+// Like "%.<precision>g", but with the rounding of fptostr()
+void dtrace_put_double(double d, int precision) {
+  char buf[64];
+  fptostr(d, 1, precision, 'g', buf, sizeof(buf) - 1);
+  dtrace_put_str(buf);
+}
+
+// Writes the Daikon external name of a variable followed by a newline
+void dtrace_put_var_name(const HChar* fjalarName) {
+  HChar* name = (HChar*)gengettable(dtrace_var_name_cache, (void*)fjalarName);
+
+  if (!name) {
+    HChar* externalName = makeDaikonExternalVarName(fjalarName);
+    Int len = VG_(strlen)(externalName);
+    name = VG_(malloc)("dtrace-writer.c: dtrace_put_var_name", len + 2);
+    VG_(memcpy)(name, externalName, len);
+    name[len] = '\n';
+    name[len + 1] = '\0';
+    VG_(free)(externalName);
+    genputtable(dtrace_var_name_cache,
+                (void*)VG_(strdup)("dtrace-writer.c: dtrace_put_var_name", fjalarName),
+                (void*)name);
+  }
+
+  dtrace_put_str(name);
+}
+
+// For the odd cases that don't have a formatter of their own
+void dtrace_printf(const char* format, ...) {
+  va_list ap;
+  UInt space;
+  int len;
+
+  if (DTRACE_BUF_SIZE - dtrace_buf_used < 256) {
+    dtrace_writer_drain();
+  }
+
+  space = DTRACE_BUF_SIZE - dtrace_buf_used;
+  va_start(ap, format);
+  len = vsnprintf(dtrace_buf + dtrace_buf_used, space, format, ap);
+  va_end(ap);
+
+  if (len < 0) {
+    return;
+  }
+  else if ((UInt)len < space) {
+    dtrace_buf_used += len;
+  }
+  // It didn't fit, so send it straight to dtrace_fp
+  else {
+    dtrace_writer_drain();
+    va_start(ap, format);
+    len = vfprintf(dtrace_fp, format, ap);
+    va_end(ap);
+    if (len > 0) {
+      dtrace_bytes_written += len;
+    }
+  }
+}
@@ -0,0 +1,81 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dtrace-writer.h:
+   The output engine behind dtrace-output.c.  Program point records
+   are formatted straight into a large buffer (without going through
+   printf) which is handed off to dtrace_fp at the end of every
+   program point.  dtrace_fp itself is only flushed when its buffer
+   fills up, when DTRACE_FLUSH_INTERVAL_MS has passed since the last
+   flush, or after every program point if --dtrace-flush-every-ppt is
+   on.
+*/
+
+#ifndef DTRACE_WRITER_H
+#define DTRACE_WRITER_H
+
+#include "../my_libc.h"
+#include "pub_tool_basics.h"
+#include "pub_tool_libcbase.h"
+#include "kvasir_main.h"
+
+#define DTRACE_BUF_SIZE (1 << 20)
+
+// How often (in program points) to check the clock, and how long (in
+// milliseconds) to let output sit in dtrace_fp before flushing it
+#define DTRACE_FLUSH_CHECK_PPTS 1024
+#define DTRACE_FLUSH_INTERVAL_MS 1000
+
+extern char* dtrace_buf;
+extern UInt dtrace_buf_used;
+// How many bytes have been handed off to dtrace_fp so far
+extern ULong dtrace_bytes_written;
+
+void dtrace_writer_init(void);
+void dtrace_writer_drain(void);
+void dtrace_writer_end_ppt(void);
+void dtrace_writer_finish(void);
+
+void dtrace_put_int(Long n);
+void dtrace_put_uint(ULong n);
+void dtrace_put_ptr(Addr a);
+void dtrace_put_double(double d, int precision);
+void dtrace_put_var_name(const HChar* fjalarName);
+void dtrace_printf(const char* format, ...) __attribute__((__format__(__printf__,1,2)));
+
+// Appends len bytes to the buffer, draining it first if they won't fit
+static __inline__ void dtrace_put_mem(const char* s, UInt len) {
+  if (dtrace_buf_used + len > DTRACE_BUF_SIZE) {
+    dtrace_writer_drain();
+    if (len > DTRACE_BUF_SIZE) {
+      fwrite(s, len, 1, dtrace_fp);
+      dtrace_bytes_written += len;
+      return;
+    }
+  }
+  VG_(memcpy)(dtrace_buf + dtrace_buf_used, s, len);
+  dtrace_buf_used += len;
+}
+
+static __inline__ void dtrace_put_str(const char* s) {
+  dtrace_put_mem(s, VG_(strlen)(s));
+}
+
+static __inline__ void dtrace_put_char(char c) {
+  if (dtrace_buf_used == DTRACE_BUF_SIZE) {
+    dtrace_writer_drain();
+  }
+  dtrace_buf[dtrace_buf_used++] = c;
+}
+
+#endif
@@ -65,7 +65,8 @@
 // Special reserved tags
 #define MY_UINT_MAX 0xffffffffU
 const UInt WEAK_FRESH_TAG   =  MY_UINT_MAX;
-const UInt LARGEST_REAL_TAG = (MY_UINT_MAX - 1);
+const UInt LAZY_FRESH_TAG   = (MY_UINT_MAX - 1);
+const UInt LARGEST_REAL_TAG = (MY_UINT_MAX - 2);
 
 int print_merge = 1;
 
@@ -83,6 +84,11 @@ int print_merge = 1;
    every instance of 0 turns into a fresh variable comparability type
    at the end. It's used for the result of comparisons, function
    return pointers, and the GOT table pointer, among other things. */
+/* LAZY_FRESH_TAG only ever appears in shadow memory, never in
+   registers or temporaries. It stands for "a unique tag that hasn't
+   been created yet": allocate_new_unique_tags() fills freshly
+   allocated memory with it, and get_tag() replaces it with a real
+   fresh tag the first time each byte is read. */
 
 // For debug printouts
 //extern char within_main_program;
@@ -106,49 +112,448 @@ UInt totalNumTagsAssigned = 0;
 /* The two-level tag map works almost like the memory map.  Its
    purpose is to implement a sparse array which can hold up to 2^32
    UInts.  The primary map holds 2^16 references to secondary maps.
-   Each secondary map holds 2^16 UInt entries, each of which is 4
-   bytes total.  Thus, each secondary map takes up 262,144 bytes.
-   Each byte of memory should be shadowed with a corresponding tag.  A
-   tag value of 0 means that there is NO tag associated with the byte.
+   Each secondary map covers 2^16 bytes of memory, and is split into
+   pages which are each stored in a uniform, per-word, or dense
+   (per-byte) form (see TagSecondary in dyncomp_main.h), so a
+   secondary only takes up as much space as the granularity at which
+   its memory has actually been tagged requires.  Each byte of memory
+   should be shadowed with a corresponding tag.  A tag value of 0
+   means that there is NO tag associated with the byte.
 */
-UInt* primary_tag_map[PRIMARY_SIZE];
+TagSecondary* primary_tag_map[PRIMARY_SIZE];
 
 // The number of entries in primary_tag_map that are initialized
 // Range is [0, PRIMARY_SIZE]
 UInt n_primary_tag_map_init_entries = 0;
 
+#if VG_WORDSIZE == 8
+HighTagMapEntry* high_tag_map = NULL;
+UInt high_tag_map_size = 0;
+
+// The number of slots in high_tag_map that are in use
+static UInt high_tag_map_used = 0;
+
+// The result of the last high_tag_map lookup, since consecutive
+// accesses almost always fall in the same secondary
+static Addr last_high_tag_base = 1; // Never a valid base
+static TagSecondary* last_high_tag_sec = NULL;
+
+#define HIGH_TAG_MAP_INIT_SIZE 64
+
+static __inline__ UInt high_tag_map_hash(Addr base) {
+  return (UInt)((PM_IDX(base) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+// Returns the slot in high_tag_map which holds base, or the free slot
+// where it should be inserted
+static HighTagMapEntry* high_tag_map_slot(Addr base) {
+  UInt mask = high_tag_map_size - 1;
+  UInt i = high_tag_map_hash(base) & mask;
+
+  while (high_tag_map[i].sec && (high_tag_map[i].base != base)) {
+    i = (i + 1) & mask;
+  }
+  return &high_tag_map[i];
+}
+
+TagSecondary* find_high_tag_secondary(Addr a) {
+  Addr base = a & ~((Addr)SECONDARY_MASK);
+
+  if (base != last_high_tag_base) {
+    last_high_tag_base = base;
+    last_high_tag_sec =
+      high_tag_map ? high_tag_map_slot(base)->sec : NULL;
+  }
+  return last_high_tag_sec;
+}
+
+static void insert_high_tag_secondary(Addr base, TagSecondary* sec) {
+  // Keep the load factor under 1/2
+  if (2 * (high_tag_map_used + 1) > high_tag_map_size) {
+    HighTagMapEntry* old_map = high_tag_map;
+    UInt old_size = high_tag_map_size;
+    UInt i;
+
+    high_tag_map_size = old_size ? 2 * old_size : HIGH_TAG_MAP_INIT_SIZE;
+    high_tag_map = VG_(calloc)("dyncomp_main.c: insert_high_tag_secondary",
+                               high_tag_map_size, sizeof(*high_tag_map));
+    for (i = 0; i < old_size; i++) {
+      if (old_map[i].sec) {
+        *high_tag_map_slot(old_map[i].base) = old_map[i];
+      }
+    }
+    if (old_map) {
+      VG_(free)(old_map);
+    }
+  }
+
+  {
+    HighTagMapEntry* slot = high_tag_map_slot(base);
+    tl_assert(!slot->sec);
+    slot->base = base;
+    slot->sec = sec;
+  }
+  high_tag_map_used++;
+
+  last_high_tag_base = base;
+  last_high_tag_sec = sec;
+}
+#endif
+
+// The number of tag pages currently held in the dense and per-word
+// forms (all others are uniform)
+UInt n_dense_tag_pages = 0;
+UInt n_word_tag_pages = 0;
+
+// Written to (and read from) by the inline tag IR when it doesn't
+// apply; the contents are never used.
+UInt dc_tag_sink[8];
+
 UInt val_uf_tag_union(UInt tag1, UInt tag2);
 
-// Copies tags of len bytes from src to dst
+// Allocate the (all uniform 0) secondary tag map covering address a
+TagSecondary* new_tag_secondary(Addr a) {
+  TagSecondary* sec =
+    VG_(calloc)("dyncomp_main.c: new_tag_secondary", 1, sizeof(*sec));
+
+#if VG_WORDSIZE == 8
+  if (PM_IDX(a) >= PRIMARY_SIZE) {
+    insert_high_tag_secondary(a & ~((Addr)SECONDARY_MASK), sec);
+    return sec;
+  }
+#endif
+
+  primary_tag_map[PM_IDX(a)] = sec;
+  n_primary_tag_map_init_entries++;
+  return sec;
+}
+
+static __inline__ void fill_tags(UInt* tags, SizeT n, UInt tag) {
+  SizeT i;
+  if (IS_ZERO_TAG(tag)) {
+    VG_(memset)(tags, 0, n * sizeof(*tags));
+    return;
+  }
+  for (i = 0; i < n; i++) {
+    tags[i] = tag;
+  }
+}
+
+// Convert page p of sec (currently uniform or per-word) to the
+// dense form and return its per-byte tags
+static UInt* densify_tag_page(TagSecondary* sec, UInt p) {
+  UInt* dense = VG_(malloc)("dyncomp_main.c: densify_tag_page",
+                            TAG_PAGE_SIZE * sizeof(*dense));
+  tl_assert(!sec->dense[p]);
+
+  if (sec->words[p]) {
+    UInt i;
+    for (i = 0; i < TAG_PAGE_SIZE; i++) {
+      dense[i] = sec->words[p][i >> TAG_WORD_SHIFT];
+    }
+    VG_(free)(sec->words[p]);
+    sec->words[p] = NULL;
+    n_word_tag_pages--;
+  }
+  else {
+    fill_tags(dense, TAG_PAGE_SIZE, sec->uniform[p]);
+  }
+
+  sec->dense[p] = dense;
+  n_dense_tag_pages++;
+  return dense;
+}
+
+// Convert page p of sec (currently uniform) to the per-word form and
+// return its per-word tags
+static UInt* wordify_tag_page(TagSecondary* sec, UInt p) {
+  UInt* words = VG_(malloc)("dyncomp_main.c: wordify_tag_page",
+                            TAG_WORDS_PER_PAGE * sizeof(*words));
+  tl_assert(!sec->dense[p] && !sec->words[p]);
+
+  fill_tags(words, TAG_WORDS_PER_PAGE, sec->uniform[p]);
+  sec->words[p] = words;
+  n_word_tag_pages++;
+  return words;
+}
+
+// Throw away any detailed form of page p of sec and give all of its
+// bytes the tag 'tag'
+static void make_tag_page_uniform(TagSecondary* sec, UInt p, UInt tag) {
+  if (sec->dense[p]) {
+    VG_(free)(sec->dense[p]);
+    sec->dense[p] = NULL;
+    n_dense_tag_pages--;
+  }
+  if (sec->words[p]) {
+    VG_(free)(sec->words[p]);
+    sec->words[p] = NULL;
+    n_word_tag_pages--;
+  }
+  sec->uniform[p] = tag;
+}
+
+// The slow path of set_tag(), for when a's page is not dense
+void set_tag_in_coarse_page(TagSecondary* sec, Addr a, UInt tag) {
+  UInt p = TAG_PAGE_IDX(a);
+  UInt off = TAG_PAGE_OFF(a);
+
+  if (get_tag_in_page(sec, p, off) == tag) {
+    return;
+  }
+  densify_tag_page(sec, p)[off] = tag;
+}
+
+// Set the tags of the n bytes starting at offset off of page p of
+// sec, using the coarsest form that can hold the result
+static void set_tags_in_page(TagSecondary* sec, UInt p,
+                             UInt off, SizeT n, UInt tag) {
+  if (n == TAG_PAGE_SIZE) {
+    make_tag_page_uniform(sec, p, tag);
+  }
+  else if (sec->dense[p]) {
+    fill_tags(sec->dense[p] + off, n, tag);
+  }
+  else if (((off | n) & (TAG_WORD_SIZE - 1)) == 0) {
+    // Whole words, so we don't need to go dense
+    if (!sec->words[p]) {
+      if (sec->uniform[p] == tag) {
+        return;
+      }
+      wordify_tag_page(sec, p);
+    }
+    fill_tags(sec->words[p] + (off >> TAG_WORD_SHIFT),
+              n >> TAG_WORD_SHIFT, tag);
+  }
+  else {
+    if (!sec->words[p] && (sec->uniform[p] == tag)) {
+      return;
+    }
+    fill_tags(densify_tag_page(sec, p) + off, n, tag);
+  }
+}
+
+// Set the tags of all bytes in the range [a, a+len) to 'tag'
+void set_tag_range(Addr a, SizeT len, UInt tag) {
+  Addr curAddr = a;
+  Addr end = a + len;
+
+#ifndef MAX_DEBUG_INFO
+  if (dyncomp_print_trace_all)
+#endif
+  {
+    // Go byte-by-byte so that every set_tag gets traced
+    for (curAddr = a; curAddr < end; curAddr++) {
+      set_tag(curAddr, tag);
+    }
+    return;
+  }
+
+  while (curAddr < end) {
+    TagSecondary* sec;
+    SizeT n;
+
+    sec = get_tag_secondary(curAddr);
+    if (!sec) {
+      if (IS_ZERO_TAG(tag)) {
+        // Nothing to clear in the rest of this secondary
+        n = SECONDARY_SIZE - SM_OFF(curAddr);
+        if (n > end - curAddr) {
+          n = end - curAddr;
+        }
+        curAddr += n;
+        continue;
+      }
+      sec = new_tag_secondary(curAddr);
+    }
+
+    n = TAG_PAGE_SIZE - TAG_PAGE_OFF(curAddr);
+    if (n > end - curAddr) {
+      n = end - curAddr;
+    }
+    set_tags_in_page(sec, TAG_PAGE_IDX(curAddr), TAG_PAGE_OFF(curAddr),
+                     n, tag);
+    curAddr += n;
+  }
+}
+
+// Move page p of sec to the coarsest form that can hold its current
+// tags (called by the garbage collector after renumbering tags)
+void compact_tag_page(TagSecondary* sec, UInt p) {
+  UInt i;
+
+  if (sec->dense[p]) {
+    UInt* dense = sec->dense[p];
+    Bool uniform = True;
+    Bool per_word = True;
+
+    for (i = 1; i < TAG_PAGE_SIZE; i++) {
+      if (dense[i] != dense[0]) {
+        uniform = False;
+        break;
+      }
+    }
+    if (uniform) {
+      make_tag_page_uniform(sec, p, dense[0]);
+      return;
+    }
+
+    for (i = 0; i < TAG_PAGE_SIZE; i++) {
+      if (dense[i] != dense[i & ~(TAG_WORD_SIZE - 1)]) {
+        per_word = False;
+        break;
+      }
+    }
+    if (per_word) {
+      UInt* words = VG_(malloc)("dyncomp_main.c: compact_tag_page",
+                                TAG_WORDS_PER_PAGE * sizeof(*words));
+      for (i = 0; i < TAG_WORDS_PER_PAGE; i++) {
+        words[i] = dense[i << TAG_WORD_SHIFT];
+      }
+      VG_(free)(dense);
+      sec->dense[p] = NULL;
+      n_dense_tag_pages--;
+      sec->words[p] = words;
+      n_word_tag_pages++;
+    }
+  }
+  else if (sec->words[p]) {
+    UInt* words = sec->words[p];
+    for (i = 1; i < TAG_WORDS_PER_PAGE; i++) {
+      if (words[i] != words[0]) {
+        return;
+      }
+    }
+    make_tag_page_uniform(sec, p, words[0]);
+  }
+}
+
+// Returns the length of the run of equal tags at the start of
+// tags[0, limit) (limit > 0)
+static __inline__ SizeT dense_tag_run_length(const UInt* tags, SizeT limit) {
+  UInt tag = tags[0];
+  SizeT n = 1;
+
+  // Check 4 tags per test (without branching on each one), which
+  // the compiler can turn into a single vector compare
+  while ((n + 4 <= limit) &&
+         (((tags[n] ^ tag) | (tags[n + 1] ^ tag) |
+           (tags[n + 2] ^ tag) | (tags[n + 3] ^ tag)) == 0)) {
+    n += 4;
+  }
+  while ((n < limit) && (tags[n] == tag)) {
+    n++;
+  }
+  return n;
+}
+
+// Returns the length of the run of bytes starting at a (and ending no
+// later than end) which all hold the same tag, as is (see peek_tag()),
+// and puts that tag in *tag.  A run never crosses a page, except that
+// the rest of a missing secondary is a single run of 0 tags.
+static SizeT get_tag_run(Addr a, Addr end, UInt* tag) {
+  TagSecondary* sec = get_tag_secondary(a);
+  UInt p, off;
+  SizeT limit;
+
+  if (!sec) {
+    limit = SECONDARY_SIZE - SM_OFF(a);
+    *tag = 0;
+    return (limit < end - a) ? limit : (end - a);
+  }
+
+  p = TAG_PAGE_IDX(a);
+  off = TAG_PAGE_OFF(a);
+  limit = TAG_PAGE_SIZE - off;
+  if (limit > end - a) {
+    limit = end - a;
+  }
+
+  if (sec->dense[p]) {
+    *tag = sec->dense[p][off];
+    return dense_tag_run_length(sec->dense[p] + off, limit);
+  }
+  else if (sec->words[p]) {
+    UInt* words = sec->words[p];
+    UInt w = off >> TAG_WORD_SHIFT;
+    SizeT n = TAG_WORD_SIZE - (off & (TAG_WORD_SIZE - 1));
+
+    *tag = words[w];
+    for (w++; (n < limit) && (words[w] == *tag); w++) {
+      n += TAG_WORD_SIZE;
+    }
+    return (n < limit) ? n : limit;
+  }
+
+  *tag = sec->uniform[p];
+  return limit;
+}
+
+// copy_tags() for ranges where writing the tags of dst never changes
+// a byte of src that hasn't been copied yet
+static void copy_tags_forward( Addr src, Addr dst, SizeT len ) {
+  Addr end = src + len;
+
+  while (src < end) {
+    UInt tag;
+    SizeT n = get_tag_run(src, end, &tag);
+
+    if (UNLIKELY(tag == LAZY_FRESH_TAG)) {
+      // Every one of these bytes gets its own fresh tag
+      SizeT i;
+      for (i = 0; i < n; i++) {
+        UInt fresh = get_tag(src + i);
+        set_tag(dst + i, fresh);
+      }
+    }
+    else {
+      // One leader lookup for the whole run
+      UInt leader = val_uf_find_leader(tag);
+      if (leader != tag) {
+        set_tag_range(src, n, leader);
+      }
+      set_tag_range(dst, n, leader);
+    }
+    src += n;
+    dst += n;
+  }
+}
+
+// Copies tags of len bytes from src to dst (the ranges may overlap,
+// as with memmove)
 // Set both the tags of 'src' and 'dst' to their
 // respective leaders for every byte
 void copy_tags(  Addr src, Addr dst, SizeT len ) {
-  SizeT i;
-  for (i = 0; i < len; i++) {
-    UInt leader = val_uf_find_leader(get_tag(src + i));
-    set_tag (src + i, leader);
-    set_tag (dst + i, leader);
+  if ((dst > src) && (dst - src < len)) {
+    // Go backwards, a block of (dst - src) bytes at a time, so that
+    // the tags of src are all read before dst overwrites them
+    SizeT step = dst - src;
+    while (len > step) {
+      len -= step;
+      copy_tags_forward(src + len, dst + len, step);
+    }
   }
+  copy_tags_forward(src, dst, len);
 }
 
 
-/* The two-level value uf_object map works almost like the memory map.
+/* The two-level value union-find map works almost like the memory map.
    Its purpose is to implement a sparse array which can hold
-   up to 2^32 uf_object entries.  The primary map holds 2^16
-   references to secondary maps.  Each secondary map holds 2^16
-   uf_object entries, each of which is 12 bytes total.  Thus,
-   each secondary map takes up 786,432 bytes.
+   up to 2^32 union-find entries.  The primary map holds references
+   to secondary maps, each of which holds SECONDARY_SIZE entries of
+   5 bytes apiece (a 32-bit parent tag plus a 1-byte rank; see
+   ValUFSecondary in dyncomp_main.h).
    The main difference between this sparse array structure and
    the tag map is that this one fills up sequentially from
    lower indices to higher indices because tags are assigned
    (more or less) sequentially using nextTag and tag serial
-   numbers are used as indices into the uf_object map
+   numbers are used as indices into the union-find map
 */
 
-// val_uf_object_map: A map from tag (32-bit int) to uf_objects
+// val_uf_object_map: A map from tag (32-bit int) to its union-find entry
 // Each entry either points to NULL or to a dynamically-allocated
-// array (of size SECONDARY_SIZE) of uf_object objects
-uf_object* primary_val_uf_object_map[PRIMARY_SIZE];
+// ValUFSecondary
+ValUFSecondary* primary_val_uf_object_map[PRIMARY_SIZE];
 
 // The number of entries that are initialized in primary_val_uf_object_map
 // Range is [0, PRIMARY_SIZE]
@@ -159,71 +564,73 @@ void val_uf_make_set_for_tag(UInt tag) {
     return;
 
   if (IS_SECONDARY_UF_NULL(tag)) {
-    uf_object* new_uf_obj_array =
-      (uf_object*)VG_(am_shadow_alloc)(SECONDARY_SIZE * sizeof(*new_uf_obj_array));
-
-    // PG - We can skip this step and leave them uninitialized
-    //      until somebody explicitly calls val_uf_make_set_for_tag() on
-    //      that particular tag
-
-    // Each new uf_object should be initialized using uf_make_set()
-    //    UInt i;
-    //    UInt curTag; // Set to upper 16-bits of the tag
-    //    for (i = 0, curTag = ((PM_IDX(tag)) << SECONDARY_SHIFT);
-    //         i < SECONDARY_SIZE;
-    //         i++, curTag++) {
-    //      uf_make_set(new_uf_obj_array + i, curTag);
-    //      //      printf("      uf_make_set(%u, %u);\n",
-    //      //                  new_uf_obj_array + i, curTag);
-    //    }
-    primary_val_uf_object_map[PM_IDX(tag)] = new_uf_obj_array;
+    // The entries are left uninitialized until somebody explicitly
+    // calls val_uf_make_set_for_tag() on that particular tag
+    primary_val_uf_object_map[PM_IDX(tag)] =
+      (ValUFSecondary*)VG_(am_shadow_alloc)(sizeof(ValUFSecondary));
     n_primary_val_uf_object_map_init_entries++;
-
   }
 
-  // Do this unconditionally now:
-  uf_make_set(GET_UF_OBJECT_PTR(tag), tag);
+  DYNCOMP_TPRINTF("[DynComp] val_uf_make_set_for_tag: %u\n", tag);
+  VAL_UF_PARENT(tag) = tag;
+  VAL_UF_RANK(tag) = 0;
+}
+
+// Describes the guest instruction being executed, for traces.  (This
+// looks up debug. info., so only call it when a trace is actually
+// going to be printed.)
+static const HChar* current_IP_description(void) {
+  return VG_(describe_IP)(VG_(get_IP)(VG_(get_running_tid)()), NULL);
 }
 
 // Merge the sets of tag1 and tag2 and return the leader
 UInt val_uf_tag_union(UInt tag1, UInt tag2) {
   if (!IS_ZERO_TAG(tag1) && !IS_SECONDARY_UF_NULL(tag1) &&
       !IS_ZERO_TAG(tag2) && !IS_SECONDARY_UF_NULL(tag2)) {
-    Addr eip = VG_(get_IP)(VG_(get_running_tid)());
-    const HChar *eip_info;
-    uf_object* tag1_obj, *tag2_obj;
-    uf_object* leader;
-    tag1_obj = GET_UF_OBJECT_PTR(tag1);
-    tag2_obj = GET_UF_OBJECT_PTR(tag2);
-    leader = uf_union(tag1_obj, tag2_obj);
-    eip_info = VG_(describe_IP)(eip, NULL);
+    UInt leader1 = val_uf_tag_find(tag1);
+    UInt leader2 = val_uf_tag_find(tag2);
+    UInt leader;
+
+    // Union-by-rank
+    if (leader1 == leader2) {
+      leader = leader1;
+    } else if (VAL_UF_RANK(leader1) < VAL_UF_RANK(leader2)) {
+      VAL_UF_PARENT(leader1) = leader2;
+      leader = leader2;
+    } else {
+      VAL_UF_PARENT(leader2) = leader1;
+      if (VAL_UF_RANK(leader1) == VAL_UF_RANK(leader2)) {
+        VAL_UF_RANK(leader1)++;
+      }
+      leader = leader1;
+    }
 
     DYNCOMP_TPRINTF("[DynComp-v1] Merging %u with %u to get %u at %s\n",
-                    tag1, tag2, leader->tag, eip_info);
+                    tag1, tag2, leader, current_IP_description());
 
-    return leader->tag;
+    return leader;
   }
   else {
     return 0;
   }
 }
 
+// Give the byte at a (which holds LAZY_FRESH_TAG) the real unique
+// tag that allocate_new_unique_tags() promised it
+UInt materialize_lazy_tag(Addr a) {
+  UInt tag = grab_fresh_tag();
+  set_tag(a, tag);
+  return tag;
+}
+
 // Write tag into all addresses in the range [a, a+len)
 static __inline__ void set_tag_for_range(Addr a, SizeT len, UInt tag) {
-  Addr curAddr;
-  UInt leader = val_uf_find_leader(tag);
-
-  for (curAddr = a; curAddr < (a+len); curAddr++) {
-    set_tag(curAddr, leader);
-  }
+  set_tag_range(a, len, val_uf_find_leader(tag));
 }
 
 // Write the special GOT tag into all addresses in the range [a, a+len)
 void set_tag_for_GOT(Addr a, SizeT len) {
-  Addr curAddr;
-  for (curAddr = a; curAddr < (a+len); curAddr++) {
-    set_tag(curAddr, WEAK_FRESH_TAG);
-  }
+  set_tag_range(a, len, WEAK_FRESH_TAG);
 }
 
 // Helper functions called from dyncomp_translate.c:
@@ -346,6 +753,9 @@ UInt val_uf_union_tags_in_range(Addr a, SizeT len) {
   UInt canonicalTag = 0;
   UInt tagToMerge = 0;
   UInt curTag;
+  UInt lastTag = 0;
+  SizeT runLen;
+  Bool sawLazyTag = False;
   print_merge = 0;
 
   // If dyncomp_approximate_literals is on, then if all of the tags
@@ -370,17 +780,31 @@ UInt val_uf_union_tags_in_range(Addr a, SizeT len) {
 /*     } */
 /*   } */
 
-  // Scan the range for the first non-zero tag and use
-  // that as the basis for all the mergings:
-  // (Hopefully this should only take one iteration
-  //  because the tag of address 'a' should be non-zero)
-  for (curAddr = a; curAddr < (a + len); curAddr++) {
-    curTag = get_tag(curAddr);
-    if (curTag) {
-DYNCOMP_TPRINTF("MLR debug val_uf_union_tags_in_range addr=%p, tag=%u\n", (void *)curAddr, curTag);
+  // Go through the range a run of equal tags at a time, using the
+  // first non-zero tag as the basis for all the mergings.
+  // Bytes holding LAZY_FRESH_TAG would each get a brand new tag
+  // which is then merged right into this set, so just skip them (and
+  // make one fresh tag for the whole range if there is nothing else).
+  for (curAddr = a; curAddr < (a + len); curAddr += runLen) {
+    runLen = get_tag_run(curAddr, a + len, &curTag);
+    if (curTag == LAZY_FRESH_TAG) {
+      sawLazyTag = True;
+    }
+    else if (0 == curTag || curTag == lastTag) {
+      continue;
+    }
+    else if (0 == tagToMerge) {
+      DYNCOMP_TPRINTF("MLR debug val_uf_union_tags_in_range addr=%p, tag=%u\n", (void *)curAddr, curTag);
       tagToMerge = curTag;
-      break;
     }
+    else if (curTag != tagToMerge) {
+      val_uf_tag_union(tagToMerge, curTag);
+    }
+    lastTag = curTag;
+  }
+
+  if ((0 == tagToMerge) && sawLazyTag) {
+    tagToMerge = grab_fresh_tag();
   }
 
   // If they are all zeroes, then we're done;
@@ -389,14 +813,8 @@ DYNCOMP_TPRINTF("MLR debug val_uf_union_tags_in_range addr=%p, tag=%u\n", (void
     print_merge = 1;
     return 0;
   }
-  // Otherwise, merge all the stuff and set them to canonical:
+  // Otherwise, everything has been merged, so set them to canonical:
   else {
-    for (curAddr = a; curAddr < (a + len); curAddr++) {
-      curTag = get_tag(curAddr);
-      if (tagToMerge != curTag) {
-        val_uf_tag_union(tagToMerge, curTag);
-      }
-    }
     // Find out the canonical tag
     canonicalTag = val_uf_find_leader(tagToMerge);
 
@@ -404,9 +822,7 @@ DYNCOMP_TPRINTF("MLR debug val_uf_union_tags_in_range addr=%p, tag=%u\n", (void
                   (void *)a, (void *)(a+len), canonicalTag);
 
     // Set all the tags in this range to the canonical tag
-    for (curAddr = a; curAddr < (a + len); curAddr++) {
-      set_tag(curAddr, canonicalTag);
-    }
+    set_tag_range(a, len, canonicalTag);
 
     print_merge = 1;
     return canonicalTag;
@@ -426,6 +842,59 @@ UInt MC_(helperc_CREATE_TAG)(Addr static_id) {
   return newTag;
 }
 
+// For --dyncomp-site-literals: the tag that each literal site (the
+// static_id passed to MC_(helperc_CREATE_SITE_TAG)) last handed out,
+// which is reused as long as literal_tag_epoch hasn't changed since.
+typedef struct {
+  UInt epoch;
+  UInt tag;
+} LiteralSiteTag;
+
+static LiteralSiteTag* literal_site_tags = 0;
+static UInt num_literal_site_tags = 0;
+
+// Starts at 1 so that the zeroed entries in literal_site_tags are
+// never current
+static UInt literal_tag_epoch = 1;
+
+void DC_new_literal_tag_epoch(void) {
+  literal_tag_epoch++;
+}
+
+// Like MC_(helperc_CREATE_TAG), but only creates one tag for each
+// literal site until DC_new_literal_tag_epoch() is called (at every
+// program point, and after garbage collection renumbers the tags),
+// so a literal in a loop doesn't make a new tag on every iteration
+VG_REGPARM(1)
+UInt MC_(helperc_CREATE_SITE_TAG)(Addr static_id) {
+  LiteralSiteTag* site;
+
+  if (UNLIKELY(static_id >= num_literal_site_tags)) {
+    UInt newSize = num_literal_site_tags ? num_literal_site_tags : 1024;
+    while (newSize <= static_id) {
+      newSize *= 2;
+    }
+    literal_site_tags = VG_(realloc)("dyncomp_main.c: CREATE_SITE_TAG",
+                                     literal_site_tags,
+                                     newSize * sizeof(*literal_site_tags));
+    VG_(memset)(literal_site_tags + num_literal_site_tags, 0,
+                (newSize - num_literal_site_tags) * sizeof(*literal_site_tags));
+    num_literal_site_tags = newSize;
+  }
+
+  site = &literal_site_tags[static_id];
+  if (site->epoch != literal_tag_epoch) {
+    // grab_fresh_tag() may garbage collect, which starts a new epoch
+    UInt newTag = grab_fresh_tag();
+    site->epoch = literal_tag_epoch;
+    site->tag = newTag;
+  }
+
+  DYNCOMP_TPRINTF("[DynComp] CREATE_SITE_TAG: %p => %u\n",
+                  (void *)static_id, site->tag);
+  return site->tag;
+}
+
 
 VG_REGPARM(1)
 UInt MC_(helperc_LOAD_TAG_8) ( Addr a ) {
@@ -435,7 +904,7 @@ UInt MC_(helperc_LOAD_TAG_8) ( Addr a ) {
 
 VG_REGPARM(1)
 UInt MC_(helperc_LOAD_TAG_4) ( Addr a ) {
-  UInt first_tag = get_tag(a);
+  UInt first_tag = peek_tag(a);
   if (first_tag == WEAK_FRESH_TAG) {
     DYNCOMP_TPRINTF("[DynComp] helperx_LOAD_ATG_4: %p =>\n", (void *)a);
     return grab_fresh_tag();
@@ -452,7 +921,7 @@ UInt MC_(helperc_LOAD_TAG_2) ( Addr a ) {
 
 VG_REGPARM(1)
 UInt MC_(helperc_LOAD_TAG_1) ( Addr a ) {
-  DYNCOMP_TPRINTF("[DynComp] LOAD_TAG_1: %p => %u\n", (void *)a, get_tag(a));
+  DYNCOMP_TPRINTF("[DynComp] LOAD_TAG_1: %p => %u\n", (void *)a, peek_tag(a));
   return val_uf_union_tags_in_range(a, 1);
 }
 
@@ -490,10 +959,6 @@ UInt tag2_is_new ( UInt tag1, UInt tag2 ) {
 // of the merged set
 VG_REGPARM(2)
 UInt MC_(helperc_MERGE_TAGS) ( UInt tag1, UInt tag2 ) {
-  Addr eip = VG_(get_IP)(VG_(get_running_tid)());
-  const HChar *eip_info;
-  eip_info = VG_(describe_IP)(eip, NULL);
-
   if (dyncomp_profile_tags) {
     mergeTagsCount++;
   }
@@ -511,12 +976,16 @@ UInt MC_(helperc_MERGE_TAGS) ( UInt tag1, UInt tag2 ) {
   //  but that's correctly handled)
   else if (WEAK_FRESH_TAG == tag1) {
     DYNCOMP_TPRINTF("[DynComp-m1] Merging %u with %u to get %u at %s\n",
-                    tag1, tag2, tag2, eip_info);
+                    tag1, tag2, tag2, current_IP_description());
     return tag2;
   }
   else if (WEAK_FRESH_TAG == tag2) {
     DYNCOMP_TPRINTF("[DynComp-m2] Merging %u with %u to get %u at %s\n",
-                    tag1, tag2, tag1, eip_info);
+                    tag1, tag2, tag1, current_IP_description());
+    return tag1;
+  }
+  // Merging a tag with itself changes nothing
+  else if (tag1 == tag2) {
     return tag1;
   }
   else {
@@ -525,6 +994,18 @@ UInt MC_(helperc_MERGE_TAGS) ( UInt tag1, UInt tag2 ) {
   }
 }
 
+// The slow path of the inline merges that dyncomp_translate.c emits
+// (see mkMergeTags_DC()), which are only called once it has checked
+// that tag1 and tag2 are two different real tags
+VG_REGPARM(2)
+UInt MC_(helperc_MERGE_DISTINCT_TAGS) ( UInt tag1, UInt tag2 ) {
+  if (dyncomp_profile_tags) {
+    mergeTagsCount++;
+  }
+
+  return val_uf_tag_union(tag1, tag2);
+}
+
 // We can make this more efficient, but correctness is more important
 // right now (as it should be!):
 VG_REGPARM(3)
@@ -46,12 +46,14 @@
 #define SECONDARY_SIZE 65536               /* DO NOT CHANGE */
 #define PRIMARY_SIZE	(1 << (32 - SECONDARY_SHIFT))
 #else
-/* This supports address space sizes up to 2**40 = 1TB, which happens to
-   also be the maximum amount of physical RAM supported by current
-   x86-64 processors. It would be nice to support 2**48 (the current
-   address-space limit) or 2**64 (the architectural limit), but those
-   would require a redesign of the table structure to have more levels
-   or a different kind of top level (like Memcheck). */
+/* primary_tag_map directly covers address space sizes up to 2**40 =
+   1TB, which happens to also be the maximum amount of physical RAM
+   supported by current x86-64 processors.  Secondaries for addresses
+   above that live in high_tag_map, a hash table keyed by secondary
+   base address (somewhat like Memcheck's auxmap), so the rest of the
+   64-bit address space works too, just a bit more slowly.
+   primary_val_uf_object_map is indexed by 32-bit tags rather than
+   addresses, so it never needs more than the direct table. */
 #define SECONDARY_SHIFT	20
 #define SECONDARY_SIZE 1048576
 #define PRIMARY_SIZE	(1 << (40 - SECONDARY_SHIFT))
@@ -65,6 +67,7 @@
 
 // Special reserved tags
 const UInt WEAK_FRESH_TAG;
+const UInt LAZY_FRESH_TAG;
 const UInt LARGEST_REAL_TAG;
 
 UInt nextTag;
@@ -73,13 +76,86 @@ UInt nextTag;
 // duration of the program
 UInt totalNumTagsAssigned;
 
-UInt* primary_tag_map[PRIMARY_SIZE];
+/* Each secondary tag map covers SECONDARY_SIZE bytes of address
+   space, split up into TAG_PAGES_PER_SECONDARY pages of TAG_PAGE_SIZE
+   bytes.  Each page is held in one of three forms:
+
+   uniform:  All bytes in the page have the same tag, uniform[p]
+             (dense[p] and words[p] are both NULL).
+   per-word: Every aligned TAG_WORD_SIZE-byte word in the page has a
+             single tag, words[p][i] (dense[p] is NULL).
+   dense:    One tag for each byte, dense[p][i].
+
+   Pages start out uniform and only move to a more detailed form when
+   they are written at a finer granularity than the form can hold.
+   The garbage collector moves them back to a coarser form whenever
+   it can.  The inline tag IR (see mkTagPage_DC in
+   dyncomp_translate.c) handles aligned accesses to all three forms
+   directly: it loads from dense[p], words[p] or uniform[p], and
+   stores to dense pages, to per-word pages (only whole words) and to
+   uniform pages (only without changing the tag, so as a no-op).
+   Everything else goes to the helpers, and so does any access whose
+   secondary is missing from primary_tag_map, including the stale
+   ones that the incremental garbage collector has taken out of it. */
+#define TAG_PAGE_SHIFT 12
+#define TAG_PAGE_SIZE  (1 << TAG_PAGE_SHIFT)
+#define TAG_PAGE_MASK  (TAG_PAGE_SIZE-1)
+#define TAG_PAGES_PER_SECONDARY (SECONDARY_SIZE >> TAG_PAGE_SHIFT)
+
+#define TAG_WORD_SHIFT 2
+#define TAG_WORD_SIZE  (1 << TAG_WORD_SHIFT)
+#define TAG_WORDS_PER_PAGE (TAG_PAGE_SIZE >> TAG_WORD_SHIFT)
+
+#define TAG_PAGE_IDX(addr) (SM_OFF(addr) >> TAG_PAGE_SHIFT)
+#define TAG_PAGE_OFF(addr) ((addr) & TAG_PAGE_MASK)
+
+typedef struct {
+  UInt* dense[TAG_PAGES_PER_SECONDARY];
+  UInt* words[TAG_PAGES_PER_SECONDARY];
+  UInt  uniform[TAG_PAGES_PER_SECONDARY];
+} TagSecondary;
+
+TagSecondary* primary_tag_map[PRIMARY_SIZE];
+
+#if VG_WORDSIZE == 8
+// An entry in high_tag_map (sec == NULL means the slot is free)
+typedef struct {
+  Addr base;
+  TagSecondary* sec;
+} HighTagMapEntry;
+
+// Open-addressed (linear probing) table of the secondaries for
+// addresses at or above PRIMARY_SIZE << SECONDARY_SHIFT.  Its size is
+// always a power of 2.
+extern HighTagMapEntry* high_tag_map;
+extern UInt high_tag_map_size;
+
+TagSecondary* find_high_tag_secondary(Addr a);
+#endif
 
 // The number of entries in primary_tag_map that are initialized
 // Range is [0, PRIMARY_SIZE]
 UInt n_primary_tag_map_init_entries;
 
-uf_object* primary_val_uf_object_map[PRIMARY_SIZE];
+// The number of tag pages currently held in the dense and per-word
+// forms (all others are uniform)
+UInt n_dense_tag_pages;
+UInt n_word_tag_pages;
+
+// One secondary of the value union-find arena, covering the
+// SECONDARY_SIZE consecutive tags that share a PM_IDX.  The sets are
+// kept as a structure of arrays indexed by SM_OFF(tag): parent[] holds
+// the 32-bit parent tag (a leader is its own parent) and rank[] the
+// union-by-rank rank, which only ever matters for leaders and never
+// exceeds 32.  That is 5 bytes per tag instead of a 16-byte uf_object,
+// and finding a leader never loads a pointer.  Secondaries come from
+// VG_(am_shadow_alloc) and so are page- (and thus cache-line-) aligned.
+typedef struct {
+  UInt  parent[SECONDARY_SIZE];
+  UChar rank[SECONDARY_SIZE];
+} ValUFSecondary;
+
+ValUFSecondary* primary_val_uf_object_map[PRIMARY_SIZE];
 
 // The number of entries that are initialized in
 // primary_val_uf_object_map
@@ -87,19 +163,45 @@ uf_object* primary_val_uf_object_map[PRIMARY_SIZE];
 UInt n_primary_val_uf_object_map_init_entries;
 
 
+// Scratch space that the inline tag load/store IR (see
+// dyncomp_translate.c) reads from and writes to whenever it has to
+// fall back on the helper functions.  Big enough for 8 tags.
+extern UInt dc_tag_sink[8];
+
 #define IS_SECONDARY_UF_NULL(tag) (primary_val_uf_object_map[PM_IDX(tag)] == NULL)
 
 // Make sure to check that !IS_SECONDARY_UF_NULL(tag) before
-// calling this macro or else you may segfault
-#define GET_UF_OBJECT_PTR(tag) (&(primary_val_uf_object_map[PM_IDX(tag)][SM_OFF(tag)]))
+// calling these macros or else you may segfault
+#define VAL_UF_PARENT(tag) (primary_val_uf_object_map[PM_IDX(tag)]->parent[SM_OFF(tag)])
+#define VAL_UF_RANK(tag) (primary_val_uf_object_map[PM_IDX(tag)]->rank[SM_OFF(tag)])
 
-#if VG_WORDSIZE == 4
-#define IS_SECONDARY_TAG_MAP_NULL(a) (primary_tag_map[PM_IDX(a)] == NULL)
-#else
-/* In this case, need an overflow check */
-#define IS_SECONDARY_TAG_MAP_NULL(a) (PM_IDX(a) >= PRIMARY_SIZE || \
-                                      primary_tag_map[PM_IDX(a)] == NULL)
+// The number of secondaries which an incremental garbage collection
+// (--dyncomp-gc-incremental) has taken out of primary_tag_map and not
+// yet renumbered (see dyncomp_runtime.c)
+extern UInt n_stale_tag_secondaries;
+
+TagSecondary* revive_stale_tag_secondary(Addr a);
+void remap_stale_tag_secondaries(UInt n);
+
+// Returns the secondary tag map covering address a, or NULL if there
+// isn't one yet
+static __inline__ TagSecondary* get_tag_secondary ( Addr a )
+{
+  TagSecondary* sec;
+#if VG_WORDSIZE == 8
+  /* In this case, need an overflow check */
+  if (UNLIKELY(PM_IDX(a) >= PRIMARY_SIZE)) {
+    return find_high_tag_secondary(a);
+  }
 #endif
+  sec = primary_tag_map[PM_IDX(a)];
+  if (UNLIKELY(!sec && n_stale_tag_secondaries)) {
+    sec = revive_stale_tag_secondary(a);
+  }
+  return sec;
+}
+
+#define IS_SECONDARY_TAG_MAP_NULL(a) (get_tag_secondary(a) == NULL)
 
 
 // Defines a singly-linked list of 32-bit UInt tags
@@ -131,23 +233,28 @@ UInt val_uf_union_tags_in_range(Addr a, SizeT len);
 void val_uf_union_tags_at_addr(Addr a1, Addr a2);
 void set_tag_for_GOT(Addr a, SizeT len);
 
-static __inline__ void set_tag ( Addr a, UInt tag )
+TagSecondary* new_tag_secondary(Addr a);
+void set_tag_in_coarse_page(TagSecondary* sec, Addr a, UInt tag);
+void set_tag_range(Addr a, SizeT len, UInt tag);
+void compact_tag_page(TagSecondary* sec, UInt p);
+
+// Returns the tag of the byte at offset off of page p of sec
+static __inline__ UInt get_tag_in_page ( TagSecondary* sec, UInt p, UInt off )
 {
-  if (IS_SECONDARY_TAG_MAP_NULL(a)) {
-    UInt* new_tag_array;
+  if (sec->dense[p]) {
+    return sec->dense[p][off];
+  }
+  else if (sec->words[p]) {
+    return sec->words[p][off >> TAG_WORD_SHIFT];
+  }
+  return sec->uniform[p];
+}
 
-    if (PM_IDX(a) >= PRIMARY_SIZE) {
-      printf("Address too large for DynComp: %p.\n", (void *)a);
-      printf("Terminating program.\n");
-      VG_(exit)(1);
-    }
+static __inline__ void set_tag ( Addr a, UInt tag )
+{
+  TagSecondary* sec;
+  UInt p;
 
-    new_tag_array =
-      (UInt*)VG_(am_shadow_alloc)(SECONDARY_SIZE * sizeof(*new_tag_array));
-    VG_(memset)(new_tag_array, 0, (SECONDARY_SIZE * sizeof(*new_tag_array)));
-    primary_tag_map[PM_IDX(a)] = new_tag_array;
-    n_primary_tag_map_init_entries++;
-  }
 #ifndef MAX_DEBUG_INFO
   if (dyncomp_print_trace_all) {
     DYNCOMP_TPRINTF("[DynComp] set_tag: %u for loc: %p\n", tag, (void *)a);
@@ -155,16 +262,44 @@ static __inline__ void set_tag ( Addr a, UInt tag )
 #else
   printf("[DynComp] set_tag: %u for loc: %p\n", tag, (void *)a);
 #endif
-  primary_tag_map[PM_IDX(a)][SM_OFF(a)] = tag;
+  sec = get_tag_secondary(a);
+  if (!sec) {
+    // A missing secondary reads as all 0 tags, so there is
+    // nothing to do when clearing
+    if (IS_ZERO_TAG(tag)) {
+      return;
+    }
+    sec = new_tag_secondary(a);
+  }
+  p = TAG_PAGE_IDX(a);
+  if (sec->dense[p]) {
+    sec->dense[p][TAG_PAGE_OFF(a)] = tag;
+  }
+  else {
+    set_tag_in_coarse_page(sec, a, tag);
+  }
+}
+
+// Returns the tag held at a as is, which may be LAZY_FRESH_TAG
+static __inline__ UInt peek_tag ( Addr a )
+{
+  TagSecondary* sec = get_tag_secondary(a);
+  if (!sec) {
+    return 0; // 0 means NO tag for that byte
+  }
+  return get_tag_in_page(sec, TAG_PAGE_IDX(a), TAG_PAGE_OFF(a));
 }
 
+UInt materialize_lazy_tag(Addr a);
+
 #ifndef MAX_DEBUG_INFO
 static __inline__ UInt get_tag ( Addr a )
 {
-  if (IS_SECONDARY_TAG_MAP_NULL(a)) {
-    return 0; // 0 means NO tag for that byte
+  UInt tag = peek_tag(a);
+  if (UNLIKELY(tag == LAZY_FRESH_TAG)) {
+    tag = materialize_lazy_tag(a);
   }
-  return primary_tag_map[PM_IDX(a)][SM_OFF(a)];
+  return tag;
 }
 #else
 static __inline__ UInt get_tag ( Addr a )
@@ -174,10 +309,9 @@ static __inline__ UInt get_tag ( Addr a )
   const HChar *eip_info;
   eip_info = VG_(describe_IP)(tid, NULL);
 
-  if (IS_SECONDARY_TAG_MAP_NULL(a)) {
-    tag = 0; // 0 means NO tag for that byte
-  } else {
-    tag = primary_tag_map[PM_IDX(a)][SM_OFF(a)];
+  tag = peek_tag(a);
+  if (tag == LAZY_FRESH_TAG) {
+    tag = materialize_lazy_tag(a);
   }
   printf("[DynComp] Fetching tag %d for %p at %s\n", tag, (void*)a, eip_info);
   return tag;
@@ -186,14 +320,13 @@ static __inline__ UInt get_tag ( Addr a )
 
 // Clear all tags for all bytes in range [a, a + len)
 static __inline__ void clear_all_tags_in_range( Addr a, SizeT len ) {
-  Addr curAddr;
-
-  for (curAddr = a; curAddr < (a+len); curAddr++) {
-    // Set the tag to 0
-    set_tag(curAddr, 0);
-  }
+  set_tag_range(a, len, 0);
 }
 
+// How many tags get assigned between incremental garbage collection
+// steps (must be a power of 2)
+#define DYNCOMP_GC_STEP_INTERVAL 4096
+
 // Return a fresh tag and create a singleton set
 // for the uf_object associated with that tag
 static __inline__ UInt grab_fresh_tag(void) {
@@ -207,6 +340,10 @@ static __inline__ UInt grab_fresh_tag(void) {
       (totalNumTagsAssigned % dyncomp_gc_after_n_tags == 0)) {
     garbage_collect_tags();
   }
+  else if (UNLIKELY(n_stale_tag_secondaries) &&
+           ((totalNumTagsAssigned & (DYNCOMP_GC_STEP_INTERVAL - 1)) == 0)) {
+    remap_stale_tag_secondaries(dyncomp_gc_step);
+  }
 
   tag = nextTag;
 
@@ -239,40 +376,42 @@ static __inline__ UInt grab_fresh_tag(void) {
 
 }
 
-// Allocate a new unique tag for all bytes in range [a, a + len)
+// Allocate a new unique tag for all bytes in range [a, a + len).
+// The tags are only really created (by get_tag) when each byte is
+// first read, so that large allocations which are mostly never read,
+// or only ever overwritten, don't burn through tags.
 static __inline__ void allocate_new_unique_tags ( Addr a, SizeT len ) {
-  Addr curAddr;
-  UInt newTag;
-  for (curAddr = a; curAddr < (a+len); curAddr++) {
-    newTag = grab_fresh_tag();
-    set_tag(curAddr, newTag);
-  }
+  set_tag_range(a, len, LAZY_FRESH_TAG);
 }
 
-static  __inline__ uf_name val_uf_tag_find(UInt tag) {
-  if (IS_ZERO_TAG(tag) || IS_SECONDARY_UF_NULL(tag)) {
-    return NULL;
-  }
-  else {
-    return uf_find(GET_UF_OBJECT_PTR(tag));
+// Return the leader of the set which the non-zero 'tag' belongs to,
+// halving the path on the way up (every tag visited is pointed at its
+// grandparent), so only one pass over the path is needed.
+// Caller guarantees that !IS_SECONDARY_UF_NULL(tag)
+static __inline__ UInt val_uf_tag_find(UInt tag) {
+  UInt parent = VAL_UF_PARENT(tag);
+  while (parent != tag) {
+    UInt grandparent = VAL_UF_PARENT(parent);
+    VAL_UF_PARENT(tag) = grandparent;
+    tag = grandparent;
+    parent = VAL_UF_PARENT(tag);
   }
+  return tag;
 }
 
 // Return the leader (canonical tag) of the set which 'tag' belongs to
 static __inline__ UInt val_uf_find_leader(UInt tag) {
-  uf_name canonical = val_uf_tag_find(tag);
-  if (canonical) {
-#ifdef MAX_DEBUG_INFO
-    printf("[DynComp] Leader of %d is %d\n", tag, canonical->tag);
-#endif
-    return canonical->tag;
+  UInt leader;
+  if (IS_ZERO_TAG(tag) || IS_SECONDARY_UF_NULL(tag)) {
+    leader = 0;
   }
   else {
+    leader = val_uf_tag_find(tag);
+  }
 #ifdef MAX_DEBUG_INFO
-    printf("[DynComp] Leader of %d is %d\n", tag, 0);
+  printf("[DynComp] Leader of %d is %d\n", tag, leader);
 #endif
-    return 0;
-  }
+  return leader;
 }
 
 extern VG_REGPARM(1) UInt MC_(helperc_TAG_NOP) ( UInt );
@@ -290,9 +429,14 @@ extern VG_REGPARM(1) UInt MC_(helperc_LOAD_TAG_2) ( Addr );
 extern VG_REGPARM(1) UInt MC_(helperc_LOAD_TAG_1) ( Addr );
 
 extern VG_REGPARM(1) UInt MC_(helperc_CREATE_TAG) ( Addr static_id );
+extern VG_REGPARM(1) UInt MC_(helperc_CREATE_SITE_TAG) ( Addr static_id );
+
+// Makes MC_(helperc_CREATE_SITE_TAG) hand out new tags
+void DC_new_literal_tag_epoch(void);
 
 extern VG_REGPARM(2) UInt MC_(helperc_MERGE_TAGS) ( UInt, UInt );
 extern VG_REGPARM(2) UInt MC_(helperc_MERGE_TAGS_RETURN_0) ( UInt, UInt );
+extern VG_REGPARM(2) UInt MC_(helperc_MERGE_DISTINCT_TAGS) ( UInt, UInt );
 
 extern VG_REGPARM(3) UInt MC_(helperc_MERGE_3_TAGS) ( UInt, UInt, UInt );
 extern VG_REGPARM(3) UInt MC_(helperc_MERGE_4_TAGS) ( UInt, UInt, UInt, UInt );
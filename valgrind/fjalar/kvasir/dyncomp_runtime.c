@@ -28,15 +28,19 @@
 #include "../my_libc.h"
 
 #include "pub_tool_basics.h"
+#include "pub_tool_libcbase.h"
 #include "pub_tool_libcprint.h"
+#include "pub_tool_libcproc.h"
 #include "pub_tool_machine.h"
 #include "pub_tool_threadstate.h"
 
 #include "decls-output.h"
 #include "kvasir_main.h"
+#include "kvasir_profile.h"
 #include "dyncomp_runtime.h"
 #include "union_find.h"
 #include "dyncomp_main.h"
+#include "dyncomp_state.h"
 #include "dyncomp_runtime.h"
 
 #include "../fjalar_include.h"
@@ -48,8 +52,7 @@ extern char* cur_var_name;
 
 static void dump_function_exit_var_map(DaikonFunctionEntry*);
 static void dump_all_function_exit_var_map(void);
-static uf_name val_uf_tag(UInt);
-static struct genhashtable* regenerate_var_uf_map(UInt, UInt*, struct genhashtable*, UInt*);
+static VarUFMap* regenerate_var_uf_map(UInt, UInt*, VarUFMap*, UInt*);
 static void reassign_tag(UInt*, UInt, UInt*);
 
 // Cast an intger to a void pointer in a architecture independent way. (markro)
@@ -77,9 +80,39 @@ int g_curCompNumber = 1;
 //
 // Clear and initialize it to (nextTag + 1) before every run of
 // garbage collector (Remember that index 0 is never used because 0
-// tag is invalid)
+// tag is invalid).  It is only reallocated when nextTag has grown
+// past g_remapMapSize.
 UInt* g_oldToNewMap = 0;
 
+// Map from every old tag to its leader, filled in at the start of an
+// incremental garbage collection (--dyncomp-gc-incremental) so that
+// tags in shadow memory can still be renumbered after val_uf has been
+// reset for the new tags.  Same size as g_oldToNewMap.
+static UInt* g_oldLeaderMap = 0;
+
+// The number of entries allocated in g_oldToNewMap (and
+// g_oldLeaderMap, if it exists)
+static UInt g_remapMapSize = 0;
+
+// Secondaries that the last incremental garbage collection took out
+// of primary_tag_map, indexed the same way.  Their tags are still
+// numbered as they were before that collection.  Each one gets
+// renumbered and put back the first time its memory is accessed (via
+// get_tag_secondary()), or by remap_stale_tag_secondaries(), which
+// grab_fresh_tag() calls every DYNCOMP_GC_STEP_INTERVAL tags,
+// whichever comes first.  The inline tag IR treats a missing
+// secondary as a reason to call the helpers, so it never sees them.
+static TagSecondary** stale_tag_map = 0;
+UInt n_stale_tag_secondaries = 0;
+
+// Where remap_stale_tag_secondaries() left off in stale_tag_map
+static UInt stale_tag_cursor = 0;
+
+// Garbage collector pause statistics
+static UInt  gc_num_runs = 0;
+static ULong gc_total_pause_ms = 0;
+static UInt  gc_longest_pause_ms = 0;
+
 int is_enter;
 static TraversalAction dyncompExtraPropAction;
 
@@ -112,11 +145,7 @@ void allocate_ppt_structures(DaikonFunctionEntry* funcPtr,
       }
     }
     else {
-      // no hash function needed because GenericHashtable.h simply
-      // mods it by the current size of the table
-      funcPtr->ppt_entry_var_uf_map =
-        genallocateSMALLhashtable((unsigned int (*)(void *)) 0,
-                                  (int (*)(void *,void *)) &equivalentTags);
+      funcPtr->ppt_entry_var_uf_map = var_uf_map_new();
 
       if (numDaikonVars > 0) { // calloc'ing 0-length array doesn't work
         funcPtr->ppt_entry_var_tags = VG_(calloc)("dyncomp_runtime.c: allocate_ppt_structures.3", numDaikonVars,
@@ -140,9 +169,7 @@ void allocate_ppt_structures(DaikonFunctionEntry* funcPtr,
       }
     }
     else {
-      funcPtr->ppt_exit_var_uf_map =
-        genallocateSMALLhashtable((unsigned int (*)(void *)) 0,
-                                  (int (*)(void *,void *)) &equivalentTags);
+      funcPtr->ppt_exit_var_uf_map = var_uf_map_new();
 
       if (numDaikonVars > 0) { // calloc'ing 0-length array doesn't work
         funcPtr->ppt_exit_var_tags = VG_(calloc)("dyncomp_runtime.c: allocate_ppt_structures.6", numDaikonVars,
@@ -169,7 +196,7 @@ void destroy_ppt_structures(DaikonFunctionEntry* funcPtr, char isEnter) {
       funcPtr->ppt_entry_new_tag_leaders = 0;
     }
     else {
-      genfreehashtableandvalues(funcPtr->ppt_entry_var_uf_map);
+      var_uf_map_free(funcPtr->ppt_entry_var_uf_map);
       funcPtr->ppt_entry_var_uf_map = 0;
       VG_(free)(funcPtr->ppt_entry_var_tags);
       funcPtr->ppt_entry_var_tags = 0;
@@ -183,7 +210,7 @@ void destroy_ppt_structures(DaikonFunctionEntry* funcPtr, char isEnter) {
       funcPtr->ppt_exit_new_tag_leaders = 0;
     }
     else {
-      genfreehashtableandvalues(funcPtr->ppt_exit_var_uf_map);
+      var_uf_map_free(funcPtr->ppt_exit_var_uf_map);
       funcPtr->ppt_exit_var_uf_map = 0;
       VG_(free)(funcPtr->ppt_exit_var_tags);
       funcPtr->ppt_exit_var_tags = 0;
@@ -194,18 +221,18 @@ void destroy_ppt_structures(DaikonFunctionEntry* funcPtr, char isEnter) {
 
 // Variable comparability set map (var_uf_map) operations:
 
-static uf_name var_uf_map_find(struct genhashtable* var_uf_map, UInt tag) {
+static uf_name var_uf_map_find(VarUFMap* var_uf_map, UInt tag) {
   if (!tag) {
     return NULL;
   }
-  return (uf_object*)gengettable(var_uf_map, VoidPtr(tag));
+  return (uf_object*)var_uf_map_get(var_uf_map, tag);
 }
 
-static UInt var_uf_map_find_leader(struct genhashtable* var_uf_map, UInt tag) {
+static UInt var_uf_map_find_leader(VarUFMap* var_uf_map, UInt tag) {
   if (!tag) {
     return 0;
   } else {
-    uf_object* uf_obj = (uf_object*)gengettable(var_uf_map, VoidPtr(tag));
+    uf_object* uf_obj = (uf_object*)var_uf_map_get(var_uf_map, tag);
     if (uf_obj) {
       return (uf_find(uf_obj))->tag;
     } else {
@@ -219,17 +246,13 @@ static UInt var_uf_map_find_leader(struct genhashtable* var_uf_map, UInt tag) {
 // freshly-allocated uf_object in a singleton set (instantiated using
 // uf_make_set) as the VALUE
 // Returns the uf_object* to the new entry
-static uf_object* var_uf_map_insert_and_make_set(struct genhashtable* var_uf_map,
+static uf_object* var_uf_map_insert_and_make_set(VarUFMap* var_uf_map,
                                                  UInt tag) {
-  uf_object *new_obj;
   if (!tag) {
     return 0;
   }
 
-  new_obj = VG_(malloc)("dyncomp_runtime.c: var_uf_mims", sizeof(*new_obj));
-  uf_make_set(new_obj, tag);
-  genputtable(var_uf_map, VoidPtr(tag), (void*)new_obj);
-  return new_obj;
+  return (uf_object*)var_uf_map_insert(var_uf_map, tag);
 }
 
 // Unions the uf_objects corresponding to tags tag1 and tag2 in
@@ -237,7 +260,7 @@ static uf_object* var_uf_map_insert_and_make_set(struct genhashtable* var_uf_map
 // (Note that if a tag is non-zero but does not yet have an entry in
 //  var_uf_map, a new singleton entry will be created for it.
 //  This seems to allow the garbage collector to work correctly.)
-static UInt var_uf_map_union(struct genhashtable* var_uf_map,
+static UInt var_uf_map_union(VarUFMap* var_uf_map,
                              UInt tag1,
                              UInt tag2) {
 
@@ -251,8 +274,8 @@ static UInt var_uf_map_union(struct genhashtable* var_uf_map,
     return tag2;
   }
   else { // Good.  Both are valid.
-    uf_object* uf_obj1 = (uf_object*)gengettable(var_uf_map, VoidPtr(tag1));
-    uf_object* uf_obj2 = (uf_object*)gengettable(var_uf_map, VoidPtr(tag2));
+    uf_object* uf_obj1 = (uf_object*)var_uf_map_get(var_uf_map, tag1);
+    uf_object* uf_obj2 = (uf_object*)var_uf_map_get(var_uf_map, tag2);
     uf_object* leader_obj = 0;
 
     // If one of the tags is NOT in var_uf_map, then
@@ -265,7 +288,8 @@ static UInt var_uf_map_union(struct genhashtable* var_uf_map,
       uf_obj2 = var_uf_map_insert_and_make_set(var_uf_map, tag2);
     }
 
-    leader_obj = uf_union(uf_obj1, uf_obj2);
+    leader_obj = (uf_object*)var_uf_map_union_entries((VarUFEntry*)uf_obj1,
+                                                      (VarUFEntry*)uf_obj2);
     DYNCOMP_TPRINTF("[DynComp] Merging %u with %u to get %u at (%s - %s) - VARIABLE\n",
 		    tag1, tag2, leader_obj->tag,(is_enter == 1)?"Entering":"Exiting", func_name );
     return leader_obj->tag;
@@ -315,7 +339,7 @@ void DC_post_process_for_variable(DaikonFunctionEntry* funcPtr,
                                   Addr a) {
 
   UInt leader, new_leader, var_tags_v, new_tags_v;
-  struct genhashtable* var_uf_map;
+  VarUFMap* var_uf_map;
   UInt* var_tags;
   UInt* new_tag_leaders;
 
@@ -357,7 +381,8 @@ void DC_post_process_for_variable(DaikonFunctionEntry* funcPtr,
   // variable's previously observed values.
   var_tags_v = var_tags[daikonVarIndex];
   if (var_tags_v) {
-    uf_object* uf_leader = (uf_object*)gengettable(var_uf_map, VoidPtr(var_tags_v));
+    uf_object* uf_leader = (uf_object*)var_uf_map_get(var_uf_map, var_tags_v);
+    VarUFEntry* var_member;
     tl_assert(uf_leader);
 
     // See if the associated val set has changed since the last observation.
@@ -371,14 +396,13 @@ void DC_post_process_for_variable(DaikonFunctionEntry* funcPtr,
 
     // (This next section is the correction described in the addendum.)
     // We need to iterate through the members of the var set for var_tags_v.
-    // No easy way to do this, so check all members of the var_uf_map to
-    // see if they qualify.
-    struct genpointerlist* var_item = var_uf_map->list;
-    while (var_item) {
-      uf_object* uf_obj = (uf_object*)(var_item->object);
-      // If member of the same var set, then we need to process
-      // (but not if its the leader, that was already processed)
-      if ((uf_leader == uf_obj->parent) && (uf_leader != uf_obj)) {
+    // (Members that join the set during the loop get appended to the
+    //  list, so they are checked too.)
+    var_member = ((VarUFEntry*)uf_find(uf_leader))->first_member;
+    while (var_member) {
+      uf_object* uf_obj = &var_member->uf;
+      // Skip the leader, that was already processed
+      if (uf_leader != uf_obj) {
         // See if the associated val set has changed since the last observation.
         UInt t = val_uf_find_leader(uf_obj->tag);
         DYNCOMP_TPRINTF("         %p %8d %u\n", uf_obj, uf_obj->tag, t);
@@ -388,7 +412,7 @@ void DC_post_process_for_variable(DaikonFunctionEntry* funcPtr,
           DYNCOMP_TPRINTF("         new leader: %u\n", leader);
         }
       }
-      var_item = var_item->inext;
+      var_member = var_member->next_member;
     }
 
     // If any of the associated val sets have changed we need
@@ -411,7 +435,7 @@ void DC_post_process_for_variable(DaikonFunctionEntry* funcPtr,
             (void *)a, var_tags_v, new_tags_v, new_leader);
 
   if (new_leader && // We don't want to insert 0 tags into the union find structure
-      !gengettable(var_uf_map, VoidPtr(new_leader))) {
+      !var_uf_map_get(var_uf_map, new_leader)) {
     var_uf_map_insert_and_make_set(var_uf_map, new_leader);
   }
 
@@ -442,7 +466,7 @@ void DC_extra_propagation_post_process(DaikonFunctionEntry* funcPtr,
                                        char isEnter,
                                        int daikonVarIndex) {
   UInt leader, var_tags_v;
-  struct genhashtable* var_uf_map;
+  VarUFMap* var_uf_map;
   UInt *var_tags;
 
   // We currently do not do any extra propagation when we are in
@@ -467,7 +491,8 @@ void DC_extra_propagation_post_process(DaikonFunctionEntry* funcPtr,
   // variable's previously observed values.
   var_tags_v = var_tags[daikonVarIndex];
   if (var_tags_v) {
-    uf_object* uf_leader = (uf_object*)gengettable(var_uf_map, VoidPtr(var_tags_v));
+    uf_object* uf_leader = (uf_object*)var_uf_map_get(var_uf_map, var_tags_v);
+    VarUFEntry* var_member;
     tl_assert(uf_leader);
 
     // See if the associated val set has changed since the last observation.
@@ -481,14 +506,11 @@ void DC_extra_propagation_post_process(DaikonFunctionEntry* funcPtr,
 
     // (This next section is the correction described in the addendum.)
     // We need to iterate through the members of the var set for var_tags_v.
-    // No easy way to do this, so check all members of the var_uf_map to
-    // see if they qualify.
-    struct genpointerlist* var_item = var_uf_map->list;
-    while (var_item) {
-      uf_object* uf_obj = (uf_object*)(var_item->object);
-      // If member of the same var set, then we need to process
-      // (but not if its the leader, that was already processed)
-      if ((uf_leader == uf_obj->parent) && (uf_leader != uf_obj)) {
+    var_member = ((VarUFEntry*)uf_find(uf_leader))->first_member;
+    while (var_member) {
+      uf_object* uf_obj = &var_member->uf;
+      // Skip the leader, that was already processed
+      if (uf_leader != uf_obj) {
         // See if the associated val set has changed since the last observation.
         UInt t = val_uf_find_leader(uf_obj->tag);
         DYNCOMP_TPRINTF("  %p %8d %u\n", uf_obj, uf_obj->tag, t);
@@ -498,7 +520,7 @@ void DC_extra_propagation_post_process(DaikonFunctionEntry* funcPtr,
           DYNCOMP_TPRINTF("extra-post_process (set member): %u \n", leader);
         }
       }
-      var_item = var_item->inext;
+      var_member = var_member->next_member;
     }
 
     // If any of the associated val sets have changed we need
@@ -546,9 +568,15 @@ int DC_get_comp_number_for_var(DaikonFunctionEntry* funcPtr,
   int comp_number;
   UInt tag;
 
-  struct genhashtable* var_uf_map;
+  VarUFMap* var_uf_map;
   UInt *var_tags;
 
+  // Already worked out (and merged with other runs' state) by
+  // DC_begin_ppt_state()
+  if (g_pptCompNumbers) {
+    return g_pptCompNumbers[daikonVarIndex];
+  }
+
   // Remember to use only the EXIT structures unless
   // isEnter and --dyncomp-separate-entry-exit are both True
   if (dyncomp_separate_entry_exit && isEnter) {
@@ -837,30 +865,21 @@ int x86_guest_state_offsets[NUM_TOTAL_X86_OFFSETS] = {
   offsetof(VexGuestX86State, guest_CMLEN)
 };
 
-static uf_name val_uf_tag(UInt tag) {
-  if (IS_ZERO_TAG(tag) || IS_SECONDARY_UF_NULL(tag)) {
-     return NULL;
-  } else {
-     return uf_find(GET_UF_OBJECT_PTR(tag));
-  }
-}
-
 static void dump_function_exit_var_map(DaikonFunctionEntry* funcPtr) {
   int daikonVarIndex;
   UInt var_tag1, var_tag2, var_tag3;
   UInt val_tag1, val_tag2;
-  struct genhashtable* var_uf_map;
+  VarUFMap* var_uf_map;
   struct genhashtable* var_set_map;
   uf_name uf_var1, uf_var2;
-  uf_name uf_val1, uf_val2;
   UInt set_number;
   UInt* var_tags;
   int comp_number;
 
     printf("Function: %s, raw map table:\n", funcPtr->funcEntry.name);
-    struct genpointerlist* exit_var_item = funcPtr->ppt_exit_var_uf_map->list;
+    VarUFEntry* exit_var_item = funcPtr->ppt_exit_var_uf_map->list;
     while (exit_var_item) {
-      uf_object* uf_obj = (uf_object*)(exit_var_item->object);
+      uf_object* uf_obj = &exit_var_item->uf;
       if (uf_obj == uf_obj->parent) {
         printf("  %p %8d %4d\n", uf_obj, uf_obj->tag, uf_obj->rank);
       } else {
@@ -898,16 +917,8 @@ static void dump_function_exit_var_map(DaikonFunctionEntry* funcPtr) {
         var_tag3 = 0;
       }
 
-      uf_val1 = val_uf_tag(var_tag3);
-      if (uf_val1) {
-        val_tag1 = uf_val1->tag;
-        uf_val2  = uf_find(uf_val1);
-        val_tag2 = uf_val2->tag;
-      } else {
-        val_tag1 = 0;
-        uf_val2  = NULL;
-        val_tag2 = 0;
-      }
+      val_tag2 = val_uf_find_leader(var_tag3);
+      val_tag1 = val_tag2 ? var_tag3 : 0;
 
       if (0 == var_tag1) {
         comp_number = set_number;
@@ -937,12 +948,12 @@ static void dump_function_exit_var_map(DaikonFunctionEntry* funcPtr) {
                  daikonVarIndex, var_tag1, uf_var2, var_tag3);
       }
       if (var_tag1 != val_tag1) {
-          printf("            [%d]: var-tag1: %u,\tuf-val1: %p,\tval-tag1: %u\n",
-                 daikonVarIndex, var_tag1, uf_val1, val_tag1);
+          printf("            [%d]: var-tag1: %u,\tval-tag1: %u\n",
+                 daikonVarIndex, var_tag1, val_tag1);
       }
       if (val_tag1 != val_tag2) {
-          printf("  val_tag2  [%d]: var-tag1: %u,\tuf-val2: %p,\tval-tag2: %u\n",
-                 daikonVarIndex, var_tag1, uf_val2, val_tag2);
+          printf("  val_tag2  [%d]: var-tag1: %u,\tval-tag2: %u\n",
+                 daikonVarIndex, var_tag1, val_tag2);
       }
 #endif
     }
@@ -977,30 +988,28 @@ static void dump_all_function_exit_var_map() {
 // Now we must rebuild the ppt_entry/exit_var_uf_map in a similar
 // manner - updating all the var tags to be the new value for the
 // corresponding val tags.
-static struct genhashtable* regenerate_var_uf_map(UInt num_daikon_vars,
-                                                  UInt* ppt_var_tags,
-                                                  struct genhashtable* ppt_var_uf_map,
-                                                  UInt* p_newTagNumber) {
+static VarUFMap* regenerate_var_uf_map(UInt num_daikon_vars,
+                                       UInt* ppt_var_tags,
+                                       VarUFMap* ppt_var_uf_map,
+                                       UInt* p_newTagNumber) {
   UInt ind;
-  struct genhashtable* new_var_uf_map =
-    genallocateSMALLhashtable((unsigned int (*)(void *)) 0,
-                              (int (*)(void *,void *)) &equivalentTags);
+  VarUFMap* new_var_uf_map = var_uf_map_new();
 
   // First, copy new leaders into new map
   for (ind = 0; ind < num_daikon_vars; ind++) {
     UInt leader_tag = ppt_var_tags[ind];
-    if (leader_tag && !gencontains(new_var_uf_map, VoidPtr(leader_tag))) {
+    if (leader_tag && !var_uf_map_get(new_var_uf_map, leader_tag)) {
       //printf("create uf var number: %d\n", ind);
       var_uf_map_insert_and_make_set(new_var_uf_map, leader_tag);
     }
   }
 
   // Next, copy non-leaders from old map items to new map, updating tags
-  struct genpointerlist* current_var_item = ppt_var_uf_map->list;
+  VarUFEntry* current_var_item = ppt_var_uf_map->list;
   while (current_var_item) {
     UInt new_tag;
     UInt new_parent_tag;
-    uf_object* uf_obj = (uf_object*)(current_var_item->object);
+    uf_object* uf_obj = &current_var_item->uf;
     // if leader, then already done
     if (uf_obj != uf_obj->parent) {
       //printf("process var map tag: %lu %p %p\n", (long unsigned int)current_var_item->src, uf_obj, uf_obj->parent);
@@ -1060,10 +1069,172 @@ static void reassign_tag(UInt* addr,
   //printf("tag: %u now: %u\n", leaderTag, *addr);
 }
 
+// Run reassign_tag() on each of the n real (non-zero and non-special)
+// tags in tags
+static void reassign_tags_in_array(UInt* tags,
+                                   UInt n,
+                                   UInt* p_newTagNumber) {
+  UInt i;
+  for (i = 0; i < n; i++) {
+    // Remember to ignore 0 tags, and leave WEAK_FRESH_TAG and
+    // LAZY_FRESH_TAG alone since they aren't in the union-find
+    if (tags[i] && (tags[i] <= LARGEST_REAL_TAG)) {
+      reassign_tag(&tags[i],
+                   val_uf_find_leader(tags[i]),
+                   p_newTagNumber);
+    }
+  }
+}
+
+
+// Run reassign_tag() on every tag held in sec
+static void reassign_tags_in_secondary(TagSecondary* sec,
+                                       UInt* p_newTagNumber) {
+  UInt pageIndex;
+  for (pageIndex = 0; pageIndex < TAG_PAGES_PER_SECONDARY; pageIndex++) {
+    if (sec->dense[pageIndex]) {
+      reassign_tags_in_array(sec->dense[pageIndex],
+                             TAG_PAGE_SIZE,
+                             p_newTagNumber);
+    }
+    else if (sec->words[pageIndex]) {
+      reassign_tags_in_array(sec->words[pageIndex],
+                             TAG_WORDS_PER_PAGE,
+                             p_newTagNumber);
+    }
+    else {
+      reassign_tags_in_array(&sec->uniform[pageIndex],
+                             1,
+                             p_newTagNumber);
+    }
+
+    compact_tag_page(sec, pageIndex);
+  }
+}
+
+// Return the new number of the tag which was numbered 'tag' before the
+// last incremental garbage collection
+static UInt remap_stale_tag(UInt tag) {
+  UInt leaderTag;
+
+  tl_assert(tag < g_remapMapSize);
+  leaderTag = g_oldLeaderMap[tag];
+
+  if (!g_oldToNewMap[leaderTag]) {
+    // Nothing that has been renumbered so far shares this set, so it
+    // gets the next new tag
+    if (nextTag == LARGEST_REAL_TAG) {
+      printf("Error! Maximum tag has been used.\n");
+      VG_(exit)(1);
+    }
+    val_uf_make_set_for_tag(nextTag);
+    g_oldToNewMap[leaderTag] = nextTag;
+    nextTag++;
+  }
+  return g_oldToNewMap[leaderTag];
+}
+
+// Renumber the stale secondary at primaryIndex and put it back into
+// primary_tag_map
+static TagSecondary* revive_stale_secondary(UInt primaryIndex) {
+  TagSecondary* sec = stale_tag_map[primaryIndex];
+  UInt pageIndex, i, n;
+  UInt* tags;
+
+  for (pageIndex = 0; pageIndex < TAG_PAGES_PER_SECONDARY; pageIndex++) {
+    if (sec->dense[pageIndex]) {
+      tags = sec->dense[pageIndex];
+      n = TAG_PAGE_SIZE;
+    }
+    else if (sec->words[pageIndex]) {
+      tags = sec->words[pageIndex];
+      n = TAG_WORDS_PER_PAGE;
+    }
+    else {
+      tags = &sec->uniform[pageIndex];
+      n = 1;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (tags[i] && (tags[i] <= LARGEST_REAL_TAG)) {
+        tags[i] = remap_stale_tag(tags[i]);
+      }
+    }
+
+    compact_tag_page(sec, pageIndex);
+  }
+
+  stale_tag_map[primaryIndex] = NULL;
+  primary_tag_map[primaryIndex] = sec;
+  n_stale_tag_secondaries--;
+  return sec;
+}
+
+// Called by get_tag_secondary() when there is no secondary for a in
+// primary_tag_map, in case it is stale
+TagSecondary* revive_stale_tag_secondary(Addr a) {
+  if (stale_tag_map[PM_IDX(a)]) {
+    return revive_stale_secondary(PM_IDX(a));
+  }
+  return NULL;
+}
+
+// Renumber and put back (up to) n stale secondaries
+void remap_stale_tag_secondaries(UInt n) {
+  // Everything before stale_tag_cursor has already been put back, so
+  // if any stale secondaries are left, there is one after it
+  while (n_stale_tag_secondaries && n) {
+    tl_assert(stale_tag_cursor < PRIMARY_SIZE);
+    if (stale_tag_map[stale_tag_cursor]) {
+      revive_stale_secondary(stale_tag_cursor);
+      n--;
+    }
+    stale_tag_cursor++;
+  }
+}
+
+// Make room for (and clear) entries [0, nextTag] in g_oldToNewMap
+// (and g_oldLeaderMap for incremental collections)
+static void prepare_remap_maps(void) {
+  UInt needed = nextTag + 1;
+
+  if (needed > g_remapMapSize) {
+    // Grow by at least half again so that we don't have to do this at
+    // every collection while the live tag count is creeping up
+    UInt newSize = g_remapMapSize + (g_remapMapSize / 2);
+    if (newSize < needed) {
+      newSize = needed;
+    }
+
+    if (g_oldToNewMap) {
+      VG_(free)(g_oldToNewMap);
+    }
+    if (g_oldLeaderMap) {
+      VG_(free)(g_oldLeaderMap);
+      g_oldLeaderMap = 0;
+    }
+    g_oldToNewMap = VG_(calloc)("dyncomp_runtime.c: garbage_collect_tags.1 ", newSize, sizeof(*g_oldToNewMap));
+    g_remapMapSize = newSize;
+  }
+  else {
+    VG_(memset)(g_oldToNewMap, 0, needed * sizeof(*g_oldToNewMap));
+  }
+
+  if (dyncomp_gc_incremental && !g_oldLeaderMap) {
+    g_oldLeaderMap = VG_(malloc)("dyncomp_runtime.c: garbage_collect_tags.2 ", g_remapMapSize * sizeof(*g_oldLeaderMap));
+  }
+}
+
+void print_garbage_collector_stats(void) {
+  if (gc_num_runs) {
+    printf("DynComp garbage collector: %u runs, %llu ms total pause, %u ms longest pause\n",
+           gc_num_runs, gc_total_pause_ms, gc_longest_pause_ms);
+  }
+}
 
 // Runs the tag garbage collector
 void garbage_collect_tags() {
-  UInt primaryIndex, secondaryIndex;
+  UInt primaryIndex;
   FuncIterator* funcIt;
   ThreadId currentTID;
   UInt curTag, i;
@@ -1077,14 +1248,22 @@ void garbage_collect_tags() {
   // values in oldToNewMap)
   UInt newTagNumber = 1;
 
-  if (g_oldToNewMap) {
-    VG_(free)(g_oldToNewMap);
-  }
-  g_oldToNewMap = VG_(calloc)("dyncomp_runtime.c: garbage_collect_tags.1 ", (nextTag + 1), sizeof(*g_oldToNewMap));
+  UInt pauseStart = VG_(read_millisecond_timer)();
+  UInt pause;
+  ULong profileStart = kvasir_profile_start();
 
   printf("  Start garbage collecting (next tag = %u, total assigned = %u)\n",
               nextTag, totalNumTagsAssigned);
 
+  // Secondaries left over from the last incremental collection are
+  // still numbered according to g_oldLeaderMap/g_oldToNewMap, so they
+  // have to be finished before those get overwritten
+  if (n_stale_tag_secondaries) {
+    remap_stale_tag_secondaries(n_stale_tag_secondaries);
+  }
+
+  prepare_remap_maps();
+
   //debug_print_decls();
   //dump_all_function_exit_var_map();
 
@@ -1125,20 +1304,39 @@ void garbage_collect_tags() {
 
 
   // 1.) Shadow memory:
-  for (primaryIndex = 0; primaryIndex < PRIMARY_SIZE; primaryIndex++) {
-    if (primary_tag_map[primaryIndex]) {
-      //printf("  primary address: %lx\n", ((Addr)primaryIndex) << SECONDARY_SHIFT);
-      for (secondaryIndex = 0; secondaryIndex < SECONDARY_SIZE; secondaryIndex++) {
-        addr = &primary_tag_map[primaryIndex][secondaryIndex];
-
-        if (*addr) { // Remember to ignore 0 tags
-          reassign_tag(addr,
-                       val_uf_find_leader(*addr),
-                       &newTagNumber);
-        }
+  // Each page of a secondary is held in only one of its three forms,
+  // so renumber whichever one is present.  Renumbering usually merges
+  // many old tags into the same new one, so afterwards try to move
+  // each page to a coarser form to give back memory.  Secondaries
+  // above the range of primary_tag_map are in high_tag_map.
+  //
+  // For an incremental collection, just remember the leader of every
+  // old tag for now; the secondaries in primary_tag_map get renumbered
+  // later, a few at a time (see stale_tag_map).
+  if (dyncomp_gc_incremental) {
+    for (curTag = 1; curTag < nextTag; curTag++) {
+      g_oldLeaderMap[curTag] = val_uf_find_leader(curTag);
+    }
+  }
+  else {
+    for (primaryIndex = 0; primaryIndex < PRIMARY_SIZE; primaryIndex++) {
+      if (primary_tag_map[primaryIndex]) {
+        //printf("  primary address: %lx\n", ((Addr)primaryIndex) << SECONDARY_SHIFT);
+        reassign_tags_in_secondary(primary_tag_map[primaryIndex],
+                                   &newTagNumber);
       }
     }
   }
+#if VG_WORDSIZE == 8
+  for (i = 0; i < high_tag_map_size; i++) {
+    if (high_tag_map[i].sec) {
+      reassign_tags_in_secondary(high_tag_map[i].sec, &newTagNumber);
+    }
+  }
+#endif
+
+  DYNCOMP_DPRINTF("  Tag pages after compaction: %u dense, %u per-word\n",
+                  n_dense_tag_pages, n_word_tag_pages);
 
   // 2.) Per program point:
 
@@ -1194,25 +1392,25 @@ void garbage_collect_tags() {
     // We now need to rebuild the var_uf_map(s) to reflect the updated values.
     if (dyncomp_separate_entry_exit) {
       if (cur_entry->ppt_entry_var_uf_map) {
-        struct genhashtable* new_entry_map =
+        VarUFMap* new_entry_map =
             regenerate_var_uf_map(cur_entry->num_entry_daikon_vars,
                                   cur_entry->ppt_entry_var_tags,
                                   cur_entry->ppt_entry_var_uf_map,
                                   &newTagNumber);
         // free the old map and switch to the new map.
-        genfreehashtableandvalues(cur_entry->ppt_entry_var_uf_map);
+        var_uf_map_free(cur_entry->ppt_entry_var_uf_map);
         cur_entry->ppt_entry_var_uf_map = new_entry_map;
       }
     }
 
     if (cur_entry->ppt_exit_var_uf_map) {
-      struct genhashtable* new_exit_map =
+      VarUFMap* new_exit_map =
           regenerate_var_uf_map(cur_entry->num_exit_daikon_vars,
                                 cur_entry->ppt_exit_var_tags,
                                 cur_entry->ppt_exit_var_uf_map,
                                 &newTagNumber);
       // free the old map and switch to the new map.
-      genfreehashtableandvalues(cur_entry->ppt_exit_var_uf_map);
+      var_uf_map_free(cur_entry->ppt_exit_var_uf_map);
       cur_entry->ppt_exit_var_uf_map = new_exit_map;
     }
 
@@ -1264,9 +1462,38 @@ void garbage_collect_tags() {
   // the garbage collection.
   nextTag = newTagNumber;
 
+  // For an incremental collection, take all of the not yet renumbered
+  // secondaries out of primary_tag_map.  (Their tags will get new
+  // numbers starting from nextTag as they are renumbered.)
+  if (dyncomp_gc_incremental) {
+    if (!stale_tag_map) {
+      stale_tag_map = VG_(calloc)("dyncomp_runtime.c: garbage_collect_tags.3 ", PRIMARY_SIZE, sizeof(*stale_tag_map));
+    }
+    for (primaryIndex = 0; primaryIndex < PRIMARY_SIZE; primaryIndex++) {
+      if (primary_tag_map[primaryIndex]) {
+        stale_tag_map[primaryIndex] = primary_tag_map[primaryIndex];
+        primary_tag_map[primaryIndex] = NULL;
+        n_stale_tag_secondaries++;
+      }
+    }
+    stale_tag_cursor = 0;
+  }
+
   printf("   Done garbage collecting (next tag = %u, total assigned = %u)\n",
               nextTag, totalNumTagsAssigned);
 
+  pause = VG_(read_millisecond_timer)() - pauseStart;
+  gc_num_runs++;
+  gc_total_pause_ms += pause;
+  if (pause > gc_longest_pause_ms) {
+    gc_longest_pause_ms = pause;
+  }
+  DYNCOMP_DPRINTF("  Garbage collection pause: %u ms (%u secondaries left to renumber)\n",
+                  pause, n_stale_tag_secondaries);
+  // The tags that literal sites were holding on to have been renumbered
+  DC_new_literal_tag_epoch();
+  kvasir_profile_add_gc(profileStart);
+
   //debug_print_decls();
   //dump_all_function_exit_var_map();
 }
@@ -1408,16 +1635,92 @@ void mark(UChar* bitarray, UInt n, UInt i, UInt j) {
   bitarray[bitarray_base] |= mask;
 }
 
-// Runs the O(n^2) detailed algorithm to update bitmatrix with X's in
-// the appropriate spots to denote variable comparability based on the
-// leader tags held in new_tag_leaders:
+// A Daikon variable and the leader tag of its value at one program
+// point execution.  Sorting these by leader puts the variables which
+// are comparable at that execution next to each other.
+typedef struct {
+  UInt leader;
+  UInt var;
+} LeaderVar;
+
+static Int compareLeaderVars(const void* a, const void* b) {
+  const LeaderVar* x = (const LeaderVar*)a;
+  const LeaderVar* y = (const LeaderVar*)b;
+
+  if (x->leader != y->leader) {
+    return (x->leader < y->leader) ? -1 : 1;
+  }
+  if (x->var != y->var) {
+    return (x->var < y->var) ? -1 : 1;
+  }
+  return 0;
+}
+
+// Scratch space for DC_detailed_mode_process_ppt_execution(), grown
+// to fit the program point with the most variables so far.
+// group_bits has one bit per variable, set for the members of the
+// group being marked, plus a word of padding for or_bit_range().
+static LeaderVar* leader_vars = 0;
+static UChar* group_bits = 0;
+static UInt detailed_scratch_size = 0;
+
+// ORs len bits of src, starting at bit src_off, into dst starting at
+// bit dst_off.  Bits are numbered from the least significant bit of
+// the first byte, as in mark(), and src must have a word of padding
+// past its last bit.
+static void or_bit_range(UChar* dst, UInt dst_off,
+                         const UChar* src, UInt src_off, UInt len) {
+  // A bit at a time until dst is at a byte boundary ...
+  while (len && (dst_off & 7)) {
+    dst[dst_off / 8] |= ((src[src_off / 8] >> (src_off % 8)) & 0x1) << (dst_off % 8);
+    dst_off++;
+    src_off++;
+    len--;
+  }
+
+  // ... then a word at a time (x86 and amd64 are little-endian, so
+  // bit k of a word loaded from a byte array is bit k of the array) ...
+  while (len >= 8 * sizeof(UWord)) {
+    const UChar* s = src + (src_off / 8);
+    UInt shift = src_off % 8;
+    UWord bits, old;
+
+    VG_(memcpy)(&bits, s, sizeof(bits));
+    if (shift) {
+      bits = (bits >> shift) | ((UWord)s[sizeof(UWord)] << (8 * sizeof(UWord) - shift));
+    }
+    VG_(memcpy)(&old, dst + (dst_off / 8), sizeof(old));
+    old |= bits;
+    VG_(memcpy)(dst + (dst_off / 8), &old, sizeof(old));
+
+    dst_off += 8 * sizeof(UWord);
+    src_off += 8 * sizeof(UWord);
+    len -= 8 * sizeof(UWord);
+  }
+
+  // ... and whatever is left a bit at a time
+  while (len) {
+    dst[dst_off / 8] |= ((src[src_off / 8] >> (src_off % 8)) & 0x1) << (dst_off % 8);
+    dst_off++;
+    src_off++;
+    len--;
+  }
+}
+
+// Updates bitmatrix with X's in the appropriate spots to denote
+// variable comparability based on the leader tags held in
+// new_tag_leaders.  Rather than comparing all n^2 pairs of leaders,
+// sorts the variables by leader and, for each group of variables with
+// the same leader, ORs the group (as a bit set) into the part of each
+// member's row of bitmatrix that the group spans.
 void DC_detailed_mode_process_ppt_execution(DaikonFunctionEntry* funcPtr,
                                             Bool isEnter) {
   UInt num_daikon_vars;
   UChar* bitmatrix;
   UInt* new_tag_leaders;
+  UInt num_leader_vars = 0;
   UInt i = 0;
-  UInt j = 0;
+  UInt start, end;
 
   tl_assert(dyncomp_detailed_mode);
 
@@ -1439,16 +1742,72 @@ void DC_detailed_mode_process_ppt_execution(DaikonFunctionEntry* funcPtr,
               isEnter ? "ENTER" : "EXIT",
               num_daikon_vars);
 
+  if (num_daikon_vars < 2) {
+    return;
+  }
+
+  if (num_daikon_vars > detailed_scratch_size) {
+    detailed_scratch_size = num_daikon_vars;
+    leader_vars = VG_(realloc)("dyncomp_runtime.c: DC_detailed_mode_process_ppt_execution.1",
+                               leader_vars,
+                               detailed_scratch_size * sizeof(*leader_vars));
+    if (group_bits) {
+      VG_(free)(group_bits);
+    }
+    group_bits = VG_(calloc)("dyncomp_runtime.c: DC_detailed_mode_process_ppt_execution.2",
+                             (detailed_scratch_size + 7) / 8 + sizeof(UWord), 1);
+  }
+
+  // DON'T COUNT 0 tags!!!
   for (i = 0; i < num_daikon_vars; i++) {
-    for (j = i + 1; j < num_daikon_vars; j++) {
-      // DON'T COUNT 0 tags!!!
-      if ((new_tag_leaders[i] == new_tag_leaders[j]) &&
-          (new_tag_leaders[i] != 0)) {
-        mark(bitmatrix, num_daikon_vars, i, j);
-        DYNCOMP_DPRINTF("    marked: (%u, %u)\n", i, j);
-        // Sanity-check ... take out for slight performance boost
-        tl_assert(isMarked(bitmatrix, num_daikon_vars, i, j));
-      }
+    if (new_tag_leaders[i] != 0) {
+      leader_vars[num_leader_vars].leader = new_tag_leaders[i];
+      leader_vars[num_leader_vars].var = i;
+      num_leader_vars++;
+    }
+  }
+
+  VG_(ssort)(leader_vars, num_leader_vars, sizeof(*leader_vars),
+             compareLeaderVars);
+
+  for (start = 0; start < num_leader_vars; start = end) {
+    UInt last;
+
+    for (end = start + 1;
+         (end < num_leader_vars) &&
+           (leader_vars[end].leader == leader_vars[start].leader);
+         end++)
+      ;
+
+    if (end - start < 2) {
+      continue;
+    }
+
+    for (i = start; i < end; i++) {
+      UInt v = leader_vars[i].var;
+      group_bits[v / 8] |= (1 << (v % 8));
+    }
+
+    // Row v of bitmatrix holds (v, v + 1) through (v, n - 1), so the
+    // group's bits from the next member up to the last one go into
+    // the row starting at column next
+    last = leader_vars[end - 1].var;
+    for (i = start; i < end - 1; i++) {
+      UInt v = leader_vars[i].var;
+      UInt next = leader_vars[i + 1].var;
+      UInt row = (v * num_daikon_vars) - (((v * v) + v) / 2);
+
+      or_bit_range(bitmatrix, row + (next - v - 1),
+                   group_bits, next, last - next + 1);
+      DYNCOMP_DPRINTF("    marked: (%u, %u..%u)\n", v, next, last);
+    }
+    // Sanity-check ... take out for slight performance boost
+    tl_assert(isMarked(bitmatrix, num_daikon_vars,
+                       leader_vars[start].var, last));
+
+    for (i = start; i < end; i++) {
+      UInt v = leader_vars[i].var;
+      group_bits[v / 8] &= ~(1 << (v % 8));
     }
   }
 }
@@ -76,6 +76,8 @@ void check_whether_to_garbage_collect(void);
 
 void garbage_collect_tags(void);
 
+void print_garbage_collector_stats(void);
+
 // DynComp detailed mode (--dyncomp-detailed-mode):
 UInt bitarraySize(UInt n);
 char isMarked(UChar* bitarray, UInt n, UInt i, UInt j);
@@ -0,0 +1,342 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dyncomp_state.c:
+   Saving and merging the comparability sets of every program point
+   (--dyncomp-save-state and --dyncomp-merge-state).  See
+   dyncomp_state.h.
+*/
+
+#include "../my_libc.h"
+
+#include "dyncomp_state.h"
+#include "dyncomp_runtime.h"
+#include "../GenericHashtable.h"
+
+#include "pub_tool_libcbase.h"
+#include "pub_tool_libcprint.h"
+
+int* g_pptCompNumbers = 0;
+
+// The sets of one program point read in from the
+// --dyncomp-merge-state files (one allocation, which also holds sets
+// and name)
+typedef struct {
+  UInt num_vars;
+  int* sets;
+  HChar* name;  // fjalar_name
+} PptState;
+
+// Map fjalar_name to PptState* (entry and exit program points)
+static struct genhashtable* loaded_entry_states = 0;
+static struct genhashtable* loaded_exit_states = 0;
+
+static FILE* save_fp = 0;
+
+// Returns the leader of v's set
+static UInt find_var_leader(UInt* parent, UInt v) {
+  while (parent[v] != v) {
+    parent[v] = parent[parent[v]];
+    v = parent[v];
+  }
+  return v;
+}
+
+// Merge the partition 'other' of n variables into 'sets' (both numbered
+// from 1 to at most n), so that two variables share a set afterwards
+// if they shared one in either, and renumber the sets of 'sets' in
+// order of first appearance
+static void union_partitions(int* sets, const int* other, UInt n) {
+  UInt* parent;
+  UInt* first;  // first[s] = the first variable in set s (n if none yet)
+  const int* partitions[2];
+  UInt i, k;
+  int next = 1;
+
+  if (n == 0) {
+    return;
+  }
+
+  parent = VG_(malloc)("dyncomp_state.c: union_partitions.1", n * sizeof(*parent));
+  first = VG_(malloc)("dyncomp_state.c: union_partitions.2", (n + 1) * sizeof(*first));
+
+  for (i = 0; i < n; i++) {
+    parent[i] = i;
+  }
+
+  partitions[0] = sets;
+  partitions[1] = other;
+  for (k = 0; k < 2; k++) {
+    for (i = 0; i <= n; i++) {
+      first[i] = n;
+    }
+    for (i = 0; i < n; i++) {
+      UInt s = partitions[k][i];
+      tl_assert((s >= 1) && (s <= n));
+      if (first[s] == n) {
+        first[s] = i;
+      }
+      else {
+        // The leader of a set is always its lowest-numbered variable
+        UInt leader1 = find_var_leader(parent, first[s]);
+        UInt leader2 = find_var_leader(parent, i);
+        if (leader1 < leader2) {
+          parent[leader2] = leader1;
+        }
+        else {
+          parent[leader1] = leader2;
+        }
+      }
+    }
+  }
+
+  // Reuse first[] to hold the new number of each leader's set
+  for (i = 0; i < n; i++) {
+    first[i] = 0;
+  }
+  for (i = 0; i < n; i++) {
+    UInt leader = find_var_leader(parent, i);
+    if (!first[leader]) {
+      first[leader] = next++;
+    }
+    sets[i] = first[leader];
+  }
+
+  VG_(free)(parent);
+  VG_(free)(first);
+}
+
+static void state_file_error(const HChar* filename, UInt lineNum) {
+  printf("\nError: line %u of the --dyncomp-merge-state file \"%s\" is invalid.\n\nExiting.\n\n",
+         lineNum, filename);
+  VG_(exit)(1);
+}
+
+// Parse one line of a --dyncomp-merge-state file and merge it into
+// loaded_entry_states or loaded_exit_states
+static void load_state_line(const HChar* filename, UInt lineNum, HChar* curLine) {
+  struct genhashtable* table;
+  PptState* state;
+  PptState* existing;
+  HChar* p = curLine;
+  HChar* end;
+  UInt n, i;
+
+  if ((*p == '\0') || (*p == '#')) {
+    return;
+  }
+
+  if (VG_(strncmp)(p, "enter ", 6) == 0) {
+    table = loaded_entry_states;
+    p += 6;
+  }
+  else if (VG_(strncmp)(p, "exit ", 5) == 0) {
+    table = loaded_exit_states;
+    p += 5;
+  }
+  else {
+    state_file_error(filename, lineNum);
+    return;
+  }
+
+  n = strtoul(p, &end, 10);
+  if (end == p) {
+    state_file_error(filename, lineNum);
+  }
+  p = end;
+
+  state = VG_(malloc)("dyncomp_state.c: load_state_line",
+                      sizeof(*state) + (n * sizeof(int)) + VG_(strlen)(p) + 1);
+  state->num_vars = n;
+  state->sets = (int*)(state + 1);
+  for (i = 0; i < n; i++) {
+    UInt s = strtoul(p, &end, 10);
+    if ((end == p) || (s < 1) || (s > n)) {
+      state_file_error(filename, lineNum);
+    }
+    state->sets[i] = s;
+    p = end;
+  }
+
+  // The rest of the line (after one space) is the name, which may
+  // itself contain spaces
+  if ((*p != ' ') || (p[1] == '\0')) {
+    state_file_error(filename, lineNum);
+  }
+  state->name = (HChar*)(state->sets + n);
+  VG_(strcpy)(state->name, p + 1);
+
+  existing = gengettable(table, state->name);
+  if (!existing) {
+    genputtable(table, state->name, state);
+    return;
+  }
+
+  if (existing->num_vars == n) {
+    union_partitions(existing->sets, state->sets, n);
+  }
+  else {
+    printf("Warning: program point %s has %u variables in \"%s\" but %u in an earlier --dyncomp-merge-state file, so it is ignored\n",
+           state->name, n, filename, existing->num_vars);
+  }
+  VG_(free)(state);
+}
+
+static void load_state_file(const HChar* filename) {
+  FILE* fp = fopen(filename, "r");
+  SizeT size = 0;
+  SizeT capacity = 4096;
+  SizeT numRead;
+  HChar* buf;
+  HChar* curLine;
+  UInt lineNum = 1;
+
+  if (!fp) {
+    printf("\nError: \"%s\" is an invalid filename for the --dyncomp-merge-state option.\n\nExiting.\n\n",
+           filename);
+    VG_(exit)(1);
+  }
+
+  buf = VG_(malloc)("dyncomp_state.c: load_state_file", capacity);
+  while ((numRead = fread(buf + size, 1, capacity - size - 1, fp)) > 0) {
+    size += numRead;
+    if (size == capacity - 1) {
+      capacity *= 2;
+      buf = VG_(realloc)("dyncomp_state.c: load_state_file", buf, capacity);
+    }
+  }
+  fclose(fp);
+  buf[size] = '\0';
+
+  for (curLine = buf; *curLine; lineNum++) {
+    HChar* next = VG_(strchr)(curLine, '\n');
+    if (next) {
+      *next++ = '\0';
+    }
+    else {
+      next = curLine + VG_(strlen)(curLine);
+    }
+    load_state_line(filename, lineNum, curLine);
+    curLine = next;
+  }
+
+  VG_(free)(buf);
+}
+
+void DC_init_states(void) {
+  if (dyncomp_merge_state_filenames) {
+    HChar* filenames = VG_(strdup)("dyncomp_state.c: DC_init_states",
+                                   dyncomp_merge_state_filenames);
+    HChar* filename = filenames;
+
+    loaded_entry_states =
+      genallocatehashtable((unsigned int (*)(void *)) &hashString,
+                           (int (*)(void *,void *)) &equivalentStrings);
+    loaded_exit_states =
+      genallocatehashtable((unsigned int (*)(void *)) &hashString,
+                           (int (*)(void *,void *)) &equivalentStrings);
+
+    // Comma-separated list of files
+    while (filename) {
+      HChar* comma = VG_(strchr)(filename, ',');
+      if (comma) {
+        *comma = '\0';
+      }
+      if (*filename) {
+        load_state_file(filename);
+      }
+      filename = comma ? (comma + 1) : NULL;
+    }
+    VG_(free)(filenames);
+  }
+
+  if (dyncomp_save_state_filename) {
+    save_fp = fopen(dyncomp_save_state_filename, "w");
+    if (!save_fp) {
+      printf("Couldn't open %s for writing the --dyncomp-save-state file\n",
+             dyncomp_save_state_filename);
+      return;
+    }
+    fputs("# DynComp comparability state\n", save_fp);
+    fputs("# <enter|exit> <number of variables> <set of each variable> <fjalar_name>\n",
+          save_fp);
+  }
+}
+
+void DC_begin_ppt_state(DaikonFunctionEntry* funcPtr, char isEnter) {
+  char useEntry = dyncomp_separate_entry_exit && isEnter;
+  UInt n = useEntry ? funcPtr->num_entry_daikon_vars : funcPtr->num_exit_daikon_vars;
+  HChar* name = funcPtr->funcEntry.fjalar_name;
+  UInt i;
+
+  if (!dyncomp_save_state_filename && !dyncomp_merge_state_filenames) {
+    return;
+  }
+
+  tl_assert(!g_pptCompNumbers);
+
+  // This run's sets, numbered in order of first appearance
+  g_pptCompNumbers = VG_(malloc)("dyncomp_state.c: DC_begin_ppt_state",
+                                 (n ? n : 1) * sizeof(*g_pptCompNumbers));
+  for (i = 0; i < n; i++) {
+    g_pptCompNumbers[i] = DC_get_comp_number_for_var(funcPtr, isEnter, i);
+  }
+
+  if (dyncomp_merge_state_filenames) {
+    PptState* loaded = gengettable(useEntry ? loaded_entry_states : loaded_exit_states,
+                                   name);
+    if (loaded) {
+      if (loaded->num_vars == n) {
+        union_partitions(g_pptCompNumbers, loaded->sets, n);
+      }
+      else {
+        printf("Warning: program point %s has %u variables in --dyncomp-merge-state but %u in this run, so it is not merged\n",
+               name, loaded->num_vars, n);
+      }
+    }
+  }
+
+  // Without --dyncomp-separate-entry-exit, the entry program point
+  // has the same sets as the exit one, which gets saved instead
+  if (save_fp && (useEntry || !isEnter)) {
+    fprintf(save_fp, "%s %u", useEntry ? "enter" : "exit", n);
+    for (i = 0; i < n; i++) {
+      fprintf(save_fp, " %d", g_pptCompNumbers[i]);
+    }
+    fprintf(save_fp, " %s\n", name);
+  }
+}
+
+void DC_end_ppt_state(void) {
+  if (g_pptCompNumbers) {
+    VG_(free)(g_pptCompNumbers);
+    g_pptCompNumbers = 0;
+  }
+}
+
+void DC_finish_states(void) {
+  if (save_fp) {
+    fclose(save_fp);
+    save_fp = 0;
+  }
+
+  // (The names are part of the PptStates, so this frees everything)
+  if (loaded_entry_states) {
+    genfreehashtableandvalues(loaded_entry_states);
+    loaded_entry_states = 0;
+  }
+  if (loaded_exit_states) {
+    genfreehashtableandvalues(loaded_exit_states);
+    loaded_exit_states = 0;
+  }
+}
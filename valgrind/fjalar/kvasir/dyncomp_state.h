@@ -0,0 +1,58 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* dyncomp_state.h:
+   Saving the variable comparability sets of every program point to a
+   file (--dyncomp-save-state=<file>) and merging the sets that other
+   runs of the same program saved into this run's
+   (--dyncomp-merge-state=<file>[,<file>...]).
+
+   Two variables are comparable after merging if they are comparable
+   in any one of the runs (the sets are then made transitive again),
+   so a test suite can be split up between several Kvasir processes
+   that each save their state, and one more run merges all of them to
+   produce the .decls file.  A merging run can itself save the merged
+   state.
+
+   A state file has one line per program point:
+
+     <enter|exit> <number of variables> <set of each variable> <fjalar_name>
+
+   where the sets of the variables (in .decls order) are numbered from
+   1 in order of first appearance.  Entry program points only get
+   lines of their own with --dyncomp-separate-entry-exit; otherwise
+   they share the sets of the exit program point.
+*/
+
+#ifndef DYNCOMP_STATE_H
+#define DYNCOMP_STATE_H
+
+#include "kvasir_main.h"
+
+// The comparability numbers of the variables of the program point
+// being printed to the .decls file, if they came from
+// DC_begin_ppt_state() (NULL otherwise)
+extern int* g_pptCompNumbers;
+
+// Read in the --dyncomp-merge-state files and open the
+// --dyncomp-save-state file (before the .decls file is printed)
+void DC_init_states(void);
+
+// Work out the (merged) comparability numbers of the variables of a
+// program point, put them in g_pptCompNumbers and save them
+void DC_begin_ppt_state(DaikonFunctionEntry* funcPtr, char isEnter);
+void DC_end_ppt_state(void);
+
+void DC_finish_states(void);
+
+#endif // DYNCOMP_STATE_H
@@ -40,6 +40,11 @@
 extern char dyncomp_profile_tags;
 static
 IRAtom* expr2tags_LDle_DC ( DCEnv* dce, IRType ty, IRAtom* addr, UInt bias );
+static Bool use_inline_tag_paths_DC ( void );
+static IRAtom* mkMergeTags_DC ( DCEnv* dce, IRAtom* vatom1, IRAtom* vatom2 );
+static IRAtom* mkOr1_DC ( DCEnv* dce, IRAtom* b1, IRAtom* b2 );
+static IRAtom* mkMergeTagsReturn0_DC ( DCEnv* dce, IRAtom* vatom1,
+                                       IRAtom* vatom2 );
 
 /* Find the tmp currently shadowing the given original tmp.  If none
    so far exists, allocate one.  */
@@ -256,8 +261,6 @@ IRAtom* handleCCall_DC ( DCEnv* dce,
       IRAtom* first = expr2tags_DC(dce, exprvec[0]);
       Int i;
       IRAtom* cur;
-      IRDirty* di;
-      IRTemp   datatag;
 
       for (i = 1; exprvec[i]; i++) {
          tl_assert(i < 32);
@@ -275,15 +278,7 @@ IRAtom* handleCCall_DC ( DCEnv* dce,
             // (comment added 2006)  
             // TODO: Why is this dirty rather than clean? - pgbovine
             //       Because it has side effects? - smcc
-            datatag = newTemp(dce->mce, Ity_Word, DC);
-            di = unsafeIRDirty_1_N(datatag,
-                                   2,
-                                   "MC_(helperc_MERGE_TAGS_RETURN_0)",
-                                   &MC_(helperc_MERGE_TAGS_RETURN_0),
-                                   mkIRExprVec_2( first, cur ));
-
-            setHelperAnns_DC( dce, di );
-            stmt_DC('V', dce, IRStmt_Dirty(di));
+            mkMergeTagsReturn0_DC(dce, first, cur);
          }
       }
       // Return the tag of the first argument, if there is one
@@ -368,20 +363,14 @@ IRAtom* expr2tags_Qop_DC ( DCEnv* dce,
          // If we are running in units mode, then we should merge the
          // tags of the 3rd and 4th operands:
          if (dyncomp_units_mode) {
-            return mkIRExprCCall (Ity_Word,
-                                  2 /*Int regparms*/,
-                                  "MC_(helperc_MERGE_TAGS)",
-                                  &MC_(helperc_MERGE_TAGS),
-                                  mkIRExprVec_2( vatom3, vatom4 ));
+            return mkMergeTags_DC(dce, vatom3, vatom4);
          }
          // Ok, if we are running in the default mode, then we should
          // merge the tags of the 2nd, 3rd, and 4th operands:
          else {
-            return mkIRExprCCall (Ity_Word,
-                                  3 /*Int regparms*/,
-                                  "MC_(helperc_MERGE_3_TAGS)",
-                                  &MC_(helperc_MERGE_3_TAGS),
-                                  mkIRExprVec_3( vatom2, vatom3, vatom4 ));
+            return mkMergeTags_DC(dce,
+                                  mkMergeTags_DC(dce, vatom2, vatom3),
+                                  vatom4);
          }
          break;
 
@@ -451,16 +440,11 @@ IRAtom* expr2tags_Triop_DC ( DCEnv* dce,
       case Iop_AddD128:                     // only used by ppc s390
       case Iop_SubD128:                     // only used by ppc s390
 
-         return mkIRExprCCall (Ity_Word,
-                               2 /*Int regparms*/,
-                               "MC_(helperc_MERGE_TAGS)",
-                               &MC_(helperc_MERGE_TAGS),
-                               // VERY IMPORTANT!!!  We want to merge the
-                               // tags of the 2nd and 3rd operands!!!
-                               // Because the first one is a rounding
-                               // mode (I think)
-                               /* I32(rm) x F64 x F64 -> F64 */
-                               mkIRExprVec_2( vatom2, vatom3 ));
+         // VERY IMPORTANT!!!  We want to merge the tags of the 2nd
+         // and 3rd operands!!!  Because the first one is a rounding
+         // mode (I think)
+         /* I32(rm) x F64 x F64 -> F64 */
+         return mkMergeTags_DC(dce, vatom2, vatom3);
 
       case Iop_MulF32:                      // only used by arm mips s390 arm64
       case Iop_DivF32:                      // only used by arm mips s390 arm64
@@ -477,16 +461,11 @@ IRAtom* expr2tags_Triop_DC ( DCEnv* dce,
 
 
          if (!dyncomp_units_mode) {
-            return mkIRExprCCall (Ity_Word,
-                                  2 /*Int regparms*/,
-                                  "MC_(helperc_MERGE_TAGS)",
-                                  &MC_(helperc_MERGE_TAGS),
-                                  // VERY IMPORTANT!!!  We want to merge the
-                                  // tags of the 2nd and 3rd operands!!!
-                                  // Because the first one is a rounding
-                                  // mode (I think)
-                                  /* I32(rm) x F64 x F64 -> F64 */
-                                  mkIRExprVec_2( vatom2, vatom3 ));
+            // VERY IMPORTANT!!!  We want to merge the tags of the 2nd
+            // and 3rd operands!!!  Because the first one is a
+            // rounding mode (I think)
+            /* I32(rm) x F64 x F64 -> F64 */
+            return mkMergeTags_DC(dce, vatom2, vatom3);
          }
          // Else fall through ...
          break;
@@ -1564,6 +1543,15 @@ IRAtom* expr2tags_Binop_DC ( DCEnv* dce,
       // DO NOT use clean call unless it has NO side effects and
       // is (nearly) purely functional like an IRExpr
       // (from the point-of-view of IR, at least)
+      // (With --dyncomp-inline-tags, these are inline merges instead;
+      //  see mkMergeTags_DC.)
+      if (helper == &MC_(helperc_MERGE_TAGS)) {
+         return mkMergeTags_DC(dce, vatom1, vatom2);
+      }
+      else if (helper == &MC_(helperc_MERGE_TAGS_RETURN_0) &&
+               use_inline_tag_paths_DC()) {
+         return mkMergeTagsReturn0_DC(dce, vatom1, vatom2);
+      }
       return mkIRExprCCall (Ity_Word,
                             2 /*Int regparms*/,
                             hname,
@@ -1986,6 +1974,634 @@ IRExpr* expr2tags_Unop_DC ( DCEnv* dce, IRAtom* atom )
    case Iop_ZeroHI96ofV128:              // only used by arm64 
  */
 
+/*------------------------------------------------------------*/
+/*--- Inline fast paths for tag loads and stores           ---*/
+/*------------------------------------------------------------*/
+
+/* Most guest memory accesses touch bytes that already have a tag
+   secondary and that all carry the same (real) tag, so calling
+   MC_(helperc_LOAD_TAG_*) / MC_(helperc_STORE_TAG_*) for every access
+   just to read or write an array element is wasteful.  Instead, we
+   emit IR which indexes primary_tag_map directly and only falls back
+   to the (guarded) dirty helper when:
+
+     - the address is beyond the range of primary_tag_map,
+     - the secondary tag map has not been allocated yet,
+     - the page holding the address can't take the access without
+       changing form: a store which doesn't cover whole words to a
+       per-word page, or a store of any tag but the page's own to a
+       uniform page,
+     - the access is not naturally aligned (so it might straddle two
+       pages),
+     - the bytes being loaded do not all have the same tag, or
+     - the tag is WEAK_FRESH_TAG or LAZY_FRESH_TAG (which need a
+       fresh tag).
+
+   The fast load returns the raw tag rather than its leader, and the
+   fast store writes the raw tag rather than its leader.  That is
+   harmless because every consumer of a tag either merges it (which
+   operates on sets) or canonicalizes it with val_uf_find_leader().
+
+   When the fast path is not taken, the inline address computation is
+   pointed at dc_empty_tag_secondary or dc_tag_sink so that the IR
+   never dereferences a NULL secondary or page. */
+
+// Stands in for a missing secondary (which never takes the fast path)
+static TagSecondary dc_empty_tag_secondary;
+
+// Turn the inline paths off when we are going to print traces, since
+// the helpers are what do the printing.
+static Bool use_inline_tag_paths_DC ( void )
+{
+#ifdef MAX_DEBUG_INFO
+   return False;
+#else
+   return dyncomp_inline_tags &&
+          !dyncomp_print_trace_info &&
+          !dyncomp_print_trace_all &&
+          !dyncomp_delayed_trace;
+#endif
+}
+
+// Like assignNew_DC, but for temps that are not tags (and thus not
+// necessarily word-sized)
+static IRAtom* assignNewTyped_DC ( DCEnv* dce, IRType ty, IRExpr* e ) {
+   IRTemp t = newTemp(dce->mce, ty, DC);
+   assign_DC('V', dce, t, e);
+   return mkexpr(t);
+}
+
+// There is no Iop_And1, so go through Ity_I32
+static IRAtom* mkAnd1_DC ( DCEnv* dce, IRAtom* b1, IRAtom* b2 ) {
+   IRAtom* w1 = assignNewTyped_DC(dce, Ity_I32, unop(Iop_1Uto32, b1));
+   IRAtom* w2 = assignNewTyped_DC(dce, Ity_I32, unop(Iop_1Uto32, b2));
+   IRAtom* w  = assignNewTyped_DC(dce, Ity_I32, binop(Iop_And32, w1, w2));
+   return assignNewTyped_DC(dce, Ity_I1, binop(Iop_CmpNE32, w, mkU32(0)));
+}
+
+static IRAtom* mkUWord_DC ( DCEnv* dce, HWord n ) {
+   return dce->hWordTy == Ity_I32 ? mkU32((UInt)n) : mkU64((ULong)n);
+}
+
+/* The IR atoms describing the tag page that holds a guest address
+   (see mkTagPage_DC) */
+typedef struct {
+   IRAtom* ok;          // Ity_I1: the secondary is present (and in
+                        // primary_tag_map) and the access is aligned
+   IRAtom* isDense;     // Ity_I1: the page is dense
+   IRAtom* isWords;     // Ity_I1: the page is per-word
+   IRAtom* isUniform;   // Ity_I1: the page is uniform
+   IRAtom* denseSlot;   // &dense[off] if ok and dense, else dc_tag_sink
+   IRAtom* wordSlot;    // &words[off >> TAG_WORD_SHIFT] if ok and
+                        // per-word, else dc_tag_sink
+   IRAtom* uniformTag;  // Ity_I32: uniform[p] (only meaningful if the
+                        // page is uniform)
+} DCTagPage;
+
+/* Emit IR which finds the tag page for the szB-byte access at the
+   guest address 'addr', and fill in *tp. */
+static void mkTagPage_DC ( DCEnv* dce, IRAtom* addr, UInt szB,
+                           DCTagPage* tp )
+{
+   IRType  tyW  = dce->hWordTy;
+   Bool    is64 = (tyW == Ity_I64);
+   UInt    ptrShift = is64 ? 3 : 2;
+   IROp    opAdd   = is64 ? Iop_Add64   : Iop_Add32;
+   IROp    opAnd   = is64 ? Iop_And64   : Iop_And32;
+   IROp    opShl   = is64 ? Iop_Shl64   : Iop_Shl32;
+   IROp    opShr   = is64 ? Iop_Shr64   : Iop_Shr32;
+   IROp    opCmpEQ = is64 ? Iop_CmpEQ64 : Iop_CmpEQ32;
+   IROp    opCmpNE = is64 ? Iop_CmpNE64 : Iop_CmpNE32;
+   IRAtom *pmIdx, *pmOffB, *pmSlot, *secondary, *present, *ok;
+   IRAtom *pageIdx, *pageOffB, *a, *dense, *words, *hasDense, *hasWords;
+   IRAtom *noDense, *pgOff, *slot;
+
+   tl_assert(tyW == Ity_I32 || tyW == Ity_I64);
+   tl_assert(szB == 1 || szB == 2 || szB == 4 || szB == 8);
+
+   pmIdx = assignNewTyped_DC(dce, tyW,
+                             binop(opShr, addr, mkU8(SECONDARY_SHIFT)));
+   ok = NULL;
+   if (is64) {
+      // primary_tag_map only covers part of the 64-bit address space
+      IRAtom* inRange =
+         assignNewTyped_DC(dce, Ity_I1,
+                           binop(Iop_CmpLT64U, pmIdx, mkU64(PRIMARY_SIZE)));
+      pmIdx = assignNewTyped_DC(dce, tyW,
+                                IRExpr_ITE(inRange, pmIdx, mkU64(0)));
+      ok = inRange;
+   }
+
+   pmOffB = assignNewTyped_DC(dce, tyW,
+                              binop(opShl, pmIdx, mkU8(ptrShift)));
+   pmSlot = assignNewTyped_DC(dce, tyW,
+                              binop(opAdd,
+                                    mkUWord_DC(dce, (HWord)&primary_tag_map[0]),
+                                    pmOffB));
+   secondary = assignNewTyped_DC(dce, tyW, IRExpr_Load(Iend_LE, tyW, pmSlot));
+
+   // A missing secondary might still be a stale one which the
+   // incremental garbage collector has to renumber first, so leave it
+   // to the helpers.
+   present   = assignNewTyped_DC(dce, Ity_I1,
+                                 binop(opCmpNE, secondary, mkUWord_DC(dce, 0)));
+   ok = ok ? mkAnd1_DC(dce, ok, present) : present;
+   secondary = assignNewTyped_DC(dce, tyW,
+                                 IRExpr_ITE(present, secondary,
+                                            mkUWord_DC(dce, (HWord)&dc_empty_tag_secondary)));
+
+   // p = TAG_PAGE_IDX(addr)
+   pageIdx  = assignNewTyped_DC(dce, tyW,
+                                binop(opShr, addr, mkU8(TAG_PAGE_SHIFT)));
+   pageIdx  = assignNewTyped_DC(dce, tyW,
+                                binop(opAnd, pageIdx,
+                                      mkUWord_DC(dce, TAG_PAGES_PER_SECONDARY - 1)));
+   pageOffB = assignNewTyped_DC(dce, tyW,
+                                binop(opShl, pageIdx, mkU8(ptrShift)));
+
+   // dense = secondary->dense[p]
+   a     = assignNewTyped_DC(dce, tyW,
+                             binop(opAdd, secondary,
+                                   mkUWord_DC(dce, offsetof(TagSecondary, dense))));
+   a     = assignNewTyped_DC(dce, tyW, binop(opAdd, a, pageOffB));
+   dense = assignNewTyped_DC(dce, tyW, IRExpr_Load(Iend_LE, tyW, a));
+
+   // words = secondary->words[p]
+   a     = assignNewTyped_DC(dce, tyW,
+                             binop(opAdd, secondary,
+                                   mkUWord_DC(dce, offsetof(TagSecondary, words))));
+   a     = assignNewTyped_DC(dce, tyW, binop(opAdd, a, pageOffB));
+   words = assignNewTyped_DC(dce, tyW, IRExpr_Load(Iend_LE, tyW, a));
+
+   // uniformTag = secondary->uniform[p]
+   a = assignNewTyped_DC(dce, tyW,
+                         binop(opAdd, secondary,
+                               mkUWord_DC(dce, offsetof(TagSecondary, uniform))));
+   a = assignNewTyped_DC(dce, tyW,
+                         binop(opAdd, a,
+                               assignNewTyped_DC(dce, tyW,
+                                                 binop(opShl, pageIdx,
+                                                       mkU8(2 /* sizeof(UInt) == 4 */)))));
+   tp->uniformTag = assignNewTyped_DC(dce, Ity_I32,
+                                      IRExpr_Load(Iend_LE, Ity_I32, a));
+
+   hasDense = assignNewTyped_DC(dce, Ity_I1,
+                                binop(opCmpNE, dense, mkUWord_DC(dce, 0)));
+   hasWords = assignNewTyped_DC(dce, Ity_I1,
+                                binop(opCmpNE, words, mkUWord_DC(dce, 0)));
+   noDense  = assignNewTyped_DC(dce, Ity_I1, unop(Iop_Not1, hasDense));
+   tp->isDense   = hasDense;
+   tp->isWords   = mkAnd1_DC(dce, noDense, hasWords);
+   tp->isUniform = mkAnd1_DC(dce, noDense,
+                             assignNewTyped_DC(dce, Ity_I1,
+                                               unop(Iop_Not1, hasWords)));
+
+   if (szB > 1) {
+      IRAtom* misalign =
+         assignNewTyped_DC(dce, tyW,
+                           binop(opAnd, addr, mkUWord_DC(dce, szB - 1)));
+      IRAtom* aligned =
+         assignNewTyped_DC(dce, Ity_I1,
+                           binop(opCmpEQ, misalign, mkUWord_DC(dce, 0)));
+      ok = mkAnd1_DC(dce, ok, aligned);
+   }
+   tp->ok = ok;
+
+   pgOff = assignNewTyped_DC(dce, tyW,
+                             binop(opAnd, addr,
+                                   mkUWord_DC(dce, TAG_PAGE_MASK)));
+
+   // &dense[pgOff]
+   slot = assignNewTyped_DC(dce, tyW,
+                            binop(opShl, pgOff,
+                                  mkU8(2 /* sizeof(UInt) == 4 */)));
+   slot = assignNewTyped_DC(dce, tyW, binop(opAdd, dense, slot));
+   tp->denseSlot =
+      assignNewTyped_DC(dce, tyW,
+                        IRExpr_ITE(mkAnd1_DC(dce, ok, tp->isDense), slot,
+                                   mkUWord_DC(dce, (HWord)&dc_tag_sink[0])));
+
+   // &words[pgOff >> TAG_WORD_SHIFT], which is at byte offset
+   // (pgOff >> TAG_WORD_SHIFT) * sizeof(UInt), i.e. pgOff rounded down
+   // to a multiple of TAG_WORD_SIZE (== sizeof(UInt))
+   slot = assignNewTyped_DC(dce, tyW,
+                            binop(opAnd, pgOff,
+                                  mkUWord_DC(dce, ~(HWord)(TAG_WORD_SIZE - 1))));
+   slot = assignNewTyped_DC(dce, tyW, binop(opAdd, words, slot));
+   tp->wordSlot =
+      assignNewTyped_DC(dce, tyW,
+                        IRExpr_ITE(mkAnd1_DC(dce, ok, tp->isWords), slot,
+                                   mkUWord_DC(dce, (HWord)&dc_tag_sink[0])));
+}
+
+/* Inline version of a szB-byte tag load at addrAct; hname/helper is
+   the LOAD_TAG helper to call when the fast path does not apply. */
+static
+IRAtom* expr2tags_LDle_inline_DC ( DCEnv* dce, UInt szB, IRAtom* addrAct,
+                                   const HChar* hname, void* helper )
+{
+   IRType   tyW = dce->hWordTy;
+   IRAtom  *denseTag, *denseSame, *wordTag, *wordSame, *tag;
+   IRAtom  *notSpecial, *fast, *slow, *tagW;
+   IRDirty* di;
+   IRTemp   datatag;
+   DCTagPage tp;
+
+   mkTagPage_DC(dce, addrAct, szB, &tp);
+
+   // Dense page: one tag per byte
+   if (szB == 1) {
+      denseTag = assignNewTyped_DC(dce, Ity_I32,
+                                   IRExpr_Load(Iend_LE, Ity_I32, tp.denseSlot));
+      denseSame = NULL;
+   } else {
+      // Read the szB tags two at a time, and check that they are
+      // all identical.
+      IROp    opAdd = tyW == Ity_I64 ? Iop_Add64 : Iop_Add32;
+      IRAtom* w0 = assignNewTyped_DC(dce, Ity_I64,
+                                     IRExpr_Load(Iend_LE, Ity_I64, tp.denseSlot));
+      IRAtom* hi = assignNewTyped_DC(dce, Ity_I32, unop(Iop_64HIto32, w0));
+      UInt    i;
+
+      denseTag = assignNewTyped_DC(dce, Ity_I32, unop(Iop_64to32, w0));
+      denseSame = assignNewTyped_DC(dce, Ity_I1,
+                                    binop(Iop_CmpEQ32, denseTag, hi));
+
+      for (i = 1; i < szB / 2; i++) {
+         IRAtom* a  = assignNewTyped_DC(dce, tyW,
+                                        binop(opAdd, tp.denseSlot,
+                                              mkUWord_DC(dce, 8 * i)));
+         IRAtom* wi = assignNewTyped_DC(dce, Ity_I64,
+                                        IRExpr_Load(Iend_LE, Ity_I64, a));
+         IRAtom* eq = assignNewTyped_DC(dce, Ity_I1,
+                                        binop(Iop_CmpEQ64, w0, wi));
+         denseSame = mkAnd1_DC(dce, denseSame, eq);
+      }
+   }
+
+   // Per-word page: an aligned access of up to 4 bytes lies within
+   // one word, and an aligned 8-byte one covers two words which must
+   // have the same tag.
+   if (szB == 8) {
+      IRAtom* w = assignNewTyped_DC(dce, Ity_I64,
+                                    IRExpr_Load(Iend_LE, Ity_I64, tp.wordSlot));
+      wordTag  = assignNewTyped_DC(dce, Ity_I32, unop(Iop_64to32, w));
+      wordSame = assignNewTyped_DC(dce, Ity_I1,
+                                   binop(Iop_CmpEQ32, wordTag,
+                                         assignNewTyped_DC(dce, Ity_I32,
+                                                           unop(Iop_64HIto32, w))));
+   } else {
+      wordTag  = assignNewTyped_DC(dce, Ity_I32,
+                                   IRExpr_Load(Iend_LE, Ity_I32, tp.wordSlot));
+      wordSame = NULL;
+   }
+
+   // Uniform page: uniform[p]
+   tag = assignNewTyped_DC(dce, Ity_I32,
+                           IRExpr_ITE(tp.isWords, wordTag, tp.uniformTag));
+   tag = assignNewTyped_DC(dce, Ity_I32,
+                           IRExpr_ITE(tp.isDense, denseTag, tag));
+
+   // Both special tags are above LARGEST_REAL_TAG
+   notSpecial = assignNewTyped_DC(dce, Ity_I1,
+                               binop(Iop_CmpLT32U, tag,
+                                     mkU32(LARGEST_REAL_TAG + 1)));
+   fast = mkAnd1_DC(dce, tp.ok, notSpecial);
+   if (denseSame) {
+      fast = mkAnd1_DC(dce, fast,
+                       mkOr1_DC(dce,
+                                assignNewTyped_DC(dce, Ity_I1,
+                                                  unop(Iop_Not1, tp.isDense)),
+                                denseSame));
+   }
+   if (wordSame) {
+      fast = mkAnd1_DC(dce, fast,
+                       mkOr1_DC(dce,
+                                assignNewTyped_DC(dce, Ity_I1,
+                                                  unop(Iop_Not1, tp.isWords)),
+                                wordSame));
+   }
+   slow = assignNewTyped_DC(dce, Ity_I1, unop(Iop_Not1, fast));
+
+   datatag = newTemp(dce->mce, Ity_Word, DC);
+   di = unsafeIRDirty_1_N( datatag,
+                           1/*regparms*/, hname, helper,
+                           mkIRExprVec_1( addrAct ));
+   di->guard = slow;
+   setHelperAnns_DC( dce, di );
+   stmt_DC('V',  dce, IRStmt_Dirty(di) );
+
+   tagW = (tyW == Ity_I64)
+      ? assignNewTyped_DC(dce, Ity_I64, unop(Iop_32Uto64, tag))
+      : tag;
+   return assignNew_DC(dce, Ity_Word, IRExpr_ITE(fast, tagW, mkexpr(datatag)));
+}
+
+/* Inline version of a szB-byte tag store of vdata at addr; falls
+   back to the STORE_TAG helper hname/helper. */
+static
+void do_shadow_STle_inline_DC ( DCEnv* dce, UInt szB,
+                                IRAtom* addr, IRAtom* vdata,
+                                Int regparms, const HChar* hname, void* helper )
+{
+   IRType   tyW = dce->hWordTy;
+   IROp     opAdd = tyW == Ity_I64 ? Iop_Add64 : Iop_Add32;
+   IRAtom  *tag, *notWeak, *fast, *slow, *dst, *pair, *sameUniform;
+   IRDirty* di;
+   UInt     i;
+   DCTagPage tp;
+
+   mkTagPage_DC(dce, addr, szB, &tp);
+
+   tag = (tyW == Ity_I64)
+      ? assignNewTyped_DC(dce, Ity_I32, unop(Iop_64to32, vdata))
+      : vdata;
+   notWeak = assignNewTyped_DC(dce, Ity_I1,
+                               binop(Iop_CmpNE32, tag, mkU32(WEAK_FRESH_TAG)));
+   pair = (szB > 1)
+      ? assignNewTyped_DC(dce, Ity_I64, binop(Iop_32HLto64, tag, tag))
+      : NULL;
+
+   // A dense page can take any aligned store, a per-word page only
+   // whole words, and a uniform page only its own tag (which leaves it
+   // unchanged).
+   sameUniform = mkAnd1_DC(dce, tp.isUniform,
+                           assignNewTyped_DC(dce, Ity_I1,
+                                             binop(Iop_CmpEQ32, tag,
+                                                   tp.uniformTag)));
+   fast = mkOr1_DC(dce, tp.isDense, sameUniform);
+   if (szB >= 4) {
+      fast = mkOr1_DC(dce, fast, tp.isWords);
+   }
+   fast = mkAnd1_DC(dce, mkAnd1_DC(dce, tp.ok, notWeak), fast);
+   slow = assignNewTyped_DC(dce, Ity_I1, unop(Iop_Not1, fast));
+
+   // Redirect the inline stores to dc_tag_sink if we have to go
+   // through the helper.  (tp.denseSlot and tp.wordSlot already point
+   // there unless the page has the right form.)
+   dst = assignNewTyped_DC(dce, tyW,
+                           IRExpr_ITE(notWeak, tp.denseSlot,
+                                      mkUWord_DC(dce, (HWord)&dc_tag_sink[0])));
+
+   if (szB == 1) {
+      stmt_DC('V', dce, IRStmt_Store(Iend_LE, dst, tag));
+   } else {
+      for (i = 0; i < szB / 2; i++) {
+         IRAtom* a = (i == 0) ? dst
+            : assignNewTyped_DC(dce, tyW,
+                                binop(opAdd, dst, mkUWord_DC(dce, 8 * i)));
+         stmt_DC('V', dce, IRStmt_Store(Iend_LE, a, pair));
+      }
+   }
+
+   if (szB >= 4) {
+      dst = assignNewTyped_DC(dce, tyW,
+                              IRExpr_ITE(notWeak, tp.wordSlot,
+                                         mkUWord_DC(dce, (HWord)&dc_tag_sink[0])));
+      stmt_DC('V', dce, IRStmt_Store(Iend_LE, dst,
+                                     szB == 8 ? pair : tag));
+   }
+
+   di = unsafeIRDirty_0_N( regparms, hname, helper,
+                           mkIRExprVec_2( addr, vdata ));
+   di->guard = slow;
+   setHelperAnns_DC( dce, di );
+   stmt_DC('V',  dce, IRStmt_Dirty(di) );
+}
+
+/* Inline tag merges.
+
+   Most merges are trivial: one of the tags is 0 or WEAK_FRESH_TAG,
+   or both are the same tag, and the result is just one of them.
+   mkMergeTags_DC emits IR which handles those cases by itself, and
+   only calls MC_(helperc_MERGE_DISTINCT_TAGS) (which goes straight to
+   the union-find) when two different real tags meet.
+
+   It also remembers the merges that it has emitted in this bb (in
+   dce->merges), and leaves a merge out altogether when:
+
+   - the same two shadow temps have been merged before, in which case
+     the earlier result is reused, or
+   - the tag in one of the temps came out of a chain of merges that
+     the tag in the other one went into, in which case merging them
+     again can't change anything, and the result is the former.
+
+   Sets of tags only ever grow, so an earlier result is still in the
+   right set even if other merges have happened in between. */
+
+// How far back mergedInto_DC follows a chain of merges
+#define DC_MERGE_CHAIN_DEPTH 4
+
+static IRAtom* mkOr1_DC ( DCEnv* dce, IRAtom* b1, IRAtom* b2 ) {
+   IRAtom* w1 = assignNewTyped_DC(dce, Ity_I32, unop(Iop_1Uto32, b1));
+   IRAtom* w2 = assignNewTyped_DC(dce, Ity_I32, unop(Iop_1Uto32, b2));
+   IRAtom* w  = assignNewTyped_DC(dce, Ity_I32, binop(Iop_Or32, w1, w2));
+   return assignNewTyped_DC(dce, Ity_I1, binop(Iop_CmpNE32, w, mkU32(0)));
+}
+
+static Bool isZeroTagConst_DC ( IRAtom* a )
+{
+   if (a->tag != Iex_Const)
+      return False;
+   switch (a->Iex.Const.con->tag) {
+      case Ico_U32: return a->Iex.Const.con->Ico.U32 == 0;
+      case Ico_U64: return a->Iex.Const.con->Ico.U64 == 0;
+      default:      return False;
+   }
+}
+
+// Was the tag in temp 'from' merged (perhaps through a chain of
+// other merges) into the tag in temp 'into' earlier in this bb?
+static Bool mergedInto_DC ( DCEnv* dce, IRTemp from, IRTemp into, UInt depth )
+{
+   UInt n = MIN(dce->n_merges, DC_MAX_MERGE_RECORDS);
+   UInt i;
+
+   if (depth == 0)
+      return False;
+
+   for (i = 0; i < n; i++) {
+      DCMergeRecord* m = &dce->merges[i];
+      // Temps are only assigned once, so there is at most one of these
+      if (m->result == into) {
+         return m->tag1 == from || m->tag2 == from ||
+                mergedInto_DC(dce, from, m->tag1, depth - 1) ||
+                mergedInto_DC(dce, from, m->tag2, depth - 1);
+      }
+   }
+   return False;
+}
+
+// Returns an earlier merge of the tags in t1 and t2 (one with a
+// result, if needResult), or NULL
+static DCMergeRecord* findMerge_DC ( DCEnv* dce, IRTemp t1, IRTemp t2,
+                                     Bool needResult )
+{
+   UInt n = MIN(dce->n_merges, DC_MAX_MERGE_RECORDS);
+   UInt i;
+
+   for (i = 0; i < n; i++) {
+      DCMergeRecord* m = &dce->merges[i];
+      if (((m->tag1 == t1 && m->tag2 == t2) ||
+           (m->tag1 == t2 && m->tag2 == t1)) &&
+          (!needResult || m->result != IRTemp_INVALID)) {
+         return m;
+      }
+   }
+   return NULL;
+}
+
+static void recordMerge_DC ( DCEnv* dce, IRTemp t1, IRTemp t2, IRTemp result )
+{
+   DCMergeRecord* m = &dce->merges[dce->n_merges % DC_MAX_MERGE_RECORDS];
+   m->tag1 = t1;
+   m->tag2 = t2;
+   m->result = result;
+   dce->n_merges++;
+}
+
+/* Emit IR which merges the tags vatom1 and vatom2, calling the
+   union-find only if they are two different real tags.  Returns the
+   merged tag if wantResult, and NULL otherwise. */
+static IRAtom* mkMergeTagsInline_DC ( DCEnv* dce, IRAtom* vatom1,
+                                      IRAtom* vatom2, Bool wantResult )
+{
+   IRAtom  *tag1, *tag2, *zero1, *zero2, *weak1, *weak2, *same;
+   IRAtom  *trivial, *slow, *pick2, *fast;
+   IRDirty* di;
+   IRTemp   datatag = IRTemp_INVALID;
+
+   // The helpers only look at the bottom 32 bits of a tag
+   if (dce->hWordTy == Ity_I64) {
+      tag1 = assignNewTyped_DC(dce, Ity_I32, unop(Iop_64to32, vatom1));
+      tag2 = assignNewTyped_DC(dce, Ity_I32, unop(Iop_64to32, vatom2));
+   } else {
+      tag1 = vatom1;
+      tag2 = vatom2;
+   }
+
+   zero1 = assignNewTyped_DC(dce, Ity_I1, binop(Iop_CmpEQ32, tag1, mkU32(0)));
+   zero2 = assignNewTyped_DC(dce, Ity_I1, binop(Iop_CmpEQ32, tag2, mkU32(0)));
+   weak1 = assignNewTyped_DC(dce, Ity_I1,
+                             binop(Iop_CmpEQ32, tag1, mkU32(WEAK_FRESH_TAG)));
+   weak2 = assignNewTyped_DC(dce, Ity_I1,
+                             binop(Iop_CmpEQ32, tag2, mkU32(WEAK_FRESH_TAG)));
+   same  = assignNewTyped_DC(dce, Ity_I1, binop(Iop_CmpEQ32, tag1, tag2));
+
+   trivial = mkOr1_DC(dce, mkOr1_DC(dce, zero1, zero2),
+                           mkOr1_DC(dce, mkOr1_DC(dce, weak1, weak2), same));
+   slow = assignNewTyped_DC(dce, Ity_I1, unop(Iop_Not1, trivial));
+
+   if (wantResult) {
+      datatag = newTemp(dce->mce, Ity_Word, DC);
+      di = unsafeIRDirty_1_N( datatag,
+                              2/*regparms*/,
+                              "MC_(helperc_MERGE_DISTINCT_TAGS)",
+                              &MC_(helperc_MERGE_DISTINCT_TAGS),
+                              mkIRExprVec_2( vatom1, vatom2 ));
+   } else {
+      di = unsafeIRDirty_0_N( 2/*regparms*/,
+                              "MC_(helperc_MERGE_DISTINCT_TAGS)",
+                              &MC_(helperc_MERGE_DISTINCT_TAGS),
+                              mkIRExprVec_2( vatom1, vatom2 ));
+   }
+   di->guard = slow;
+   setHelperAnns_DC( dce, di );
+   stmt_DC('V', dce, IRStmt_Dirty(di));
+
+   if (!wantResult)
+      return NULL;
+
+   // Same as MC_(helperc_MERGE_TAGS): the result is tag2 if tag1 is
+   // 0, or if tag1 is WEAK_FRESH_TAG and tag2 isn't 0, and tag1
+   // otherwise
+   pick2 = mkOr1_DC(dce, zero1,
+                    mkAnd1_DC(dce, weak1,
+                              assignNewTyped_DC(dce, Ity_I1,
+                                                unop(Iop_Not1, zero2))));
+   fast = assignNew_DC(dce, Ity_Word, IRExpr_ITE(pick2, vatom2, vatom1));
+   return assignNew_DC(dce, Ity_Word,
+                       IRExpr_ITE(trivial, fast, mkexpr(datatag)));
+}
+
+/* Returns the merge of the tags vatom1 and vatom2 (what
+   MC_(helperc_MERGE_TAGS) returns). */
+static IRAtom* mkMergeTags_DC ( DCEnv* dce, IRAtom* vatom1, IRAtom* vatom2 )
+{
+   IRAtom* merged;
+
+   if (!use_inline_tag_paths_DC()) {
+      return assignNew_DC(dce, Ity_Word,
+                          mkIRExprCCall (Ity_Word,
+                                         2 /*Int regparms*/,
+                                         "MC_(helperc_MERGE_TAGS)",
+                                         &MC_(helperc_MERGE_TAGS),
+                                         mkIRExprVec_2( vatom1, vatom2 )));
+   }
+
+   if (isZeroTagConst_DC(vatom1))
+      return vatom2;
+   if (isZeroTagConst_DC(vatom2))
+      return vatom1;
+
+   if (vatom1->tag == Iex_RdTmp && vatom2->tag == Iex_RdTmp) {
+      IRTemp t1 = vatom1->Iex.RdTmp.tmp;
+      IRTemp t2 = vatom2->Iex.RdTmp.tmp;
+      DCMergeRecord* m;
+
+      if (t1 == t2 || mergedInto_DC(dce, t2, t1, DC_MERGE_CHAIN_DEPTH))
+         return vatom1;
+      if (mergedInto_DC(dce, t1, t2, DC_MERGE_CHAIN_DEPTH))
+         return vatom2;
+      m = findMerge_DC(dce, t1, t2, True);
+      if (m)
+         return mkexpr(m->result);
+
+      merged = mkMergeTagsInline_DC(dce, vatom1, vatom2, True);
+      recordMerge_DC(dce, t1, t2, merged->Iex.RdTmp.tmp);
+      return merged;
+   }
+
+   return mkMergeTagsInline_DC(dce, vatom1, vatom2, True);
+}
+
+/* Emits IR which merges the tags vatom1 and vatom2 (as
+   MC_(helperc_MERGE_TAGS_RETURN_0) does) and returns a tag of 0. */
+static IRAtom* mkMergeTagsReturn0_DC ( DCEnv* dce, IRAtom* vatom1,
+                                       IRAtom* vatom2 )
+{
+   if (!use_inline_tag_paths_DC()) {
+      IRTemp   datatag = newTemp(dce->mce, Ity_Word, DC);
+      IRDirty* di = unsafeIRDirty_1_N(datatag,
+                                      2,
+                                      "MC_(helperc_MERGE_TAGS_RETURN_0)",
+                                      &MC_(helperc_MERGE_TAGS_RETURN_0),
+                                      mkIRExprVec_2( vatom1, vatom2 ));
+      setHelperAnns_DC( dce, di );
+      stmt_DC('V', dce, IRStmt_Dirty(di));
+      return IRExpr_Const(IRConst_UWord(0));
+   }
+
+   if (isZeroTagConst_DC(vatom1) || isZeroTagConst_DC(vatom2))
+      return IRExpr_Const(IRConst_UWord(0));
+
+   if (vatom1->tag == Iex_RdTmp && vatom2->tag == Iex_RdTmp) {
+      IRTemp t1 = vatom1->Iex.RdTmp.tmp;
+      IRTemp t2 = vatom2->Iex.RdTmp.tmp;
+
+      if (t1 == t2 ||
+          mergedInto_DC(dce, t2, t1, DC_MERGE_CHAIN_DEPTH) ||
+          mergedInto_DC(dce, t1, t2, DC_MERGE_CHAIN_DEPTH) ||
+          findMerge_DC(dce, t1, t2, False))
+         return IRExpr_Const(IRConst_UWord(0));
+
+      recordMerge_DC(dce, t1, t2, IRTemp_INVALID);
+   }
+
+   mkMergeTagsInline_DC(dce, vatom1, vatom2, False);
+   return IRExpr_Const(IRConst_UWord(0));
+}
+
 /* Worker function; do not call directly. */
 static
 IRAtom* expr2tags_LDle_WRK_DC ( DCEnv* dce, IRType ty, IRAtom* addr, UInt bias )
@@ -2031,6 +2647,11 @@ IRAtom* expr2tags_LDle_WRK_DC ( DCEnv* dce, IRType ty, IRAtom* addr, UInt bias )
       addrAct = assignNew_DC(dce, tyAddr, binop(mkAdd, addr, eBias) );
    }
 
+   if (use_inline_tag_paths_DC()) {
+      return expr2tags_LDle_inline_DC(dce, sizeofIRType(ty), addrAct,
+                                      hname, helper);
+   }
+
    /* We need to have a place to park the tag we're just about to
       read. */
    //   datatag = newIRTemp(dce->bb->tyenv, tyS);
@@ -2102,11 +2723,7 @@ IRAtom* expr2tags_LDle_DC ( DCEnv* dce, IRType ty, IRAtom* addr, UInt bias )
          // On second thought, let's just go ahead and do it for now:
 
          // Clean call version:
-         return mkIRExprCCall (Ity_Word,
-                               2 /*Int regparms*/,
-                               "MC_(helperc_MERGE_TAGS)",
-                               &MC_(helperc_MERGE_TAGS),
-                               mkIRExprVec_2( v64lo, v64hi ));
+         return mkMergeTags_DC(dce, v64lo, v64hi);
 
 
       default:
@@ -2224,6 +2841,19 @@ IRExpr* expr2tags_DC ( DCEnv* dce, IRExpr* e )
 	       theoretically not OK. This hasn't come up in an example
 	       yet, but avoid it by passing a unique integer to each
 	       call; this is also convenient during debugging. */
+	    /* With --dyncomp-site-literals, that integer also picks
+	       the entry of the per-site tag cache. */
+	    if (dyncomp_site_literals) {
+	       return assignNew_DC
+		  (dce, Ity_Word,
+		   mkIRExprCCall(Ity_Word,
+				 1 /*Int regparms*/,
+				 "MC_(helperc_CREATE_SITE_TAG)",
+				 &MC_(helperc_CREATE_SITE_TAG),
+				 mkIRExprVec_1(IRExpr_Const
+					       (IRConst_UWord
+						(static_fresh_count++)))));
+	    }
 	    return assignNew_DC
 	       (dce, Ity_Word,
 		mkIRExprCCall(Ity_Word,
@@ -2386,6 +3016,20 @@ void do_shadow_STle_DC ( DCEnv* dce,
       default:      VG_(tool_panic)("dyncomp:do_shadow_STle_DC");
    }
 
+   if (use_inline_tag_paths_DC()) {
+      if (ty == Ity_V128) {
+         IRAtom *eight = tyAddr==Ity_I32 ? mkU32(8) : mkU64(8);
+         addrHi64 = assignNew_DC(dce, tyAddr, binop(mkAdd, addr, eight) );
+         do_shadow_STle_inline_DC(dce, 8, addr, vdata, 1, hname, helper);
+         do_shadow_STle_inline_DC(dce, 8, addrHi64, vdata, 1, hname, helper);
+      } else {
+         /* See below re 64-bit regparms */
+         do_shadow_STle_inline_DC(dce, sizeofIRType(ty), addr, vdata,
+                                  ty == Ity_I64 ? 1 : 2, hname, helper);
+      }
+      return;
+   }
+
    if (ty == Ity_V128) {
       IRAtom *eight = tyAddr==Ity_I32 ? mkU32(8) : mkU64(8);
       // (comment added 2006)  
@@ -36,9 +36,14 @@
 #include "kvasir_main.h"
 #include "decls-output.h"
 #include "dtrace-output.h"
+#include "dtrace-writer.h"
+#include "dtrace-gzip.h"
+#include "dtrace-sink.h"
+#include "kvasir_profile.h"
 
 #include "dyncomp_main.h"
 #include "dyncomp_runtime.h"
+#include "dyncomp_state.h"
 
 extern void setNOBUF(FILE *stream);
 
@@ -50,17 +55,27 @@ const HChar* kvasir_program_stderr_filename = 0;
 Bool kvasir_dtrace_append = False;
 Bool kvasir_dtrace_no_decls = False;
 Bool kvasir_dtrace_gzip = False;
+Int kvasir_dtrace_gzip_level = 6;
+Bool kvasir_dtrace_flush_every_ppt = False;
+Bool kvasir_dtrace_binary = False;
+Bool kvasir_dtrace_sink_process = False;
 Bool kvasir_output_fifo = False;
 Bool kvasir_decls_only = False;
 Bool kvasir_print_debug_info = False;
+const HChar* kvasir_profile_filename = 0;
 Bool actually_output_separate_decls_dtrace = 0;
 Bool print_declarations = 1;
 
 Bool kvasir_with_dyncomp = True;
 Bool dyncomp_no_gc = False;
 Bool dyncomp_approximate_literals = False;
+Bool dyncomp_site_literals = False;
 Bool dyncomp_detailed_mode = False;
+const HChar* dyncomp_save_state_filename = 0;
+const HChar* dyncomp_merge_state_filenames = 0;
 int  dyncomp_gc_after_n_tags = 10000000;
+Bool dyncomp_gc_incremental = False;
+int  dyncomp_gc_step = 64;
 Bool dyncomp_without_dtrace = False;
 Bool dyncomp_print_debug_info = False;
 Bool dyncomp_print_trace_info = False;
@@ -70,6 +85,7 @@ Bool dyncomp_separate_entry_exit = False;
 Bool dyncomp_trace_startup = False;
 Bool dyncomp_delayed_print_IR = True;
 Bool dyncomp_delayed_trace = True;
+Bool dyncomp_inline_tags = True;
 
 // Special modes for DynComp
 // Changes the definition of what constitutes an interaction
@@ -97,7 +113,9 @@ static char splitDirectoryAndFilename(const char* input, char** dirnamePtr, char
 // Lots of boring file-handling stuff:
 
 static void openTheDtraceFile(void) {
-  openDtraceFile(dtrace_filename);
+  if (openDtraceFile(dtrace_filename)) {
+    dtrace_writer_init();
+  }
   VG_(free)((void*)dtrace_filename);
   dtrace_filename = 0;
 }
@@ -368,7 +386,31 @@ static int openRedirectFile(const char *fname) {
   return new_fd;
 }
 
-static int gzip_pid = 0;
+// Opens fname (plus suffix) for writing, or duplicates stdout if
+// fname is "-", and returns the new file descriptor or -1
+static int openDtraceFd(const char *fname, const char *mode_str, const char *suffix) {
+  SysRes sr;
+  if (VG_STREQ(fname, "-")) {
+    sr = VG_(dup)(1);
+    if (sr_isError(sr)) {
+      return -1;
+    }
+  } else {
+    int mode = VKI_O_CREAT | VKI_O_LARGEFILE |
+      (*mode_str == 'a' ? VKI_O_WRONLY | VKI_O_APPEND : VKI_O_WRONLY | VKI_O_TRUNC);
+    char *new_fname = VG_(malloc)("kvasir_main.c: openDtraceFd.1",
+                                  VG_(strlen)(fname) + VG_(strlen)(suffix) + 1);
+    VG_(strcpy)(new_fname, fname);
+    VG_(strcat)(new_fname, suffix);
+    sr = VG_(open)(new_fname, mode, 0666);
+    VG_(free)(new_fname);
+    if (sr_isError(sr)) {
+      printf( "Couldn't open %s%s for writing: %s\n", fname, suffix, strerror(sr_Err(sr)));
+      return -1;
+    }
+  }
+  return sr_Res(sr);
+}
 
 static int openDtraceFile(const char *fname) {
   const char *mode_str;
@@ -404,56 +446,31 @@ static int openDtraceFile(const char *fname) {
       }    
   }
 
-  if (kvasir_dtrace_gzip || VG_(getenv)("DTRACEGZIP")) {
-    int fds[2]; /* fds[0] for reading (child), fds[1] for writing (parent) */
-    vki_pid_t pid;
-    int fd;
-    int mode;
-    char *new_fname = VG_(malloc)("kvasir_main.c: openDtrace.1", VG_(strlen)(fname) + 4);
-    VG_(strcpy)(new_fname, fname);
-    VG_(strcat)(new_fname, ".gz");
-
-    if (VG_(pipe)(fds) < 0)
+  if (kvasir_dtrace_sink_process) {
+    Bool gzip = kvasir_dtrace_gzip || VG_(getenv)("DTRACEGZIP");
+    int fd = openDtraceFd(fname, mode_str, gzip ? ".gz" : "");
+    if (fd < 0) {
       return 0;
+    }
 
-    if (!(dtrace_fp = fdopen(fds[1], "w")) || (pid = VG_(fork)()) < 0) {
-      VG_(close)(fds[0]);
-      VG_(close)(fds[1]);
+    // Leave compression and writing to a helper process
+    dtrace_fp = dtrace_sink_fdopen(fd, mode_str, gzip ? kvasir_dtrace_gzip_level : -1);
+    if (!dtrace_fp) {
       return 0;
     }
-
-    if (!pid) {
-      /* In child */
-      const HChar *const argv[] = {"gzip", "-c", 0};
-      VG_(close)(fds[1]);
-
-      /* Redirect stdin from the pipe */
-      VG_(close)(0);
-      VG_(dup2)(fds[0], 0);
-      VG_(close)(fds[0]);
-
-      if (!VG_STREQ(fname, "-")) {
-	SysRes sr;
-	/* Redirect stdout to the dtrace.gz file */
-	mode = VKI_O_CREAT | VKI_O_LARGEFILE | VKI_O_TRUNC |
-	  (*mode_str == 'a' ? VKI_O_APPEND : VKI_O_WRONLY);
-	sr = VG_(open)(new_fname, mode, 0666);
-	if (sr_isError(sr)) {
-	  printf( "Couldn't open %s for writing\n", fname);
-	}
-	fd = sr_Res(sr);
-	VG_(close)(1);
-	VG_(dup2)(fd, 1);
-	VG_(close)(fd);
-      }
-
-      VG_(execv)("/bin/gzip", (void *)argv);
-      VG_(exit)(127);
+  } else if (kvasir_dtrace_gzip || VG_(getenv)("DTRACEGZIP")) {
+    int fd = openDtraceFd(fname, mode_str, ".gz");
+    if (fd < 0) {
+      return 0;
     }
 
-    VG_(close)(fds[0]);
-    VG_(fcntl)(fds[1], VKI_F_SETFD, VKI_FD_CLOEXEC);
-    gzip_pid = pid;
+    // Compress in-process rather than piping through gzip
+    dtrace_fp = dtrace_gzip_fdopen(fd, mode_str, kvasir_dtrace_gzip_level);
+    if (!dtrace_fp) {
+      VG_(close)(fd);
+      return 0;
+    }
+    VG_(fcntl)(fd, VKI_F_SETFD, VKI_FD_CLOEXEC);
   } else if VG_STREQ(fname, "-") {
     SysRes sr = VG_(dup)(1);
     int dtrace_fd = sr_Res(sr);
@@ -506,13 +523,9 @@ static int openDtraceFile(const char *fname) {
 // as well as all other open file streams
 static void finishDtraceFile(void)
 {
-  if (dtrace_fp) /* If something goes wrong, we can be called with this null */
+  if (dtrace_fp) { /* If something goes wrong, we can be called with this null */
+    dtrace_writer_finish();
     fclose(dtrace_fp);
-  if (gzip_pid) {
-    int status;
-    VG_(waitpid)(gzip_pid, &status, 0);
-    /* Perhaps check return value? */
-    gzip_pid = 0;
   }
 }
 
@@ -662,6 +675,14 @@ void fjalar_tool_print_usage()
 "                             [--no-dtrace-append]\n"
 "    --dtrace-gzip            Compresses .dtrace data [--no-dtrace-gzip]\n"
 "                             (Automatically ON if --dtrace-file string ends in '.gz')\n"
+"    --dtrace-gzip-level=<0-9>  Compression level for --dtrace-gzip [6]\n"
+"    --dtrace-sink-process    Compress and write the .dtrace file in a separate\n"
+"                             process, fed through shared memory [--no-dtrace-sink-process]\n"
+"    --dtrace-flush-every-ppt  Flush the .dtrace file after every program point, for\n"
+"                             watching interactive programs [--no-dtrace-flush-every-ppt]\n"
+"    --dtrace-format=text     Writes .dtrace records as text (default)\n"
+"    --dtrace-format=binary   Writes .dtrace records in a compact binary format; convert\n"
+"                             back with fjalar/tools/dtrace_binary_to_text.py\n"
 "    --object-ppts            Enables printing of object program points for structs and classes\n"
 "    --output-fifo            Create output files as named pipes [--no-output-fifo]\n"
 "    --program-stdout=<file>  Redirect instrumented program stdout to file\n"
@@ -676,21 +697,37 @@ void fjalar_tool_print_usage()
 "                             (The default is to garbage collect every 10,000,000 tags created)\n"
 "                             0 is a special case that turns off the garbage collector.\n"
 "                             (Faster but may run out of memory for long-running programs)\n"
+"    --dyncomp-gc-incremental  Renumber the tags in memory a few secondaries at a time after\n"
+"                             each garbage collection instead of all at once, to shorten pauses\n"
+"    --dyncomp-gc-step=<number>  The number of tag secondaries renumbered at each incremental\n"
+"                             step when --dyncomp-gc-incremental is on [64]\n"
 "    --dyncomp-approximate-literals  Approximates the handling of literals for comparability.\n"
 "                                    (Loses some precision but faster and takes less memory)\n"
+"    --dyncomp-site-literals  Gives each literal in the code one tag per program point\n"
+"                             execution, rather than a new tag every time it is executed\n"
+"                             (Creates far fewer tags in loops) [--no-dyncomp-site-literals]\n"
 "    --dyncomp-detailed-mode  Uses an O(n^2) space/time algorithm for determining\n"
 "                             variable comparability, which is potentially more precise\n"
 "                             but takes up more resources than the O(n) default algorithm\n"
+"    --dyncomp-save-state=<file>  Saves the comparability sets of every program point to <file>\n"
+"    --dyncomp-merge-state=<file>[,<file>...]  Merges the comparability sets that other runs\n"
+"                             saved with --dyncomp-save-state into this run's before\n"
+"                             writing the .decls file (to run a test suite in parallel)\n"
 "    --dyncomp-separate-entry-exit  Allows variables to have distinct comparability\n"
 "                                   numbers at function entrance/exit when run with\n"
 "                                   DynComp.  This provides more accuracy, but may\n"
 "                                   sometimes lead to output that Daikon cannot accept.\n"
+"    --dyncomp-inline-tags    Read and write tags for most memory accesses with inline\n"
+"                             code instead of helper calls [default on]\n"
 "    --dyncomp-interactions=all          Counts all binary operations as interactions (default)\n"
 "    --dyncomp-interactions=units        Only counts interactions that are consistent with units\n"
 "    --dyncomp-interactions=comparisons  Only counts comparison operations as interactions\n"
 "    --dyncomp-interactions=none         Tracks no interactions, just dataflow\n"
 "\n  Debugging:\n"
 "    --kvasir-debug           Print Kvasir-internal debug messages [--no-debug]\n"
+"    --kvasir-profile=<file>  Write a report of the time Kvasir and DynComp spend at each\n"
+"                             program point (traversal, output, comparability, garbage\n"
+"                             collection), bytes written and tags created to <file>\n"
 "    --dyncomp-debug          Print DynComp debug messages (--dyncomp must also be on)\n"
 "                             [--no-dyncomp-debug]\n"
 "    --dyncomp-trace-merge    Similar, but more detailed\n"
@@ -714,16 +751,30 @@ Bool fjalar_tool_process_cmd_line_option(const HChar* arg)
   else if VG_YESNO_CLO(arg, "object-ppts",      kvasir_object_ppts) {}
   else if VG_YESNO_CLO(arg, "dtrace-no-decls",  kvasir_dtrace_no_decls) {}
   else if VG_YESNO_CLO(arg, "dtrace-gzip",      kvasir_dtrace_gzip) {}
+  else if VG_BINT_CLO(arg, "--dtrace-gzip-level", kvasir_dtrace_gzip_level, 0, 9) {}
+  else if VG_YESNO_CLO(arg, "dtrace-sink-process", kvasir_dtrace_sink_process) {}
+  else if VG_YESNO_CLO(arg, "dtrace-flush-every-ppt", kvasir_dtrace_flush_every_ppt) {}
+  else if VG_XACT_CLO(arg, "--dtrace-format=text",
+                      kvasir_dtrace_binary, False) {}
+  else if VG_XACT_CLO(arg, "--dtrace-format=binary",
+                      kvasir_dtrace_binary, True) {}
   else if VG_YESNO_CLO(arg, "output-fifo",      kvasir_output_fifo) {}
   else if VG_YESNO_CLO(arg, "decls-only",       kvasir_decls_only) {}
   else if VG_YESNO_CLO(arg, "kvasir-debug",     kvasir_print_debug_info) {}
+  else if VG_STR_CLO(arg, "--kvasir-profile",   kvasir_profile_filename) {}
   else if VG_STR_CLO(arg, "--program-stdout",   kvasir_program_stdout_filename){}
   else if VG_STR_CLO(arg, "--program-stderr",   kvasir_program_stderr_filename){}
   else if VG_YESNO_CLO(arg, "dyncomp",          kvasir_with_dyncomp) {}
   else if VG_YESNO_CLO(arg, "dyncomp-approximate-literals", dyncomp_approximate_literals) {}
+  else if VG_YESNO_CLO(arg, "dyncomp-site-literals", dyncomp_site_literals) {}
   else if VG_YESNO_CLO(arg, "dyncomp-detailed-mode", dyncomp_detailed_mode) {}
+  else if VG_STR_CLO(arg, "--dyncomp-save-state", dyncomp_save_state_filename) {}
+  else if VG_STR_CLO(arg, "--dyncomp-merge-state", dyncomp_merge_state_filenames) {}
   else if VG_BINT_CLO(arg, "--dyncomp-gc-num-tags", dyncomp_gc_after_n_tags,
                       0, 0x7fffffff) {}
+  else if VG_YESNO_CLO(arg, "dyncomp-gc-incremental", dyncomp_gc_incremental) {}
+  else if VG_BINT_CLO(arg, "--dyncomp-gc-step", dyncomp_gc_step,
+                      1, 0x7fffffff) {}
   else if VG_XACT_CLO(arg, "--dyncomp-interactions=none",
                       dyncomp_dataflow_only_mode,        True) {}
   else if VG_XACT_CLO(arg, "--dyncomp-interactions=comparisons",
@@ -740,6 +791,7 @@ Bool fjalar_tool_process_cmd_line_option(const HChar* arg)
   else if VG_YESNO_CLO(arg, "dyncomp-separate-entry-exit",
                        dyncomp_separate_entry_exit) {}
   else if VG_YESNO_CLO(arg, "dyncomp-trace-startup", dyncomp_trace_startup) {}
+  else if VG_YESNO_CLO(arg, "dyncomp-inline-tags", dyncomp_inline_tags) {}
   else
     return False;   // If no options match, return False so that an error
                     // message can be reported by the Valgrind core.
@@ -780,8 +832,11 @@ void fjalar_tool_finish() {
     // been properly updated:
     DC_extra_propagate_val_to_var_sets();
 
-    // Now print out the .decls file at the very end of execution:
+    // Now print out the .decls file at the very end of execution
+    // (merging in and saving comparability state as it goes):
+    DC_init_states();
     DC_outputDeclsAtEnd();
+    DC_finish_states();
 
     if (dyncomp_profile_tags) {
       printf("num. static consts in bin/tri/quad ops = %u\n", numConsts);
@@ -792,11 +847,15 @@ void fjalar_tool_finish() {
       printf("next tag = %u, total assigned = %u\n", nextTag, totalNumTagsAssigned);
     }
 
+    print_garbage_collector_stats();
+
   }
 
   if (!dyncomp_without_dtrace) {
      finishDtraceFile();
   }
+
+  kvasir_profile_finish();
 }
 
 Bool kvasir_late_init_done = False;
@@ -806,9 +865,16 @@ void fjalar_tool_handle_function_entrance(FunctionExecutionState* f_state) {
     kvasir_late_init();
     kvasir_late_init_done = True;
   }
+  if (kvasir_with_dyncomp && dyncomp_site_literals) {
+    DC_new_literal_tag_epoch();
+  }
   printDtraceForFunction(f_state, 1);
 }
 
+void fjalar_tool_handle_new_functions(FunctionEntry** funcs, UInt num) {
+  outputDeclsForNewFunctions(funcs, num);
+}
+
 void fjalar_tool_handle_function_exit(FunctionExecutionState* f_state) {
 
   if (kvasir_with_dyncomp) {
@@ -840,6 +906,9 @@ void fjalar_tool_handle_function_exit(FunctionExecutionState* f_state) {
     }
   }
 
+  if (kvasir_with_dyncomp && dyncomp_site_literals) {
+    DC_new_literal_tag_epoch();
+  }
   printDtraceForFunction(f_state, 0);
 }
 
@@ -32,6 +32,8 @@
 #include "pub_tool_clientstate.h"
 #include "pub_tool_libcprint.h"
 
+#include "var_uf_map.h"
+
 FILE* decls_fp; // File pointer for .decls file (this will point
                 // to the same thing as dtrace_fp by default since
                 // both .decls and .dtrace are outputted to .dtrace
@@ -66,27 +68,19 @@ typedef struct {
   //  it contains all of the variables present at ENTRY plus the
   //  return value derived variables)
 
-  // (comment added 2005)  
-  // TODO: WARNING!  This hashtable-within-hashtable structure may
-  // blow up in my face and cause a huge memory overload!!!  Remember
-  // that each hashtable is initialized to a constant number!  I'll
-  // try to keep them fairly small by calling
-  // genallocateSMALLhashtable, but they still take up room
-  // nonetheless.
-
-  // var_uf_map:
+  // var_uf_map (see var_uf_map.h):
   // Key: tag which is the leader of some entry in val_uf
-  // Value: uf_object
+  // Value: VarUFEntry (a uf_object plus the list of members of its set)
 
-  // Define a function (implemented as a non-null hashtable get)
+  // Define a function (implemented as a non-null var_uf_map_get)
   // var_uf_map.exists(val_uf leader entry) returns true if entry from
   // val_uf exists in var_uf_map.
 
   // var_uf_map is the variable analogue to val_uf, which is the union-find
   // for all values ever created in a program.
   // (null if --dyncomp-detailed-mode is on)
-  struct genhashtable* ppt_entry_var_uf_map; // Inactive unless --dyncomp-separate-entry-exit is on
-  struct genhashtable* ppt_exit_var_uf_map;
+  VarUFMap* ppt_entry_var_uf_map; // Inactive unless --dyncomp-separate-entry-exit is on
+  VarUFMap* ppt_exit_var_uf_map;
 
   // var_tags: A fixed-sized array (indexed by the serial # of Daikon
   // variables at that program point) which contains tags which are the
@@ -133,6 +127,21 @@ typedef struct {
   // The number of invocations of this function
   UInt num_invocations;
 
+  // The first lines of the .dtrace records for the entry and exit
+  // program points (everything up to the nonce), built the first time
+  // they are needed by printDtraceFunctionHeader()
+  char* dtrace_enter_header;
+  char* dtrace_exit_header;
+
+  // The schemas of the entry and exit program points for
+  // --dtrace-format=binary (see dtrace-binary.h)
+  struct _DtraceSchema* dtrace_enter_schema;
+  struct _DtraceSchema* dtrace_exit_schema;
+
+  // The counters for --kvasir-profile (see kvasir_profile.h), allocated
+  // the first time one of this function's program points is printed
+  struct _KvasirProfile* profile;
+
 } DaikonFunctionEntry;
 
 // Kvasir/DynComp-specific global variables that are set by
@@ -144,9 +153,14 @@ const HChar* kvasir_program_stderr_filename;
 Bool kvasir_dtrace_append;
 Bool kvasir_dtrace_no_decls;
 Bool kvasir_dtrace_gzip;
+Int kvasir_dtrace_gzip_level;
+Bool kvasir_dtrace_flush_every_ppt;
+Bool kvasir_dtrace_binary;
+Bool kvasir_dtrace_sink_process;
 Bool kvasir_output_fifo;
 Bool kvasir_decls_only;
 Bool kvasir_print_debug_info;
+const HChar* kvasir_profile_filename;
 Bool actually_output_separate_decls_dtrace;
 Bool print_declarations;
 Bool kvasir_object_ppts;
@@ -154,8 +168,13 @@ Bool kvasir_object_ppts;
 Bool kvasir_with_dyncomp;
 Bool dyncomp_no_gc;
 Bool dyncomp_approximate_literals;
+Bool dyncomp_site_literals;
 Bool dyncomp_detailed_mode;
+const HChar* dyncomp_save_state_filename;
+const HChar* dyncomp_merge_state_filenames;
 int  dyncomp_gc_after_n_tags;
+Bool dyncomp_gc_incremental;
+int  dyncomp_gc_step;
 Bool dyncomp_without_dtrace;
 Bool dyncomp_print_debug_info;
 Bool dyncomp_print_trace_info;
@@ -168,6 +187,7 @@ Bool dyncomp_delayed_trace;
 Bool dyncomp_units_mode;
 Bool dyncomp_dataflow_only_mode;
 Bool dyncomp_dataflow_comparisons_mode;
+Bool dyncomp_inline_tags;
 
 // Define MAX_DEBUG_INFO to turn on all sorts of
 // debugging printouts.  WARNING: you will get
@@ -0,0 +1,234 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* kvasir_profile.c:
+   Per-program point counters of Kvasir's own overhead
+   (--kvasir-profile).  See kvasir_profile.h.
+*/
+
+#include "../my_libc.h"
+
+#include "kvasir_profile.h"
+#include "dtrace-writer.h"
+#include "dyncomp_main.h"
+
+#include "pub_tool_libcbase.h"
+
+ULong kvasir_profile_ppt_output_cycles = 0;
+ULong kvasir_profile_ppt_dyncomp_cycles = 0;
+
+// Every KvasirProfile that has been allocated, in no particular order
+static KvasirProfile** profiles = 0;
+static UInt numProfiles = 0;
+static UInt maxProfiles = 0;
+
+// The function whose program point is being printed (if any), and
+// the one that was printed last
+static KvasirProfile* cur_profile = 0;
+static KvasirProfile* last_profile = 0;
+
+// For the program point being printed
+static ULong ppt_traversal_cycles = 0;
+static ULong ppt_start_bytes = 0;
+static ULong traversal_nested_start = 0;
+
+// totalNumTagsAssigned the last time that tags were charged to
+// last_profile
+static UInt last_tag_count = 0;
+
+// Tags created and garbage collection before the first program point
+static ULong startup_tags_created = 0;
+static ULong startup_gc_cycles = 0;
+
+static KvasirProfile* get_profile(DaikonFunctionEntry* funcPtr) {
+  KvasirProfile* p = funcPtr->profile;
+
+  if (!p) {
+    p = VG_(calloc)("kvasir_profile.c: get_profile.1", 1, sizeof(*p));
+    p->func = funcPtr;
+    funcPtr->profile = p;
+
+    if (numProfiles == maxProfiles) {
+      maxProfiles = maxProfiles ? 2 * maxProfiles : 64;
+      profiles = VG_(realloc)("kvasir_profile.c: get_profile.2", profiles,
+                              maxProfiles * sizeof(*profiles));
+    }
+    profiles[numProfiles++] = p;
+  }
+
+  return p;
+}
+
+// Charges the tags created since the last call to last_profile
+static void charge_tags(void) {
+  UInt n;
+
+  if (!kvasir_with_dyncomp) {
+    return;
+  }
+
+  n = totalNumTagsAssigned - last_tag_count;
+  last_tag_count = totalNumTagsAssigned;
+  if (last_profile) {
+    last_profile->tags_created += n;
+  }
+  else {
+    startup_tags_created += n;
+  }
+}
+
+// Everything that has been written to the .dtrace file so far,
+// including what is still in dtrace-writer's buffer
+static ULong dtrace_bytes_so_far(void) {
+  return dtrace_bytes_written + dtrace_buf_used;
+}
+
+void kvasir_profile_begin_ppt(DaikonFunctionEntry* funcPtr, Bool isEnter) {
+  if (!kvasir_profile_filename) {
+    return;
+  }
+
+  charge_tags();
+
+  cur_profile = get_profile(funcPtr);
+  if (isEnter) {
+    cur_profile->enter_count++;
+  }
+  else {
+    cur_profile->exit_count++;
+  }
+
+  ppt_traversal_cycles = 0;
+  kvasir_profile_ppt_output_cycles = 0;
+  kvasir_profile_ppt_dyncomp_cycles = 0;
+  ppt_start_bytes = dtrace_bytes_so_far();
+}
+
+void kvasir_profile_end_ppt(void) {
+  if (!kvasir_profile_filename) {
+    return;
+  }
+  tl_assert(cur_profile);
+
+  cur_profile->traversal_cycles += ppt_traversal_cycles;
+  cur_profile->output_cycles += kvasir_profile_ppt_output_cycles;
+  cur_profile->dyncomp_cycles += kvasir_profile_ppt_dyncomp_cycles;
+  cur_profile->bytes_written += dtrace_bytes_so_far() - ppt_start_bytes;
+
+  last_profile = cur_profile;
+  cur_profile = 0;
+}
+
+ULong kvasir_profile_begin_traversal(void) {
+  if (!kvasir_profile_filename) {
+    return 0;
+  }
+
+  traversal_nested_start =
+    kvasir_profile_ppt_output_cycles + kvasir_profile_ppt_dyncomp_cycles;
+  return kvasir_profile_cycles();
+}
+
+// The traversal cycles are whatever wasn't spent formatting output or
+// in DynComp while the traversal was going on
+void kvasir_profile_end_traversal(ULong start) {
+  ULong elapsed, nested;
+
+  if (!kvasir_profile_filename) {
+    return;
+  }
+
+  elapsed = kvasir_profile_cycles() - start;
+  nested = kvasir_profile_ppt_output_cycles + kvasir_profile_ppt_dyncomp_cycles
+    - traversal_nested_start;
+  if (elapsed > nested) {
+    ppt_traversal_cycles += elapsed - nested;
+  }
+}
+
+void kvasir_profile_add_gc(ULong start) {
+  KvasirProfile* p = cur_profile ? cur_profile : last_profile;
+  ULong elapsed;
+
+  if (!kvasir_profile_filename) {
+    return;
+  }
+
+  elapsed = kvasir_profile_cycles() - start;
+  if (p) {
+    p->gc_cycles += elapsed;
+  }
+  else {
+    startup_gc_cycles += elapsed;
+  }
+}
+
+static ULong total_cycles(const KvasirProfile* p) {
+  return p->traversal_cycles + p->output_cycles + p->dyncomp_cycles +
+    p->gc_cycles;
+}
+
+// Most expensive first
+static Int compareProfiles(const void* a, const void* b) {
+  ULong x = total_cycles(*(KvasirProfile* const*)a);
+  ULong y = total_cycles(*(KvasirProfile* const*)b);
+
+  if (x != y) {
+    return (x > y) ? -1 : 1;
+  }
+  return 0;
+}
+
+void kvasir_profile_finish(void) {
+  FILE* fp;
+  UInt i;
+
+  if (!kvasir_profile_filename) {
+    return;
+  }
+
+  charge_tags();
+
+  fp = fopen(kvasir_profile_filename, "w");
+  if (!fp) {
+    printf("Couldn't open %s for writing the --kvasir-profile report\n",
+           kvasir_profile_filename);
+    return;
+  }
+
+  VG_(ssort)(profiles, numProfiles, sizeof(*profiles), compareProfiles);
+
+  fprintf(fp, "# Kvasir profile: %u functions, times in %s\n", numProfiles,
+#if defined(VGA_x86) || defined(VGA_amd64)
+          "CPU cycles"
+#else
+          "milliseconds"
+#endif
+          );
+  fprintf(fp, "# before the first program point: %llu tags created, %llu in garbage collection\n",
+          startup_tags_created, startup_gc_cycles);
+  fprintf(fp, "# %-15s %-15s %-15s %-15s %-15s %-13s %-13s %-10s %-10s %s\n",
+          "total", "traversal", "output", "dyncomp", "gc",
+          "bytes", "tags", "enter", "exit", "function");
+
+  for (i = 0; i < numProfiles; i++) {
+    KvasirProfile* p = profiles[i];
+    fprintf(fp, "%-17llu %-15llu %-15llu %-15llu %-15llu %-13llu %-13llu %-10llu %-10llu %s\n",
+            total_cycles(p), p->traversal_cycles, p->output_cycles,
+            p->dyncomp_cycles, p->gc_cycles, p->bytes_written,
+            p->tags_created, p->enter_count, p->exit_count,
+            p->func->funcEntry.fjalar_name);
+  }
+
+  fclose(fp);
+}
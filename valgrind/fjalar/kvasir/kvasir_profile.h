@@ -0,0 +1,101 @@
+/*
+   This file is part of Kvasir, a C/C++ front end for the Daikon
+   dynamic invariant detector built upon the Fjalar framework
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+/* kvasir_profile.h:
+   Where Kvasir's own time goes, program point by program point
+   (--kvasir-profile=<file>).
+
+   Every time printDtraceForFunction() runs, the cycles it spends are
+   split between traversing the variables (visitVariableGroup() and
+   visitReturnValue(), minus the two below), formatting the .dtrace
+   record, and DynComp's post-processing of the observed variables.
+   The counters are kept per DaikonFunctionEntry along with the bytes
+   of .dtrace output, and a report sorted by total cycles is written
+   at the end of execution.
+
+   Tags created and garbage collection pauses mostly happen while the
+   program runs between program points, so they are charged to the
+   program point that was printed last before they happened.
+*/
+
+#ifndef KVASIR_PROFILE_H
+#define KVASIR_PROFILE_H
+
+#include "kvasir_main.h"
+
+#include "pub_tool_libcproc.h"
+
+// The counters for one function (the entry and exit program points
+// together)
+typedef struct _KvasirProfile {
+  DaikonFunctionEntry* func;
+  ULong enter_count;
+  ULong exit_count;
+  ULong traversal_cycles;
+  ULong output_cycles;
+  ULong dyncomp_cycles;
+  ULong gc_cycles;
+  ULong bytes_written;
+  ULong tags_created;
+} KvasirProfile;
+
+// Cycles spent so far in the program point being printed, which are
+// added to its KvasirProfile by kvasir_profile_end_ppt()
+extern ULong kvasir_profile_ppt_output_cycles;
+extern ULong kvasir_profile_ppt_dyncomp_cycles;
+
+static __inline__ ULong kvasir_profile_cycles(void) {
+#if defined(VGA_x86) || defined(VGA_amd64)
+  UInt lo, hi;
+  __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((ULong)hi << 32) | lo;
+#else
+  return VG_(read_millisecond_timer)();
+#endif
+}
+
+// Returns the time to pass to one of the kvasir_profile_add_*()
+// functions below at the end of the phase that is starting (0 if
+// profiling is off)
+static __inline__ ULong kvasir_profile_start(void) {
+  return kvasir_profile_filename ? kvasir_profile_cycles() : 0;
+}
+
+static __inline__ void kvasir_profile_add_output(ULong start) {
+  if (kvasir_profile_filename) {
+    kvasir_profile_ppt_output_cycles += kvasir_profile_cycles() - start;
+  }
+}
+
+static __inline__ void kvasir_profile_add_dyncomp(ULong start) {
+  if (kvasir_profile_filename) {
+    kvasir_profile_ppt_dyncomp_cycles += kvasir_profile_cycles() - start;
+  }
+}
+
+// Called by printDtraceForFunction() before and after it prints a
+// program point
+void kvasir_profile_begin_ppt(DaikonFunctionEntry* funcPtr, Bool isEnter);
+void kvasir_profile_end_ppt(void);
+
+// Wrap the calls to visitVariableGroup() and visitReturnValue()
+ULong kvasir_profile_begin_traversal(void);
+void kvasir_profile_end_traversal(ULong start);
+
+// Called by garbage_collect_tags() when it is done
+void kvasir_profile_add_gc(ULong start);
+
+// Writes the report to --kvasir-profile
+void kvasir_profile_finish(void);
+
+#endif
@@ -17,7 +17,7 @@
 */
 
 // Implementation of generic union-find data structure
-// with union-by-rank and path-compression
+// with union-by-rank and path-halving
 // Based on http://www.cs.rutgers.edu/~chvatal/notes/uf.html
 
 #include "../my_libc.h"
@@ -27,14 +27,13 @@
 
 // caller guarantees that object is non-NULL
 uf_name uf_find(uf_object *object) {
-  uf_object *root, *next;
+  uf_object *root = object;
 
-  // Find the root:
-  for(root=object; root->parent!=root; root=root->parent);
-
-  // Path-compression:
-  for(next=object->parent; next!=root; object=next, next=object->parent) {
-    object->parent=root;
+  // Path-halving: point every object visited at its grandparent on
+  // the way up, so the root is found in a single pass
+  while (root->parent != root) {
+    root->parent = root->parent->parent;
+    root = root->parent;
   }
 
   DYNCOMP_TPRINTF("[DynComp] uf_find: %p, %d, %p, %d \n", object, object->tag, root, root->tag);
@@ -42,11 +41,9 @@ uf_name uf_find(uf_object *object) {
 }
 
 // parent might not be NULL; should we free it?
-// no - these objects are allocated two different ways:
-// for values: they are not allocated individually, but within a large
-// block of objects - just go ahead and overwrite
-// for variables: they are allocated individually, but this routine is
-// always called with a freshly allocated pointer.
+// no - these objects are allocated individually (for variables), and
+// this routine is always called with a freshly allocated pointer.
+// (Value sets don't use uf_objects; see ValUFSecondary in dyncomp_main.h.)
 void uf_make_set(uf_object *new_object, unsigned int t) {
   DYNCOMP_TPRINTF("[DynComp] uf_make_set: %p, %u\n", new_object, t);
   new_object->parent = new_object;
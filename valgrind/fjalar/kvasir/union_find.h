@@ -17,7 +17,7 @@
 */
 
 // Implementation of generic union-find data structure
-// with union-by-rank and path-compression
+// with union-by-rank and path-halving
 // Based on http://www.cs.rutgers.edu/~chvatal/notes/uf.html
 
 #ifndef UNION_FIND_H
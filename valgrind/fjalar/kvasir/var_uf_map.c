@@ -0,0 +1,157 @@
+/*
+  This file is part of DynComp, a dynamic comparability analysis tool
+  for C/C++ based upon the Valgrind binary instrumentation framework
+  and the Valgrind MemCheck tool (Copyright (C) 2000-2005 Julian
+  Seward, jseward@acm.org)
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+// Implementation of the per-program-point var_uf_map
+
+#include "../my_libc.h"
+
+#include "kvasir_main.h"
+#include "union_find.h"
+#include "var_uf_map.h"
+
+// Most program points only ever see a handful of tags
+#define VAR_UF_MAP_INITIAL_SIZE 16
+
+// Entries are handed out from chunks of this many, so that the
+// members of a set tend to be near each other in memory
+#define VAR_UF_CHUNK_SIZE 32
+
+struct _VarUFChunk {
+  VarUFChunk* next;
+  VarUFEntry entries[VAR_UF_CHUNK_SIZE];
+};
+
+static __inline__ UInt var_uf_map_hash(UInt tag) {
+  // Tags are handed out sequentially, so spread them out a bit
+  return tag * 0x9E3779B1U;
+}
+
+VarUFMap* var_uf_map_new(void) {
+  VarUFMap* map = VG_(calloc)("var_uf_map.c: var_uf_map_new.1", 1, sizeof(*map));
+  map->size = VAR_UF_MAP_INITIAL_SIZE;
+  map->slots = VG_(calloc)("var_uf_map.c: var_uf_map_new.2", map->size, sizeof(*map->slots));
+  return map;
+}
+
+void var_uf_map_free(VarUFMap* map) {
+  VarUFChunk* chunk;
+  VarUFChunk* next;
+
+  if (!map) {
+    return;
+  }
+
+  for (chunk = map->chunks; chunk; chunk = next) {
+    next = chunk->next;
+    VG_(free)(chunk);
+  }
+  VG_(free)(map->slots);
+  VG_(free)(map);
+}
+
+// Returns the slot holding tag, or the empty slot where it would go
+static VarUFSlot* var_uf_map_slot(VarUFSlot* slots, UInt size, UInt tag) {
+  UInt mask = size - 1;
+  UInt i = var_uf_map_hash(tag) & mask;
+
+  while (slots[i].tag && (slots[i].tag != tag)) {
+    i = (i + 1) & mask;
+  }
+  return &slots[i];
+}
+
+VarUFEntry* var_uf_map_get(VarUFMap* map, UInt tag) {
+  if (!tag) {
+    return NULL;
+  }
+  return var_uf_map_slot(map->slots, map->size, tag)->entry;
+}
+
+static void var_uf_map_grow(VarUFMap* map) {
+  UInt newSize = map->size * 2;
+  VarUFSlot* newSlots = VG_(calloc)("var_uf_map.c: var_uf_map_grow", newSize, sizeof(*newSlots));
+  UInt i;
+
+  for (i = 0; i < map->size; i++) {
+    if (map->slots[i].tag) {
+      *var_uf_map_slot(newSlots, newSize, map->slots[i].tag) = map->slots[i];
+    }
+  }
+
+  VG_(free)(map->slots);
+  map->slots = newSlots;
+  map->size = newSize;
+}
+
+VarUFEntry* var_uf_map_insert(VarUFMap* map, UInt tag) {
+  VarUFEntry* entry;
+  VarUFSlot* slot;
+
+  tl_assert(tag);
+
+  // Keep the load factor under 1/2
+  if (2 * (map->count + 1) > map->size) {
+    var_uf_map_grow(map);
+  }
+
+  if (!map->chunks || (map->chunk_used == VAR_UF_CHUNK_SIZE)) {
+    VarUFChunk* chunk = VG_(malloc)("var_uf_map.c: var_uf_map_insert", sizeof(*chunk));
+    chunk->next = map->chunks;
+    map->chunks = chunk;
+    map->chunk_used = 0;
+  }
+  entry = &map->chunks->entries[map->chunk_used++];
+
+  uf_make_set(&entry->uf, tag);
+  entry->next_member = NULL;
+  entry->first_member = entry;
+  entry->last_member = entry;
+  entry->inext = NULL;
+
+  if (map->last) {
+    map->last->inext = entry;
+  }
+  else {
+    map->list = entry;
+  }
+  map->last = entry;
+
+  slot = var_uf_map_slot(map->slots, map->size, tag);
+  tl_assert(!slot->tag);
+  slot->tag = tag;
+  slot->entry = entry;
+  map->count++;
+
+  return entry;
+}
+
+VarUFEntry* var_uf_map_union_entries(VarUFEntry* e1, VarUFEntry* e2) {
+  VarUFEntry* leader1 = (VarUFEntry*)uf_find(&e1->uf);
+  VarUFEntry* leader2 = (VarUFEntry*)uf_find(&e2->uf);
+  VarUFEntry* leader;
+
+  if (leader1 == leader2) {
+    return leader1;
+  }
+
+  leader = (VarUFEntry*)uf_union(&leader1->uf, &leader2->uf);
+
+  // Append the members of e2's set to those of e1's set
+  leader1->last_member->next_member = leader2->first_member;
+  leader->first_member = leader1->first_member;
+  leader->last_member = leader2->last_member;
+
+  return leader;
+}
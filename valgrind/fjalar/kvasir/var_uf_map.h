@@ -0,0 +1,77 @@
+/*
+  This file is part of DynComp, a dynamic comparability analysis tool
+  for C/C++ based upon the Valgrind binary instrumentation framework
+  and the Valgrind MemCheck tool (Copyright (C) 2000-2005 Julian
+  Seward, jseward@acm.org)
+
+   Copyright (C) 2007-2016 University of Washington Computer Science & Engineering Department,
+   Programming Languages and Software Engineering Group
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+*/
+
+// The map from tags to variable comparability set uf_objects which
+// each program point keeps (var_uf_map - see kvasir_main.h).
+//
+// It is an open-addressed hash table keyed by tag.  On top of the
+// union-find itself, every set keeps a list of its members, so that
+// code which needs to look at all the members of one set doesn't have
+// to walk every entry in the map.
+
+#ifndef VAR_UF_MAP_H
+#define VAR_UF_MAP_H
+
+#include "union_find.h"
+
+typedef struct _VarUFEntry VarUFEntry;
+
+struct _VarUFEntry {
+  uf_object uf;              // This must be first, since entries are
+                             // passed around as uf_objects
+
+  VarUFEntry* next_member;   // The next member of the same set
+  VarUFEntry* first_member;  // Only valid for the leader of a set:
+  VarUFEntry* last_member;   // its list of members (in the order that
+                             // they joined the set)
+
+  VarUFEntry* inext;         // The next entry in order of insertion
+};
+
+typedef struct {
+  UInt tag;                  // 0 means the slot is empty
+  VarUFEntry* entry;
+} VarUFSlot;
+
+typedef struct _VarUFChunk VarUFChunk;
+
+typedef struct {
+  VarUFSlot* slots;          // size is always a power of 2
+  UInt size;
+  UInt count;
+
+  VarUFEntry* list;          // All entries in order of insertion
+  VarUFEntry* last;
+
+  VarUFChunk* chunks;        // Where the entries are allocated from
+  UInt chunk_used;
+} VarUFMap;
+
+VarUFMap* var_uf_map_new(void);
+void var_uf_map_free(VarUFMap* map);
+
+// Returns the entry for tag, or NULL if there isn't one
+VarUFEntry* var_uf_map_get(VarUFMap* map, UInt tag);
+
+// Pre: tag is not a key in map, tag is not zero
+// Creates an entry for tag in a new singleton set
+VarUFEntry* var_uf_map_insert(VarUFMap* map, UInt tag);
+
+// Merges the sets of e1 and e2 and returns the leader of the result.
+// The members of e1's set stay ahead of the members of e2's set in
+// the member list.
+VarUFEntry* var_uf_map_union_entries(VarUFEntry* e1, VarUFEntry* e2);
+
+#endif // VAR_UF_MAP_H
@@ -82,6 +82,8 @@ void mc_make_noaccess ( Addr a, SizeT len );
 extern char mc_are_some_bytes_initialized (Addr a, SizeT len);
 Bool mc_check_writable ( Addr a, SizeT len, Addr* bad_addr );
 MC_ReadResult mc_check_readable ( Addr a, SizeT len, Addr* bad_addr );
+SizeT mc_addressable_prefix_length ( Addr a, SizeT maxLen );
+SizeT mc_initialized_prefix_length ( Addr a, SizeT len );
 
 // PG - pgbovine - end
 
@@ -67,6 +67,7 @@
 #include "kvasir/kvasir_main.h"
 #include "kvasir/dyncomp_main.h"
 #include "fjalar_main.h"
+#include "fjalar_objects.h"
 #include "../coregrind/pub_core_aspacemgr.h"  // needed for am_is_valid_for_client
 #include "pub_tool_vki.h"  // needed for VKI_PROT_ defines
 
@@ -953,6 +954,95 @@ char mc_are_some_bytes_initialized(Addr a, SizeT len) {
   return 0;
  }
 
+// Returns the number of bytes starting at a (but at most maxLen) that
+// are addressable.  Equivalent to probing one byte at a time with
+// mc_check_writable(), but it looks at whole words of A-bits: 32
+// bytes at a time when they are aligned, and 64KB at a time when a
+// distinguished (all accessible) secondary map covers them.
+SizeT mc_addressable_prefix_length(Addr a, SizeT maxLen) {
+  SizeT n = 0;
+
+  while (n < maxLen) {
+    Addr cur = a + n;
+
+    if (is_start_of_sm(cur) && (maxLen - n >= SM_SIZE)) {
+      SecMap* sm = get_secmap_for_reading(cur);
+      if (sm == &sm_distinguished[SM_DIST_NOACCESS]) {
+        break;
+      }
+      if (is_distinguished_sm(sm)) {
+        n += SM_SIZE;
+        continue;
+      }
+    }
+
+    if (((cur & 31) == 0) && (maxLen - n >= 32)) {
+      // The vabits8 of 8 aligned words (no NOACCESS fields means
+      // that at least one bit of every pair is set)
+      ULong vabits64 = *(ULong*)&(get_secmap_for_reading(cur)->vabits8[SM_OFF(cur)]);
+      if (((vabits64 | (vabits64 >> 1)) & 0x5555555555555555ULL) ==
+          0x5555555555555555ULL) {
+        n += 32;
+        continue;
+      }
+    }
+
+    if (((cur & 3) == 0) && (maxLen - n >= 4)) {
+      UChar vabits8 = get_vabits8_for_aligned_word32(cur);
+      if (((vabits8 | (vabits8 >> 1)) & 0x55) == 0x55) {
+        n += 4;
+        continue;
+      }
+    }
+
+    if (get_vabits2(cur) == VA_BITS2_NOACCESS) {
+      break;
+    }
+    n++;
+  }
+
+  return n;
+}
+
+// Returns the smallest n such that none of the bytes in
+// [a + n, a + len) has any V-bits set, i.e. one past the last byte
+// that mc_are_some_bytes_initialized() would consider initialized
+// (0 if there is none).  Scans backwards 32 bytes at a time where it
+// can: DEFINED (10b) and PARTDEFINED (11b) are exactly the pairs
+// whose high bit is set.
+SizeT mc_initialized_prefix_length(Addr a, SizeT len) {
+  SizeT n = len;
+
+  while (n > 0) {
+    Addr end = a + n;
+    UChar vabits2;
+
+    if (((end & 31) == 0) && (n >= 32)) {
+      Addr cur = end - 32;
+      ULong vabits64 = *(ULong*)&(get_secmap_for_reading(cur)->vabits8[SM_OFF(cur)]);
+      if ((vabits64 & 0xaaaaaaaaaaaaaaaaULL) == 0) {
+        n -= 32;
+        continue;
+      }
+    }
+
+    if (((end & 3) == 0) && (n >= 4)) {
+      if ((get_vabits8_for_aligned_word32(end - 4) & 0xaa) == 0) {
+        n -= 4;
+        continue;
+      }
+    }
+
+    vabits2 = get_vabits2(end - 1);
+    if ((vabits2 == VA_BITS2_PARTDEFINED) || (vabits2 == VA_BITS2_DEFINED)) {
+      break;
+    }
+    n--;
+  }
+
+  return n;
+}
+
 void mc_copy_address_range_state ( Addr src, Addr dst, SizeT len )
 {
   MC_(copy_address_range_state) ( src, dst, len );
@@ -4580,8 +4670,11 @@ static
 void mc_new_mem_mmap ( Addr a, SizeT len, Bool rr, Bool ww, Bool xx,
                         ULong di_handle )
 {
-  // Silence GCC warnings - RUDD
-   (void)di_handle;
+    // A non-zero di_handle means Valgrind has just read the debug
+    // info. of a newly-mapped object (for --trace-shared-libs)
+    if (di_handle && fjalar_trace_shared_libs) {
+      registerSharedObjects(False);
+    }
 
     if (rr || ww || xx) {
       /* (2) mmap/mprotect other -> defined */
@@ -4630,6 +4723,12 @@ void mc_new_mem_startup( Addr a, SizeT len,
    // So we mark any such pages as "unaddressable".
    DEBUG("mc_new_mem_startup(%#lx, %llu, rr=%u, ww=%u, xx=%u)\n",
          a, (ULong)len, rr, ww, xx);
+   // Everything Valgrind has debug info. for at this point (the
+   // executable and the dynamic linker) is off limits to
+   // --trace-shared-libs
+   if (fjalar_trace_shared_libs) {
+      registerSharedObjects(True);
+   }
    mc_new_mem_mmap(a, len, rr, ww, xx, di_handle);
 }
 
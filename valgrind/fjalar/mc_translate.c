@@ -6390,6 +6390,7 @@ IRSB* MC_(instrument) ( VgCallbackClosure* closure,
       dce.n_originalTmps = sb_out->tyenv->types_used;
       dce.hWordTy        = hWordTy;
       dce.bogusLiterals  = False;
+      dce.n_merges       = 0;
       dce.tmpMap         = VG_(malloc)("mc_translate.c.2", dce.n_originalTmps * sizeof(IRTemp));
       //dce.tmpMap         = LibVEX_Alloc(dce.n_originalTmps * sizeof(IRTemp));
       for (i = 0; i < (Int)dce.n_originalTmps; i++)
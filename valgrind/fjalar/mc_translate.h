@@ -105,6 +105,21 @@ struct _MCEnv {
    }
    MCEnv;
 
+/* How many of the tag merges already emitted in a bb DynComp
+   remembers, so that it can leave out merges of tags that it knows
+   have already been merged (see mkMergeTags_DC). */
+#define DC_MAX_MERGE_RECORDS 64
+
+/* A merge of the tags in shadow temps tag1 and tag2, whose result is
+   in shadow temp result (IRTemp_INVALID if it was thrown away). */
+typedef
+   struct {
+      IRTemp tag1;
+      IRTemp tag2;
+      IRTemp result;
+   }
+   DCMergeRecord;
+
 /* Carries around state during DynComp instrumentation. */
 struct _DCEnv;
 
@@ -141,6 +156,12 @@ typedef
       /* MODIFIED: Original address of guest instruction whose IR
          we're now processing, as taken from the last IMark we saw. */
       Addr origAddr;
+
+      /* MODIFIED: the most recent tag merges emitted into bb, with
+         the oldest ones overwritten once there are
+         DC_MAX_MERGE_RECORDS of them. */
+      DCMergeRecord merges[DC_MAX_MERGE_RECORDS];
+      UInt n_merges;
    }
    DCEnv;
 
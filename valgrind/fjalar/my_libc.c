@@ -33,7 +33,6 @@
 
 #include <limits.h>
 
-extern char* fptostr (double x, int width, int preci, char mode, char* buf, int maxlen);
 void setNOBUF(FILE *stream);
 
 /* ctype.h */
@@ -81,6 +80,10 @@ struct __stdio_file {
   vki_pid_t popen_kludge;
   unsigned char ungetbuf;
   char ungotten;
+  /* Set by fdopen_filtered(): */
+  int (*write_fn)(void *cookie, const char *buf, size_t len);
+  int (*close_fn)(void *cookie);
+  void *cookie;
 };
 
 static FILE *__stdio_root;
@@ -184,6 +187,9 @@ err_out:
   case VKI_O_WRONLY: tmp->flags|=CANWRITE;
   }
   tmp->popen_kludge=0;
+  tmp->write_fn=0;
+  tmp->close_fn=0;
+  tmp->cookie=0;
   tmp->next=__stdio_root;
   __stdio_root=tmp;
   tmp->ungotten=0;
@@ -215,6 +221,25 @@ FILE *fdopen(int filedes, const char *mode) {
 }
 
 
+FILE *fdopen_filtered(int filedes, const char *mode,
+                      int (*write_fn)(void *cookie, const char *buf, size_t len),
+                      int (*close_fn)(void *cookie), void *cookie) {
+  FILE *stream=fdopen(filedes,mode);
+  if (stream) {
+    stream->write_fn=write_fn;
+    stream->close_fn=close_fn;
+    stream->cookie=cookie;
+  }
+  return stream;
+}
+
+/* All output to the file goes through here */
+static int __stdio_write(FILE *stream, const void *buf, size_t len) {
+  if (stream->write_fn)
+    return stream->write_fn(stream->cookie,buf,len);
+  return VG_(write)(stream->fd,buf,len);
+}
+
 int fflush(FILE *stream) {
   if (stream->flags&BUFINPUT) {
     register int tmp;
@@ -223,7 +248,7 @@ int fflush(FILE *stream) {
     }
     stream->bs=stream->bm=0;
   } else if (stream->bm) {
-    int ret = VG_(write)(stream->fd,stream->buf,stream->bm);
+    int ret = __stdio_write(stream,stream->buf,stream->bm);
     if (ret == -1 || (UInt)ret != stream->bm) {
       stream->flags|=ERRORINDICATOR;
       return -1;
@@ -237,6 +262,8 @@ int fclose(FILE *stream) {
   int res;
   FILE *f,*fl;
   res=fflush(stream);
+  if (stream->close_fn && stream->close_fn(stream->cookie))
+    res=-1;
   VG_(close)(stream->fd);
   for (fl=0,f=__stdio_root; f; fl=f,f=f->next)
     if (f==stream) {
@@ -379,7 +406,7 @@ kaputt:
     if (fflush(stream)) goto kaputt;
   if (stream->flags&NOBUF) {
     char ch = c;
-    if (VG_(write)(stream->fd,&ch,1) != 1)
+    if (__stdio_write(stream,&ch,1) != 1)
       goto kaputt;
     return 0;
   }
@@ -414,8 +441,15 @@ size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream)
   if (len>stream->buflen || (stream->flags&NOBUF)) {
     if (fflush(stream)) return 0;
     do {
-      res=VG_(write)(stream->fd,ptr,len);
+      res=__stdio_write(stream,ptr,len);
     } while (res==-1 && errno==VKI_EINTR);
+  } else if (!(stream->flags&(BUFLINEWISE|BUFINPUT))) {
+    /* Fully buffered output: copy the whole block in at once */
+    if (stream->bm+len>=stream->buflen)
+      if (fflush(stream)) { stream->flags|=ERRORINDICATOR; return 0; }
+    VG_(memcpy)(stream->buf+stream->bm,ptr,len);
+    stream->bm+=len;
+    res=len;
   } else {
     register const unsigned char *c=ptr;
     for (i=len; i>0; --i,++c)
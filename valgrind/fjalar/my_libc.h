@@ -151,6 +151,13 @@ extern FILE *stdin, *stdout, *stderr;
 FILE *fopen (const char *path, const char *mode);
 FILE *fdopen(int filedes, const char *mode);
 FILE *fd_open(const char *path, const char *mode, int *out_fd);
+/* Like fdopen(), but output is handed to write_fn instead of being
+   written to filedes directly, and fclose() calls close_fn before
+   closing filedes.  write_fn returns the number of bytes consumed, or
+   -1 on error. */
+FILE *fdopen_filtered(int filedes, const char *mode,
+                      int (*write_fn)(void *cookie, const char *buf, size_t len),
+                      int (*close_fn)(void *cookie), void *cookie);
 int fflush(FILE *stream);
 int fclose(FILE *stream);
 
@@ -184,6 +191,9 @@ int vfprintf(FILE *stream, const char *format, va_list ap) __attribute__((__form
 int vsprintf(char *str, const char *format, va_list ap) __attribute__((__format__(__printf__,2,0)));
 int vsnprintf(char *str, size_t size, const char *format, va_list ap) __attribute__((__format__(__printf__,3,0)));
 
+/* The %g/%f conversion used by printf (from my_libc_float.c) */
+int fptostr(double x, int width, int preci, char mode, char* buf, int maxlen);
+
 int fseek(FILE *stream, long offset, int whence);
 long ftell(FILE *stream);
 
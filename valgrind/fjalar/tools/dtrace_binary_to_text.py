@@ -0,0 +1,332 @@
+#! /usr/bin/env python
+## Converts a .dtrace file written by Kvasir with --dtrace-format=binary
+## back to the ordinary text format that Daikon reads.
+
+## Text in the input (the header and the declarations) is copied
+## through unchanged, and each binary record is expanded into the
+## text that Kvasir would have written in its place.  See
+## kvasir/dtrace-binary.h for the format.
+
+## Usage: dtrace_binary_to_text.py [--uninit] input-file [output-file]
+## Either file may be "-" for standard input/output, and an input file
+## ending in .gz is decompressed on the fly.  The values of
+## uninitialized variables come out the way Kvasir prints them in text
+## mode, or as "uninit" with --uninit.
+
+import gzip
+import struct
+import sys
+
+MAGIC = b"KVASIR-DTRACE-BINARY"
+VERSION = 2
+
+class FormatError(Exception):
+  pass
+
+class Reader:
+  """Buffered reader that can hand out either whole lines or bytes."""
+  def __init__(self, f):
+    self.f = f
+    self.buf = b""
+    self.pos = 0
+
+  def fill(self, n):
+    # Make sure n bytes are buffered, unless the input runs out first
+    if len(self.buf) - self.pos >= n:
+      return True
+    self.buf = self.buf[self.pos:]
+    self.pos = 0
+    while len(self.buf) < n:
+      data = self.f.read(max(n - len(self.buf), 1 << 16))
+      if not data:
+        return False
+      self.buf += data
+    return True
+
+  def peek(self):
+    if not self.fill(1):
+      return None
+    return self.buf[self.pos:self.pos + 1]
+
+  def read(self, n):
+    if not self.fill(n):
+      raise FormatError("unexpected end of input")
+    data = self.buf[self.pos:self.pos + n]
+    self.pos += n
+    return data
+
+  def readline(self):
+    while True:
+      end = self.buf.find(b"\n", self.pos)
+      if end >= 0:
+        line = self.buf[self.pos:end + 1]
+        self.pos = end + 1
+        return line
+      if not self.fill(len(self.buf) - self.pos + 1):
+        line = self.buf[self.pos:]
+        self.pos = len(self.buf)
+        return line
+
+  def read_varint(self):
+    n = 0
+    shift = 0
+    while True:
+      b = bytearray(self.read(1))[0]
+      n |= (b & 0x7f) << shift
+      if b < 0x80:
+        return n
+      shift += 7
+
+class Payload:
+  """Cursor over the bytes of one record."""
+  def __init__(self, data):
+    self.data = bytearray(data)
+    self.pos = 0
+
+  def byte(self):
+    if self.pos >= len(self.data):
+      raise FormatError("record too short")
+    b = self.data[self.pos]
+    self.pos += 1
+    return b
+
+  def bytes(self, n):
+    if self.pos + n > len(self.data):
+      raise FormatError("record too short")
+    data = bytes(self.data[self.pos:self.pos + n])
+    self.pos += n
+    return data
+
+  def varint(self):
+    n = 0
+    shift = 0
+    while True:
+      b = self.byte()
+      n |= (b & 0x7f) << shift
+      if b < 0x80:
+        return n
+      shift += 7
+
+  def string(self):
+    return self.bytes(self.varint())
+
+def escape_string(s):
+  return (b'"' +
+          s.replace(b"\\", b"\\\\").replace(b"\n", b"\\n")
+           .replace(b"\r", b"\\r").replace(b'"', b'\\"') +
+          b'"')
+
+def to_bytes(s):
+  return s.encode("ascii")
+
+# Powers of ten that fptostr() scales by, and the number of significant
+# digits that it keeps (DECIMAL_DIG)
+EXP10_TABLE = (1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256)
+NUM_DIGITS = 17
+
+def format_g(x, precision):
+  """Same output as fptostr(x, 1, precision, 'g', ...) in
+  my_libc_float.c, which Kvasir formats floats and doubles with.  It
+  does its own (inexact) binary to decimal conversion, so this has to
+  repeat the same floating point operations to get the same digits."""
+  if x != x:
+    return "nan"
+  sign = ""
+  digits = "0" * 18
+  exp = -1
+  if x != 0:
+    if x < 0:
+      sign = "-"
+      x = -x
+    if x == x / 4:
+      return sign + "inf"
+    # Scale x into [1e8, 1e9)
+    exp = 8
+    j = 1 << (len(EXP10_TABLE) - 1)
+    scale_up = x < 1e8
+    for power in reversed(EXP10_TABLE):
+      if scale_up:
+        if x * power < 1e9:
+          x *= power
+          exp -= j
+      elif x / power >= 1e8:
+        x /= power
+        exp += j
+      j >>= 1
+    while x >= 1e9:
+      x /= 1e1
+      exp += 1
+    # Two blocks of 9 digits
+    blocks = []
+    for i in range(2):
+      block = int(x)
+      x = (x - block) * 1e9
+      blocks.append("%09d" % block)
+    digits = "".join(blocks)
+
+  # buf[0] is room for a carry out of the first digit
+  buf = [0] + [int(c) for c in digits]
+  keep = max(precision, 1)
+  carry = 0
+  if keep - 1 < NUM_DIGITS:
+    end = keep + 1
+    if buf[end] >= 5:
+      carry = 1
+  else:
+    end = NUM_DIGITS + 1
+  # Round (away from 0) and trim trailing zeros
+  while True:
+    end -= 1
+    buf[end] += carry
+    if buf[end] == 10:
+      continue
+    if buf[end] != 0 or end == 0:
+      break
+  if buf[0]:
+    mantissa = "1"
+    exp += 1
+  elif end == 0:
+    mantissa = "0"
+    exp += 1
+  else:
+    mantissa = "".join([str(d) for d in buf[1:end + 1]])
+
+  if -4 <= exp < keep:
+    if exp < 0:
+      return sign + "0." + "0" * (-exp - 1) + mantissa
+    if len(mantissa) <= exp + 1:
+      return sign + mantissa + "0" * (exp + 1 - len(mantissa))
+    return sign + mantissa[:exp + 1] + "." + mantissa[exp + 1:]
+  if len(mantissa) > 1:
+    mantissa = mantissa[0] + "." + mantissa[1:]
+  return "%s%se%s%02d" % (sign, mantissa, "-" if exp < 0 else "+", abs(exp))
+
+def format_value(p, tag, nonsensical):
+  if tag == ord("i"):
+    n = p.varint()
+    return to_bytes(str((n >> 1) ^ -(n & 1)))
+  elif tag == ord("u"):
+    return to_bytes(str(p.varint()))
+  elif tag == ord("p"):
+    return to_bytes("0x%x" % p.varint())
+  elif tag == ord("f"):
+    return to_bytes(format_g(struct.unpack("<f", p.bytes(4))[0], 9))
+  elif tag == ord("d"):
+    return to_bytes(format_g(struct.unpack("<d", p.bytes(8))[0], 17))
+  elif tag == ord("s"):
+    return escape_string(p.string())
+  elif tag == ord("["):
+    count = p.varint()
+    out = [b"[ "]
+    for i in range(count):
+      elt_tag = p.byte()
+      if elt_tag == ord("N"):
+        out.append(nonsensical)
+      else:
+        out.append(format_value(p, elt_tag, nonsensical))
+      out.append(b" ")
+    out.append(b"]")
+    return b"".join(out)
+  else:
+    raise FormatError("unknown value tag %r" % chr(tag))
+
+def convert(reader, out, print_uninit):
+  # ppt id -> (ppt name, [var names])
+  schemas = {}
+  # What to print for 'U' and 'N' values (from the header)
+  uninit = b"uninit"
+  nonsensical = b"nonsensical"
+
+  while True:
+    first = reader.peek()
+    if first is None:
+      return
+    if first != b"\0":
+      out.write(reader.readline())
+      continue
+
+    reader.read(1)
+    rec_type = reader.read(1)
+    p = Payload(reader.read(reader.read_varint()))
+
+    if rec_type == b"H":
+      if p.bytes(len(MAGIC)) != MAGIC:
+        raise FormatError("bad header record")
+      version = p.varint()
+      if version != VERSION:
+        raise FormatError("unsupported version %d" % version)
+      text_uninit = p.string()
+      nonsensical = p.string()
+      if not print_uninit:
+        uninit = text_uninit
+
+    elif rec_type == b"S":
+      ppt_id = p.varint()
+      name = p.string()
+      names = [p.string() for i in range(p.varint())]
+      schemas[ppt_id] = (name, names)
+
+    elif rec_type == b"I":
+      ppt_id = p.varint()
+      nonce = p.varint()
+      num_vars = p.varint()
+      if ppt_id not in schemas:
+        raise FormatError("record for unknown program point %d" % ppt_id)
+      name, names = schemas[ppt_id]
+      if num_vars != len(names):
+        raise FormatError("record does not match schema of %s" % name)
+      modbits = bytearray(p.bytes((num_vars + 7) // 8))
+
+      lines = [b"\n", name, b"\nthis_invocation_nonce\n", to_bytes(str(nonce)), b"\n"]
+      for i in range(num_vars):
+        lines.append(names[i])
+        lines.append(b"\n")
+        tag = p.byte()
+        if modbits[i >> 3] & (1 << (i & 7)):
+          lines.append(format_value(p, tag, nonsensical))
+          lines.append(b"\n1\n")
+        elif tag == ord("U"):
+          lines.append(uninit)
+          lines.append(b"\n2\n")
+        elif tag == ord("N"):
+          lines.append(nonsensical)
+          lines.append(b"\n2\n")
+        else:
+          raise FormatError("unknown value tag %r for a variable without a value" % chr(tag))
+      out.write(b"".join(lines))
+
+    else:
+      raise FormatError("unknown record type %r" % rec_type)
+
+def main():
+  args = sys.argv[1:]
+  print_uninit = False
+  if args and args[0] == "--uninit":
+    print_uninit = True
+    args = args[1:]
+  if len(args) < 1 or len(args) > 2:
+    sys.exit("Usage: dtrace_binary_to_text.py [--uninit] input-file [output-file]")
+
+  stdin = getattr(sys.stdin, "buffer", sys.stdin)
+  stdout = getattr(sys.stdout, "buffer", sys.stdout)
+
+  if args[0] == "-":
+    f = stdin
+  elif args[0].endswith(".gz"):
+    f = gzip.open(args[0], "rb")
+  else:
+    f = open(args[0], "rb")
+
+  if len(args) < 2 or args[1] == "-":
+    out = stdout
+  else:
+    out = open(args[1], "wb")
+
+  try:
+    convert(Reader(f), out, print_uninit)
+  except FormatError as e:
+    sys.exit("dtrace_binary_to_text.py: %s" % e)
+  out.flush()
+
+if __name__ == "__main__":
+  main()
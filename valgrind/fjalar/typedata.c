@@ -256,7 +256,7 @@ char tag_is_inheritance(unsigned long tag) {
   return (tag == DW_TAG_inheritance);
 }
 
-static char tag_is_namespace(unsigned long tag) {
+char tag_is_namespace(unsigned long tag) {
   return (tag == DW_TAG_namespace);
 }
 
@@ -2491,6 +2491,7 @@ Effects: Initializes and sets up an array of the dwarf entries for all compile u
 void initialize_compile_unit_array(unsigned long num_entries)
 {
   comp_unit_info = VG_(calloc)("typedata.c: initialize_compile_unit_info", num_entries, sizeof *comp_unit_info);
+  comp_unit_info_idx = 0;
 } 
 
 
@@ -2823,9 +2824,24 @@ char harvest_location_list_entry(location_list* ll, unsigned long offset){
   return 1;
 }
 
-// Initialize FunctionSymbolTable and VariableSymbolTable:
+// Initialize FunctionSymbolTable and VariableSymbolTable (and clear
+// everything else that process_elf_binary_data() fills in, in case
+// this is for a shared object; see save_typedata_state()):
 void initialize_typedata_structures() {
 
+  dwarf_entry_array = 0;
+  dwarf_entry_array_size = 0;
+  comp_unit_info = 0;
+  comp_unit_info_idx = 0;
+  typedef_names_map = 0;
+  debug_frame_HEAD = 0;
+  debug_frame_TAIL = 0;
+  comp_unit_base = 0;
+  data_section_addr = data_section_size = 0;
+  bss_section_addr = bss_section_size = 0;
+  rodata_section_addr = rodata_section_size = 0;
+  relrodata_section_addr = relrodata_section_size = 0;
+
   loc_list_map = genallocatehashtable(0, (int (*)(void *,void *)) &equivalentIDs);
 
   FunctionSymbolTable = genallocatehashtable((unsigned int (*)(void *)) & hashString,
@@ -2839,6 +2855,54 @@ void initialize_typedata_structures() {
     genallocatehashtable(0, (int (*)(void *,void *))&equivalentIDs);
 }
 
+void save_typedata_state(typedata_state* state) {
+  state->dwarf_entry_array = dwarf_entry_array;
+  state->dwarf_entry_array_size = dwarf_entry_array_size;
+  state->comp_unit_info = comp_unit_info;
+  state->comp_unit_info_idx = comp_unit_info_idx;
+  state->loc_list_map = loc_list_map;
+  state->FunctionSymbolTable = FunctionSymbolTable;
+  state->ReverseFunctionSymbolTable = ReverseFunctionSymbolTable;
+  state->VariableSymbolTable = VariableSymbolTable;
+  state->next_line_addr = next_line_addr;
+  state->typedef_names_map = typedef_names_map;
+  state->debug_frame_HEAD = debug_frame_HEAD;
+  state->debug_frame_TAIL = debug_frame_TAIL;
+  state->comp_unit_base = comp_unit_base;
+  state->section_addrs_and_sizes[0] = data_section_addr;
+  state->section_addrs_and_sizes[1] = data_section_size;
+  state->section_addrs_and_sizes[2] = bss_section_addr;
+  state->section_addrs_and_sizes[3] = bss_section_size;
+  state->section_addrs_and_sizes[4] = rodata_section_addr;
+  state->section_addrs_and_sizes[5] = rodata_section_size;
+  state->section_addrs_and_sizes[6] = relrodata_section_addr;
+  state->section_addrs_and_sizes[7] = relrodata_section_size;
+}
+
+void restore_typedata_state(const typedata_state* state) {
+  dwarf_entry_array = state->dwarf_entry_array;
+  dwarf_entry_array_size = state->dwarf_entry_array_size;
+  comp_unit_info = state->comp_unit_info;
+  comp_unit_info_idx = state->comp_unit_info_idx;
+  loc_list_map = state->loc_list_map;
+  FunctionSymbolTable = state->FunctionSymbolTable;
+  ReverseFunctionSymbolTable = state->ReverseFunctionSymbolTable;
+  VariableSymbolTable = state->VariableSymbolTable;
+  next_line_addr = state->next_line_addr;
+  typedef_names_map = state->typedef_names_map;
+  debug_frame_HEAD = state->debug_frame_HEAD;
+  debug_frame_TAIL = state->debug_frame_TAIL;
+  comp_unit_base = state->comp_unit_base;
+  data_section_addr = state->section_addrs_and_sizes[0];
+  data_section_size = state->section_addrs_and_sizes[1];
+  bss_section_addr = state->section_addrs_and_sizes[2];
+  bss_section_size = state->section_addrs_and_sizes[3];
+  rodata_section_addr = state->section_addrs_and_sizes[4];
+  rodata_section_size = state->section_addrs_and_sizes[5];
+  relrodata_section_addr = state->section_addrs_and_sizes[6];
+  relrodata_section_size = state->section_addrs_and_sizes[7];
+}
+
 Addr getFunctionStartAddr(char* name) {
   return (Addr)gengettable(FunctionSymbolTable, (void*)name);
 }
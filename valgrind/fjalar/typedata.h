@@ -485,6 +485,29 @@ unsigned int rodata_section_size;
 unsigned int relrodata_section_addr;
 unsigned int relrodata_section_size;
 
+// Everything that process_elf_binary_data() fills in, so that the
+// debug. info. of a shared object can be read without throwing away
+// the executable's (see fjalar_objects.c):
+typedef struct {
+  dwarf_entry* dwarf_entry_array;
+  unsigned long dwarf_entry_array_size;
+  compile_unit** comp_unit_info;
+  unsigned long comp_unit_info_idx;
+  struct genhashtable* loc_list_map;
+  struct genhashtable* FunctionSymbolTable;
+  struct genhashtable* ReverseFunctionSymbolTable;
+  struct genhashtable* VariableSymbolTable;
+  struct genhashtable* next_line_addr;
+  struct genhashtable* typedef_names_map;
+  debug_frame* debug_frame_HEAD;
+  debug_frame* debug_frame_TAIL;
+  unsigned int comp_unit_base;
+  unsigned int section_addrs_and_sizes[8];
+} typedata_state;
+
+void save_typedata_state(typedata_state* state);
+void restore_typedata_state(const typedata_state* state);
+
 // Function declarations
 
 // From readelf.c
@@ -503,6 +526,7 @@ char tag_is_formal_parameter(unsigned long tag);
 char tag_is_compile_unit(unsigned long tag);
 char tag_is_function_type(unsigned long tag);
 char tag_is_inheritance(unsigned long tag);
+char tag_is_namespace(unsigned long tag);
 char entry_is_listening_for_attribute(dwarf_entry* e, unsigned long attr);
 
 char harvest_type_value(dwarf_entry* e, unsigned long value);